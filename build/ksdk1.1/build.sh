@@ -13,6 +13,31 @@
 	cp ../../src/boot/ksdk1.1.0/warp.h				work/demos/Warp/src/
 	cp ../../src/boot/ksdk1.1.0/devSSD1331.*			work/demos/Warp/src/
 	cp ../../src/boot/ksdk1.1.0/devMAX30105.*				work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-bpmTrend.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-busConfig.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-fixedPoint.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-pipeline.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-ble*				work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-profile.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-rawStream.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-log.*				work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-command.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-sessionLog.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-stack.*				work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/warp-eventQueue.*			work/demos/Warp/src/
+	cp ../../src/boot/ksdk1.1.0/btstack/btstack_config.h		work/demos/Warp/src/btstack/
+	cp ../../src/boot/ksdk1.1.0/btstack/hal_cpu.c			work/demos/Warp/src/btstack/
+	cp ../../src/boot/ksdk1.1.0/btstack/hal_time_ms.c		work/demos/Warp/src/btstack/
+	cp ../../src/boot/ksdk1.1.0/btstack/hal_uart_dma.c		work/demos/Warp/src/btstack/
+	cp ../../src/boot/ksdk1.1.0/btstack/hal_flash_bank_kl03.*	work/demos/Warp/src/btstack/
+	cp -r ../../src/btstack/src/*					work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/btstack_run_loop_embedded.*	work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/hal_cpu.h		work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/hal_tick.h		work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/hal_time_ms.h		work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/hal_uart_dma.h		work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/hal_flash_bank.h		work/demos/Warp/src/btstack/
+	cp ../../src/btstack/platform/embedded/btstack_uart_block_embedded.c	work/demos/Warp/src/btstack/
 	cp ../../src/boot/ksdk1.1.0/CMakeLists.txt			work/demos/Warp/armgcc/Warp/
 	cp ../../src/boot/ksdk1.1.0/startup_MKL03Z4.S			work/platform/startup/MKL03Z4/gcc/startup_MKL03Z4.S
 	cp ../../src/boot/ksdk1.1.0/gpio_pins.c				work/boards/Warp
@@ -20,5 +45,7 @@
 
 	cd work/lib/ksdk_platform_lib/armgcc/KL03Z4 && ./clean.sh; ./build_release.sh
 	cd ../../../../demos/Warp/armgcc/Warp && ./clean.sh; ./build_release.sh
+	python3 ../../../../../../../tools/scripts/warp-ramfuncReport.py release/Warp.elf
+	make ram_report
 	echo "\n\nNow, run\n\n\t/Applications/SEGGER/JLink/JLinkExe -device MKL03Z32XXX4 -if SWD -speed 100000 -CommanderScript ../../tools/scripts/jlink.commands\n\n"
 
@@ -74,8 +74,8 @@ Revision: $Rev: 12489 $
 **********************************************************************
 */
 
-#define SEGGER_RTT_MAX_NUM_UP_BUFFERS (2)   // Max. number of up-buffers (T->H) available on this target    (Default: 3)
-#define SEGGER_RTT_MAX_NUM_DOWN_BUFFERS (2) // Max. number of down-buffers (H->T) available on this target  (Default: 3)
+#define SEGGER_RTT_MAX_NUM_UP_BUFFERS (5)   // Max. number of up-buffers (T->H) available on this target    (Default: 3). Buffers 1 to 4 carry raw samples, profiling records, deferred log records and command responses
+#define SEGGER_RTT_MAX_NUM_DOWN_BUFFERS (2) // Max. number of down-buffers (H->T) available on this target  (Default: 3). Buffer 1 carries commands
 
 #define BUFFER_SIZE_UP (200) // Size of the buffer for terminal output of target, up to host (Default: 1k)
 #define BUFFER_SIZE_DOWN (4) // Size of the buffer for terminal input to target from host (Usually keyboard input) (Default: 16)
@@ -6,8 +6,9 @@
 #define __BTSTACK_CONFIG
 
 // Port related features
-#define HAVE_EMBEDDED_TICK //enable link to sysclock
-// #define HAVE_EMBEDDED_TIME_MS 
+// #define HAVE_EMBEDDED_TICK //enable link to sysclock
+#define HAVE_EMBEDDED_TIME_MS // RTC time base, see hal_time_ms.c
+#define HAVE_EMBEDDED_TICKLESS // only wake for the next timer
 
 // BTstack features that can be enabled
 #define ENABLE_BLE
@@ -24,7 +25,7 @@
 #define HCI_ACL_PAYLOAD_SIZE 52
 #define MAX_SPP_CONNECTIONS 1
 #define MAX_NR_GATT_CLIENTS 1
-#define MAX_NR_HCI_CONNECTIONS MAX_SPP_CONNECTIONS
+#define MAX_NR_HCI_CONNECTIONS 2 // Heart Rate Service subscribers, e.g. a phone and a gateway
 #define MAX_NR_L2CAP_SERVICES 2
 #define MAX_NR_L2CAP_CHANNELS (1 + MAX_SPP_CONNECTIONS)
 #define MAX_NR_RFCOMM_MULTIPLEXERS MAX_SPP_CONNECTIONS
@@ -46,4 +47,14 @@
     #include "../SEGGER_RTT.h"
 #endif
 
+// log_info() and log_error() as deferred records on RTT, see warp-log.h.
+// File and line are folded into the format string, so they cost nothing at runtime
+#ifdef WARP_BUILD_ENABLE_DEFERRED_LOG
+    #include <stdint.h>
+    #include "../warp-log.h"
+    #define ENABLE_LOG_INFO
+    #define ENABLE_LOG_ERROR
+    #define HCI_DUMP_LOG(log_level, format, ...) WARP_LOG(__BTSTACK_FILE__ "." WARP_LOG_STRINGIFY(__LINE__) ": " format, ## __VA_ARGS__)
+#endif
+
 #endif
@@ -1,21 +1,56 @@
- 
+/*
+ *  hal_cpu.c
+ *
+ *  CPU sleep and interrupt control for the btstack embedded run loop on the KL03.
+ *
+ */
+
+#include "fsl_device_registers.h"
 
-// TODO: Impliment these functions
- 
 #include "hal_cpu.h"
-// #include "SEGGER_RTT.h"
 #include "btstack_config.h"
 
-
 void hal_cpu_disable_irqs(void){
-	SEGGER_RTT_WriteString(0, "\r BLE: CPU Disable IRQs called\n");
+    __disable_irq();
 }
 
 void hal_cpu_enable_irqs(void){
-	SEGGER_RTT_WriteString(0, "\r BLE: CPU Enable IRQs called\n");
+    __enable_irq();
 }
 
+static uint8_t uart_needed_during_sleep = 0;
+
+/*
+ *  The LPUART stops in VLPS, so the UART driver calls this while a transfer may
+ *  arrive, limiting sleep to WAIT mode.
+ */
+void hal_cpu_set_uart_needed_during_sleep(uint8_t enabled){
+    uart_needed_during_sleep = enabled;
+}
+
+/*
+ *  Called with interrupts disabled. WFI still wakes on a pending interrupt while
+ *  PRIMASK is set, so an interrupt arriving between the run loop's last check and
+ *  the sleep is not lost; it is taken as soon as interrupts are re-enabled.
+ *
+ *  Sleeps in VLPS when allowed: the LPTMR keeps counting from the LPO and the
+ *  PTA7 interrupt is an asynchronous wakeup source. The I2C and SPI transfers are
+ *  all blocking, so none is in progress here. PMPROT can only be written once
+ *  after reset; if VLPS was not permitted, this falls back to WAIT mode.
+ */
 void hal_cpu_enable_irqs_and_sleep(void){
-	SEGGER_RTT_WriteString(0, "\r BLE: CPU Enable IRQs and Sleep called\n");
+    if (SMC->PMPROT == 0){
+        SMC->PMPROT = SMC_PMPROT_AVLP_MASK;
+    }
+
+    if (!uart_needed_during_sleep && (SMC->PMPROT & SMC_PMPROT_AVLP_MASK)){
+        SMC->PMCTRL = (SMC->PMCTRL & ~SMC_PMCTRL_STOPM_MASK) | SMC_PMCTRL_STOPM(2 /* VLPS */);
+        (void) SMC->PMCTRL; // the mode must be set before WFI
+        SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    } else {
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    }
 
-}
\ No newline at end of file
+    __WFI();
+    __enable_irq();
+}
@@ -0,0 +1,123 @@
+/*
+ *  hal_flash_bank_kl03.c
+ *
+ *  hal_flash_bank on the KL03 P-Flash, through the KSDK C90TFS driver.
+ *
+ *  The KL03 has a single flash block, which cannot be read while one of its
+ *  sectors is being erased or programmed. The command launch therefore runs from
+ *  RAM, with interrupts masked so that no vector fetch or handler touches the
+ *  flash until the command completes. Interrupts raised meanwhile are taken
+ *  afterwards; only the LPUART can lose a byte, since it has no receive FIFO.
+ *
+ *  Flash is programmed a longword at a time, so the alignment is 4 bytes. A write
+ *  whose size is not a multiple of 4 has its last longword padded with 0xFF,
+ *  which leaves those bytes erased.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h> // memcpy
+
+#include "fsl_device_registers.h"
+#include "SSD_FTFx.h"
+
+#include "hal_flash_bank_kl03.h"
+#include "btstack_config.h"
+
+#define HAL_FLASH_BANK_KL03_WRITE_UNIT FSL_FEATURE_FLASH_PFLASH_BLOCK_WRITE_UNIT_SIZE
+
+static FLASH_SSD_CONFIG hal_flash_bank_kl03_ssd_config = {
+    FTFA_BASE,                                  // ftfxRegBase
+    0x00000000,                                 // PFlashBase
+    FSL_FEATURE_FLASH_PFLASH_BLOCK_SIZE,        // PFlashSize
+    0x00000000,                                 // DFlashBase, no FlexNVM
+    0,                                          // DFlashSize
+    0x00000000,                                 // EERAMBase
+    0,                                          // EEESize
+    false,                                      // DebugEnable
+    NULL_CALLBACK,                              // CallBack
+};
+
+/*
+ *  Replaces the driver's FlashCommandSequence(), which would run from flash. Lives
+ *  in .ramfunc, which Reset_Handler copies to RAM (see MKL03Z32xxx4_flash.ld).
+ */
+__attribute__((section(".ramfunc.hal_flash_bank_kl03_launch"), noinline))
+static uint32_t hal_flash_bank_kl03_launch(PFLASH_SSD_CONFIG config){
+    (void) config;
+    FTFA_FSTAT = FTFA_FSTAT_CCIF_MASK; // Writing 1 to CCIF starts the command
+    while ((FTFA_FSTAT & FTFA_FSTAT_CCIF_MASK) == 0){
+    }
+    return FTFA_FSTAT & (FTFA_FSTAT_ACCERR_MASK | FTFA_FSTAT_FPVIOL_MASK | FTFA_FSTAT_MGSTAT0_MASK);
+}
+
+static uint32_t hal_flash_bank_kl03_get_size(void * context){
+    hal_flash_bank_kl03_t * self = (hal_flash_bank_kl03_t *) context;
+    return self->bank_size;
+}
+
+static uint32_t hal_flash_bank_kl03_get_alignment(void * context){
+    (void) context;
+    return HAL_FLASH_BANK_KL03_WRITE_UNIT;
+}
+
+static void hal_flash_bank_kl03_erase(void * context, int bank){
+    hal_flash_bank_kl03_t * self = (hal_flash_bank_kl03_t *) context;
+    if (bank > 1) return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    FlashEraseSector(&hal_flash_bank_kl03_ssd_config, self->banks[bank], self->bank_size, &hal_flash_bank_kl03_launch);
+    __set_PRIMASK(primask);
+}
+
+static void hal_flash_bank_kl03_read(void * context, int bank, uint32_t offset, uint8_t * buffer, uint32_t size){
+    hal_flash_bank_kl03_t * self = (hal_flash_bank_kl03_t *) context;
+
+    if (bank > 1) return;
+    if (offset > self->bank_size) return;
+    if ((offset + size) > self->bank_size) return;
+
+    memcpy(buffer, ((uint8_t *) self->banks[bank]) + offset, size);
+}
+
+static void hal_flash_bank_kl03_write(void * context, int bank, uint32_t offset, const uint8_t * data, uint32_t size){
+    hal_flash_bank_kl03_t * self = (hal_flash_bank_kl03_t *) context;
+
+    if (bank > 1) return;
+    if (offset > self->bank_size) return;
+    if ((offset + size) > self->bank_size) return;
+    if (offset & (HAL_FLASH_BANK_KL03_WRITE_UNIT - 1)) return;
+
+    uint32_t whole = size & ~(HAL_FLASH_BANK_KL03_WRITE_UNIT - 1);
+    uint8_t tail[HAL_FLASH_BANK_KL03_WRITE_UNIT];
+    memset(tail, 0xff, sizeof(tail));
+    memcpy(tail, data + whole, size - whole);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (whole){
+        FlashProgram(&hal_flash_bank_kl03_ssd_config, self->banks[bank] + offset, whole, (uint8_t *) data, &hal_flash_bank_kl03_launch);
+    }
+    if (size > whole){
+        FlashProgram(&hal_flash_bank_kl03_ssd_config, self->banks[bank] + offset + whole, sizeof(tail), tail, &hal_flash_bank_kl03_launch);
+    }
+    __set_PRIMASK(primask);
+}
+
+static const hal_flash_bank_t hal_flash_bank_kl03_impl = {
+    /* uint32_t (*get_size)() */         &hal_flash_bank_kl03_get_size,
+    /* uint32_t (*get_alignment)(..); */ &hal_flash_bank_kl03_get_alignment,
+    /* void (*erase)(..);             */ &hal_flash_bank_kl03_erase,
+    /* void (*read)(..);              */ &hal_flash_bank_kl03_read,
+    /* void (*write)(..);             */ &hal_flash_bank_kl03_write,
+};
+
+const hal_flash_bank_t * hal_flash_bank_kl03_init_instance(hal_flash_bank_kl03_t * context, uint32_t bank_size,
+        uintptr_t bank_0_addr, uintptr_t bank_1_addr){
+    context->bank_size = bank_size;
+    context->banks[0]  = bank_0_addr;
+    context->banks[1]  = bank_1_addr;
+    FlashInit(&hal_flash_bank_kl03_ssd_config);
+    return &hal_flash_bank_kl03_impl;
+}
@@ -0,0 +1,31 @@
+#ifndef __HAL_FLASH_BANK_KL03_H
+#define __HAL_FLASH_BANK_KL03_H
+
+#include <stdint.h>
+#include "hal_flash_bank.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t   bank_size;
+    uintptr_t  banks[2];
+} hal_flash_bank_kl03_t;
+
+/**
+ * Configure KL03 HAL Flash Implementation
+ *
+ * @param context of hal_flash_bank_kl03_t
+ * @param bank_size, a multiple of the 1 kB P-Flash sector
+ * @param bank_0_addr, sector aligned
+ * @param bank_1_addr, sector aligned
+ * @return
+ */
+const hal_flash_bank_t * hal_flash_bank_kl03_init_instance(hal_flash_bank_kl03_t * context, uint32_t bank_size,
+        uintptr_t bank_0_addr, uintptr_t bank_1_addr);
+
+#if defined __cplusplus
+}
+#endif
+#endif
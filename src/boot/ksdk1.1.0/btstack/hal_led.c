@@ -1,8 +1,9 @@
 
 // #include "SEGGER_RTT.h"
 #include "btstack_config.h"
+#include "../warp-log.h"
 
 
 void hal_led_toggle(void){
-    SEGGER_RTT_printf(0, "\r\t * LED Toggled * \n");
+    WARP_LOG("\r\t * LED Toggled * \n");
 }
@@ -1,150 +1,85 @@
 /*
  *  hal_tick.c
  *
- *  Based on implementation for MSP430 Experimenter board
+ *  Run loop tick for the KL03.
+ *
+ *  The KSDK bare-metal OSA already runs LPTMR0 free-running from the 1 kHz LPO and
+ *  reads its counter for OSA_TimeGetMsec(), which the I2C and SPI drivers use for
+ *  their timeouts. Rather than reconfiguring the timer, the tick uses its compare
+ *  interrupt and leaves the counter undisturbed.
+ *
+ *  With HAVE_EMBEDDED_TICKLESS, the compare is set for the first pending run loop
+ *  timer rather than every tick period, and the ticks that passed are counted from
+ *  the free-running counter when the run loop wakes. The LPTMR only accepts a new
+ *  compare value while its compare flag is set or it is disabled, so bringing an
+ *  armed deadline forward restarts the counter; an OSA_TimeGetMsec() interval that
+ *  spans such a sleep can come out long, but the tick count carries on from it.
  *
  */
 
-// #include <msp430x54x.h>
-
 #include <stdlib.h>
 
-// #include "fsl_misc_utilities.h"
-// #include "fsl_device_registers.h"
-// #include "fsl_i2c_master_driver.h"
-// #include "fsl_spi_master_driver.h"
-// #include "fsl_rtc_driver.h"
-// #include "fsl_clock_manager.h"
-// #include "fsl_power_manager.h"
-// #include "fsl_mcglite_hal.h"
-// #include "fsl_port_hal.h"
-// #include "fsl_hwtimer.h"
-
-// #include "gpio_pins.h"
-// #include "SEGGER_RTT.h"
-
-// #include "warp.h"
-#include "fsl_lptmr_driver.h"
+#include "fsl_device_registers.h"
+#include "fsl_lptmr_hal.h"
 
 #include "hal_tick.h"
 #include "btstack_config.h"
 
-// #define HWTIMER_LL_DEVIF kSystickDevif
-// #define HWTIMER_LL_ID 0
-
-// #define HWTIMER_ISR_PRIOR 5
-// #define HWTIMER_PERIOD 100000
-// #define HWTIMER_DOTS_PER_LINE 40
-// #define HWTIMER_LINES_COUNT 2
-
-// #include "hal_compat.h"
-
-// extern const hwtimer_devif_t kSystickDevif;
-// extern const hwtimer_devif_t kPitDevif;
-// hwtimer_t hwtimer;
+// The LPO counts at 1 kHz, so one count per millisecond
+#ifdef HAVE_EMBEDDED_TICKLESS
+#define HAL_TICK_PERIOD_MS 10
+#define HAL_TICK_MAX_SLEEP_MS 1000
+#else
+#define HAL_TICK_PERIOD_MS 50
+#endif
 
 static void dummy_handler(void){};
 static void (*tick_handler)(void) = &dummy_handler;
 
-//use 32k rtc_clkout to get base ticks
-//scale to get 4 counts per second = 8000 ticks
-
-#define TIMER_COUNTDOWN 8000
-#define LPTMR_INSTANCE 0
-
-static lptmr_state_t gLPTMRState;
-// uint8_t gLPTMR_counter;
-
-// void hwtimer_callback(void *data)
-// {
-//     // SEGGER_RTT_printf(0,".");
-//     // if ((HWTIMER_SYS_GetTicks(&hwtimer) % HWTIMER_DOTS_PER_LINE) == 0)
-//     // {
-//     //     SEGGER_RTT_printf(0,"\r\n");
-//     // }
-//     // if ((HWTIMER_SYS_GetTicks(&hwtimer) % (HWTIMER_LINES_COUNT * HWTIMER_DOTS_PER_LINE)) == 0)
-//     // {
-//     //     if (kHwtimerSuccess != HWTIMER_SYS_Stop(&hwtimer))
-//     //     {
-//     //         SEGGER_RTT_printf(0,"\r\nError: hwtimer stop.\r\n");
-//     //     }
-//     //     SEGGER_RTT_printf(0,"End\r\n");
-//     // }
-// }
-
-void lptmr_isr_callback(void)
-{
-    // gLPTMR_counter++;
+#ifdef HAVE_EMBEDDED_TICKLESS
+static uint16_t last_tick_count; // Counter value at the last tick counted by hal_tick_sync()
+#endif
+
+void LPTMR0_IRQHandler(void){
+#ifdef HAVE_EMBEDDED_TICKLESS
+    // Only wakes the run loop. The flag stays set, so the next deadline can be written.
+    // The interrupt can also arrive late, after the flag was cleared to arm a new
+    // deadline; that deadline must stay enabled.
+    if (LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_SetIntCmd(LPTMR0_BASE, false);
+    }
+#else
+    // CMR may only be written while TCF is set, so move it on before clearing the flag
+    LPTMR_HAL_SetCompareValue(LPTMR0_BASE, (LPTMR_HAL_GetCompareValue(LPTMR0_BASE) + HAL_TICK_PERIOD_MS) & 0xFFFF);
+    LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
     (*tick_handler)();
-    // printf("%d ",gLPTMR_counter);
+#endif
 }
 
-
 void hal_tick_init(void){
+    uint32_t compare = (LPTMR_HAL_GetCounterValue(LPTMR0_BASE) + HAL_TICK_PERIOD_MS) & 0xFFFF;
+
+    if (LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_SetCompareValue(LPTMR0_BASE, compare);
+        LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+    } else {
+        // Only reachable if the counter has not yet passed the reset compare value; disabling restarts it from zero
+        LPTMR_HAL_Disable(LPTMR0_BASE);
+        compare = HAL_TICK_PERIOD_MS;
+        LPTMR_HAL_SetCompareValue(LPTMR0_BASE, compare);
+        LPTMR_HAL_Enable(LPTMR0_BASE);
+    }
 
-    lptmr_user_config_t lptmrUserConfig =
-    {
-        .timerMode = kLptmrTimerModeTimeCounter, // Use LPTMR in Time Counter mode
-        .freeRunningEnable = false, // When hit compare value, set counter back to zero
-        .prescalerEnable = false, // bypass prescaler
-        .prescalerClockSource = kClockLptmrSrcLpoClk, // use 1kHz Low Power Clock
-        .isInterruptEnabled = true
-    };
-
-    // Initialize LPTMR
-    LPTMR_DRV_Init(LPTMR_INSTANCE,&lptmrUserConfig,&gLPTMRState);
-
-    // Set the timer period for 250 milliseconds
-    LPTMR_DRV_SetTimerPeriodUs(LPTMR_INSTANCE,250000);
-
-    // Specify the callback function when a LPTMR interrupt occurs
-    LPTMR_DRV_InstallCallback(LPTMR_INSTANCE,lptmr_isr_callback);
-
-    // Start counting
-    LPTMR_DRV_Start(LPTMR_INSTANCE);
-
-    SEGGER_RTT_printf(0, "\r\tStarted LPTMR\n");
-    
-    // // hardware_init();
-
-    // // Print the initial banner
-    // SEGGER_RTT_printf(0,"\r\nHwtimer Example \r\n");
-
-    // // Hwtimer initialization
-    // if (kHwtimerSuccess != HWTIMER_SYS_Init(&hwtimer, &HWTIMER_LL_DEVIF, HWTIMER_LL_ID, NULL))
-    // {
-    //     SEGGER_RTT_printf(0,"\r\nError: hwtimer initialization.\r\n");
-    // }
-
-    // /*
-    //  * In case you wish to raise the Systick ISR priority, then use the below command with the
-    //  * appropriate priority setting:
-    //  * NVIC_SetPriority(SysTick_IRQn, isrPrior);
-    //  */
-    // NVIC_SetPriority(SysTick_IRQn, HWTIMER_ISR_PRIOR);
-
-    // if (kHwtimerSuccess != HWTIMER_SYS_SetPeriod(&hwtimer, HWTIMER_PERIOD))
-    // {
-    //     SEGGER_RTT_printf(0,"\r\nError: hwtimer set period.\r\n");
-    // }
-    // if (kHwtimerSuccess != HWTIMER_SYS_RegisterCallback(&hwtimer, hwtimer_callback, NULL))
-    // {
-    //     SEGGER_RTT_printf(0,"\r\nError: hwtimer callback registration.\r\n");
-    // }
-    // if (kHwtimerSuccess != HWTIMER_SYS_Start(&hwtimer))
-    // {
-    //     SEGGER_RTT_printf(0,"\r\nError: hwtimer start.\r\n");
-    // }
-
-    // // TA1CCTL0 = CCIE;                  // CCR0 interrupt enabled
-    // // TA1CTL = TASSEL_1 | MC_2 | TACLR; // use ACLK (32768), contmode, clear TAR
-    // // TA1CCR0 = TIMER_COUNTDOWN;        // -> 1/4 s
-}
+#ifdef HAVE_EMBEDDED_TICKLESS
+    last_tick_count = compare - HAL_TICK_PERIOD_MS;
+#endif
 
-void hal_tick_set_handler(void (*handler)(void)) { //this will get called every "hal_tick_get_tick_period_in_ms"
+    LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
+    NVIC_EnableIRQ(LPTMR0_IRQn);
+}
 
-    if (handler == NULL)
-    {
+void hal_tick_set_handler(void (*handler)(void)){
+    if (handler == NULL){
         tick_handler = &dummy_handler;
         return;
     }
@@ -152,5 +87,56 @@ void hal_tick_set_handler(void (*handler)(void)) { //this will get called every
 }
 
 int hal_tick_get_tick_period_in_ms(void){
-    return 250;
+    return HAL_TICK_PERIOD_MS;
+}
+
+#ifdef HAVE_EMBEDDED_TICKLESS
+uint32_t hal_tick_sync(void){
+    uint16_t elapsed = LPTMR_HAL_GetCounterValue(LPTMR0_BASE) - last_tick_count;
+    uint32_t ticks = 0;
+
+    // Rarely more than a few periods, so cheaper than a division on the M0+
+    while (elapsed >= HAL_TICK_PERIOD_MS){
+        last_tick_count += HAL_TICK_PERIOD_MS;
+        elapsed -= HAL_TICK_PERIOD_MS;
+        ticks++;
+    }
+    return ticks;
+}
+
+void hal_tick_set_next_deadline(uint32_t ticks){
+    uint16_t now = LPTMR_HAL_GetCounterValue(LPTMR0_BASE);
+    uint16_t since_last_tick = now - last_tick_count;
+    uint32_t sleep_ms = ticks * HAL_TICK_PERIOD_MS;
+
+    // Measured from now, at least two counts ahead so the compare can not be passed before it is armed
+    if ((ticks == 0) || (sleep_ms > HAL_TICK_MAX_SLEEP_MS + since_last_tick)){
+        sleep_ms = HAL_TICK_MAX_SLEEP_MS;
+    } else if (sleep_ms < since_last_tick + 2){
+        sleep_ms = 2;
+    } else {
+        sleep_ms -= since_last_tick;
+    }
+
+    if (LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_SetCompareValue(LPTMR0_BASE, (now + sleep_ms) & 0xFFFF);
+        LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+        LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
+        return;
+    }
+
+    uint16_t remaining = LPTMR_HAL_GetCompareValue(LPTMR0_BASE) - now;
+    if (remaining <= sleep_ms){
+        // The deadline armed by an earlier, interrupted sleep comes first
+        return;
+    }
+
+    // Disabling clears the flag and restarts the counter from zero, so keep the counts
+    // since the last tick, including any not yet synced, relative to the new zero
+    last_tick_count = (uint16_t) (0 - since_last_tick);
+    LPTMR_HAL_Disable(LPTMR0_BASE);
+    LPTMR_HAL_SetCompareValue(LPTMR0_BASE, sleep_ms);
+    LPTMR_HAL_Enable(LPTMR0_BASE);
+    LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
 }
+#endif
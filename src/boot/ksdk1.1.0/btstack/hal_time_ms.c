@@ -1,2 +1,110 @@
+/*
+ *  hal_time_ms.c
+ *
+ *  Millisecond time base and timer wakeups for the btstack embedded run loop
+ *  (HAVE_EMBEDDED_TIME_MS) on the KL03.
+ *
+ *  Time is read from the RTC, which counts the 32.768 kHz crystal: TSR holds whole
+ *  seconds and TPR the 1/32768 s within the current one, so the internal resolution
+ *  is about 31 us. The millisecond value is computed in 32-bit arithmetic and wraps
+ *  continuously every 2^32 ms, which the run loop's timer comparisons allow for.
+ *
+ *  The RTC alarm only has a resolution of one second, so the wakeup for the next
+ *  timer comes from the LPTMR0 compare interrupt instead, as in hal_tick.c. The
+ *  LPTMR counts the 1 kHz LPO, which is far less accurate than the crystal, so
+ *  long sleeps are cut short by an eighth and the run loop sleeps again for what
+ *  remains, converging on the deadline as measured by the RTC. Bringing an armed
+ *  deadline forward restarts the LPTMR counter, which OSA_TimeGetMsec() reads, so
+ *  an interval measured with it across a sleep can come out long; time for the run
+ *  loop comes from the RTC and is unaffected.
+ *
+ */
 
-// uint32_t hal_time_ms(void){}
+#include "fsl_device_registers.h"
+#include "fsl_clock_manager.h"
+#include "fsl_rtc_hal.h"
+#include "fsl_lptmr_hal.h"
+
+#include "hal_time_ms.h"
+#include "btstack_config.h"
+
+#define HAL_TIME_MS_MAX_SLEEP_MS 1000
+
+void LPTMR0_IRQHandler(void){
+    // Only wakes the run loop. The flag stays set, so the next deadline can be written.
+    // The interrupt can also arrive late, after the flag was cleared to arm a new
+    // deadline; that deadline must stay enabled.
+    if (LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_SetIntCmd(LPTMR0_BASE, false);
+    }
+}
+
+/*
+ *  Call early in boot: the crystal takes a while to start, and hal_time_ms() does
+ *  not advance until it has. LPTMR0 is left free-running as the KSDK OSA set it up.
+ */
+void hal_time_ms_init(void){
+    CLOCK_SYS_EnableRtcClock(0);
+    RTC_HAL_Init(RTC_BASE);
+    RTC_HAL_Enable(RTC_BASE); // Starts the 32 kHz oscillator, since g_xtal0ClkFreq is 32768
+    RTC_HAL_EnableCounter(RTC_BASE, true);
+
+    // Leave the compare flag set and its interrupt off until the first deadline is armed
+    if (!LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_Disable(LPTMR0_BASE);
+        LPTMR_HAL_SetCompareValue(LPTMR0_BASE, 0);
+        LPTMR_HAL_Enable(LPTMR0_BASE);
+    }
+    LPTMR_HAL_SetIntCmd(LPTMR0_BASE, false);
+    NVIC_EnableIRQ(LPTMR0_IRQn);
+}
+
+uint32_t hal_time_ms(void){
+    uint32_t seconds;
+    uint32_t prescaler;
+
+    // The counters are clocked asynchronously to the core, so read until two reads agree
+    do {
+        seconds = RTC_HAL_GetSecsReg(RTC_BASE);
+        prescaler = RTC_HAL_GetPrescaler(RTC_BASE);
+    } while ((seconds != RTC_HAL_GetSecsReg(RTC_BASE)) || (prescaler != RTC_HAL_GetPrescaler(RTC_BASE)));
+
+    return seconds * 1000 + ((prescaler * 1000) >> 15);
+}
+
+/*
+ *  Called by the run loop with interrupts disabled, just before sleeping, with the
+ *  time to its first pending timer, or 0 if there is none. Sleeps are capped at
+ *  HAL_TIME_MS_MAX_SLEEP_MS. The LPTMR only accepts a new compare value while its
+ *  flag is set or it is disabled, so a deadline armed by an earlier sleep that was
+ *  cut short is left alone if it comes first, and otherwise replaced by disabling
+ *  the timer, which also restarts its counter from zero.
+ */
+void hal_time_ms_set_next_deadline(uint32_t ms){
+    if ((ms == 0) || (ms > HAL_TIME_MS_MAX_SLEEP_MS)){
+        ms = HAL_TIME_MS_MAX_SLEEP_MS;
+    }
+    ms -= ms >> 3; // Allow for the LPO running up to 10% fast
+    if (ms < 2){
+        ms = 2; // So the compare can not be passed before it is armed
+    }
+
+    if (LPTMR_HAL_IsIntPending(LPTMR0_BASE)){
+        LPTMR_HAL_SetCompareValue(LPTMR0_BASE, (LPTMR_HAL_GetCounterValue(LPTMR0_BASE) + ms) & 0xFFFF);
+        LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+        LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
+        return;
+    }
+
+    uint16_t remaining = LPTMR_HAL_GetCompareValue(LPTMR0_BASE) - LPTMR_HAL_GetCounterValue(LPTMR0_BASE);
+    if (remaining <= ms){
+        // The armed deadline comes first
+        return;
+    }
+
+    // Disabling clears the flag and the counter; a wakeup already latched only costs an extra pass
+    LPTMR_HAL_Disable(LPTMR0_BASE);
+    LPTMR_HAL_SetCompareValue(LPTMR0_BASE, ms);
+    LPTMR_HAL_Enable(LPTMR0_BASE);
+    LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
+}
@@ -1,79 +1,186 @@
-// TODO:
+/*
+ *  hal_uart_dma.c
+ *
+ *  hal_uart_dma on the KL03 LPUART0, for btstack's H4 transport.
+ *
+ *  The KL03 has no DMA controller, so transfers are interrupt driven through the
+ *  KSDK LPUART driver, one interrupt per byte. The driver has no completion
+ *  callbacks, so LPUART0_IRQHandler wraps the driver's handler and reports the end
+ *  of each send. Reception stays armed permanently with a per-byte callback: bytes
+ *  go straight into the block btstack asked for, and the few that can still arrive
+ *  after RTS is deasserted at the end of a block are held in a small ring buffer
+ *  until the next block is requested.
+ *
+ *  Pins (FRDM-KL03): PTB1 LPUART0_TX, PTB2 LPUART0_RX, PTA6 RTS (GPIO, active low).
+ *  No pin is left for CTS, so the controller can neither hold off transmission
+ *  nor wake the host with a CTS pulse (eHCILL).
+ *
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fsl_device_registers.h"
+#include "fsl_clock_manager.h"
+#include "fsl_mcglite_hal.h"
+#include "fsl_port_hal.h"
+#include "fsl_gpio_hal.h"
+#include "fsl_lpuart_driver.h"
 
 #include "hal_uart_dma.h"
-#include "SEGGER_RTT.h"
+#include "btstack_config.h"
 
+#define HAL_UART_DMA_INSTANCE 0
+#define HAL_UART_DMA_RTS_PIN 6 // PTA6
+#define HAL_UART_DMA_RX_RING_SIZE 8 // Must be a power of two
+
+extern void hal_cpu_set_uart_needed_during_sleep(uint8_t enabled);
+extern void LPUART_DRV_IrqHandler(uint32_t instance);
+
+static void dummy_handler(void){};
+
+static void (*block_sent)(void) = &dummy_handler;
+static void (*block_received)(void) = &dummy_handler;
+static void (*cts_irq_handler)(void) = &dummy_handler;
+
+static lpuart_state_t lpuart_state;
+static uint8_t rx_byte; // The driver stores each received byte here before calling rx_byte_handler()
+
+static uint8_t * rx_buffer_ptr;
+static volatile uint16_t bytes_to_read;
+
+static uint8_t rx_ring[HAL_UART_DMA_RX_RING_SIZE];
+static volatile uint8_t rx_ring_head;
+static volatile uint8_t rx_ring_count;
+static volatile uint16_t rx_ring_overruns; // Bytes dropped because neither a block nor the ring had room
+
+static void hal_uart_dma_enable_rx(void){
+    GPIO_HAL_ClearPinOutput(GPIOA_BASE, HAL_UART_DMA_RTS_PIN);
+}
+
+static void hal_uart_dma_disable_rx(void){
+    GPIO_HAL_SetPinOutput(GPIOA_BASE, HAL_UART_DMA_RTS_PIN);
+}
+
+// Called from the LPUART interrupt for every received byte
+static void rx_byte_handler(uint32_t instance, void * state){
+    if (bytes_to_read){
+        *rx_buffer_ptr++ = rx_byte;
+        if (--bytes_to_read == 0){
+            hal_uart_dma_disable_rx();
+            (*block_received)();
+        }
+        return;
+    }
+
+    if (rx_ring_count < HAL_UART_DMA_RX_RING_SIZE){
+        rx_ring[(rx_ring_head + rx_ring_count) & (HAL_UART_DMA_RX_RING_SIZE - 1)] = rx_byte;
+        rx_ring_count++;
+    } else {
+        rx_ring_overruns++;
+    }
+}
+
+void LPUART0_IRQHandler(void){
+    bool was_sending = lpuart_state.isTxBusy;
+
+    LPUART_DRV_IrqHandler(HAL_UART_DMA_INSTANCE);
+
+    if (was_sending && !lpuart_state.isTxBusy){
+        (*block_sent)();
+    }
+}
 
-/**
- * @brief Init and open device
- */
 void hal_uart_dma_init(void){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_init called\n");
+    // The 48 MHz IRC clocks the LPUART, for rates up to 3 Mbaud. It stops by itself in VLPS.
+    CLOCK_HAL_SetHircCmd(MCG_BASE, true);
+
+    PORT_HAL_SetMuxMode(PORTB_BASE, 1, kPortMuxAlt2); // LPUART0_TX
+    PORT_HAL_SetMuxMode(PORTB_BASE, 2, kPortMuxAlt2); // LPUART0_RX
+    PORT_HAL_SetMuxMode(PORTA_BASE, HAL_UART_DMA_RTS_PIN, kPortMuxAsGpio);
+    hal_uart_dma_disable_rx();
+    GPIO_HAL_SetPinDir(GPIOA_BASE, HAL_UART_DMA_RTS_PIN, kGpioDigitalOutput);
+
+    lpuart_user_config_t config = {
+        .clockSource = kClockLpuartSrcIrc48M,
+        .baudRate = 115200,
+        .parityMode = kLpuartParityDisabled,
+        .stopBitCount = kLpuartOneStopBit,
+        .bitCountPerChar = kLpuart8BitsPerChar,
+    };
+    LPUART_DRV_Init(HAL_UART_DMA_INSTANCE, &lpuart_state, &config);
+    LPUART_DRV_InstallRxCallback(HAL_UART_DMA_INSTANCE, &rx_byte_handler, &rx_byte, NULL, true /* alwaysEnableRxIrq */);
+
+    rx_ring_head = 0;
+    rx_ring_count = 0;
+    bytes_to_read = 0;
+
+    hal_cpu_set_uart_needed_during_sleep(1);
 }
 
-/**
- * @brief Set callback for block received - can be called from ISR context
- * @param callback
- */
 void hal_uart_dma_set_block_received( void (*callback)(void)){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_set_block_received called\n");
+    block_received = (callback != NULL) ? callback : &dummy_handler;
 }
 
-/**
- * @brief Set callback for block sent - can be called from ISR context
- * @param callback
- */
 void hal_uart_dma_set_block_sent( void (*callback)(void)){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_set_block_sent called\n");
-
+    block_sent = (callback != NULL) ? callback : &dummy_handler;
 }
 
-/**
- * @brief Set baud rate
- * @note During baud change, TX line should stay high and no data should be received on RX accidentally
- * @param baudrate
- */
-int  hal_uart_dma_set_baud(uint32_t baud){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_set_baud called\n");
+int hal_uart_dma_set_baud(uint32_t baud){
+    lpuart_status_t status;
+
+    // Let the last byte of the previous block leave the shift register first
+    while (!LPUART_HAL_GetStatusFlag(LPUART0_BASE, kLpuartTxComplete)){
+    }
 
+    LPUART_HAL_SetTransmitterCmd(LPUART0_BASE, false);
+    LPUART_HAL_SetReceiverCmd(LPUART0_BASE, false);
+    status = LPUART_HAL_SetBaudRate(LPUART0_BASE, CLOCK_SYS_GetLpuartFreq(HAL_UART_DMA_INSTANCE), baud);
+    LPUART_HAL_SetTransmitterCmd(LPUART0_BASE, true);
+    LPUART_HAL_SetReceiverCmd(LPUART0_BASE, true);
+
+    return (status == kStatus_LPUART_Success) ? 0 : -1;
 }
 
-/**
- * @brief Send block. When done, callback set by hal_uart_set_block_sent must be called
- * @param buffer
- * @param lengh
- */
 void hal_uart_dma_send_block(const uint8_t *buffer, uint16_t length){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_send_block called\n");
-
+    LPUART_DRV_SendData(HAL_UART_DMA_INSTANCE, buffer, length);
 }
 
-/**
- * @brief Receive block. When done, callback set by hal_uart_dma_set_block_received must be called
- * @param buffer
- * @param lengh
- */
 void hal_uart_dma_receive_block(uint8_t *buffer, uint16_t len){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_receive_block called\n");
-
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Hand over whatever arrived since the last block first
+    while (len && rx_ring_count){
+        *buffer++ = rx_ring[rx_ring_head];
+        rx_ring_head = (rx_ring_head + 1) & (HAL_UART_DMA_RX_RING_SIZE - 1);
+        rx_ring_count--;
+        len--;
+    }
+
+    if (len == 0){
+        __set_PRIMASK(primask);
+        (*block_received)();
+        return;
+    }
+
+    rx_buffer_ptr = buffer;
+    bytes_to_read = len;
+    hal_uart_dma_enable_rx();
+
+    __set_PRIMASK(primask);
 }
 
-/**
- * @brief Set or clear callback for CSR pulse - can be called from ISR context
- * @param csr_irq_handler or NULL to disable IRQ handler
- */
+// Stored for completeness: without a CTS input there is no pulse to report
 void hal_uart_dma_set_csr_irq_handler( void (*csr_irq_handler)(void)){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_set_csr_irq_handler called\n");
-
+    cts_irq_handler = (csr_irq_handler != NULL) ? csr_irq_handler : &dummy_handler;
+    (void) cts_irq_handler;
 }
 
-/**
- * @brief Set sleep mode
- * @param block_received callback
+/*
+ *  The LPUART, clocked from the 48 MHz IRC, stops in VLPS, so the CPU may only
+ *  sleep that deeply while the controller is asleep too.
  */
 void hal_uart_dma_set_sleep(uint8_t sleep){
-	SEGGER_RTT_WriteString(0, "\r BLE: hal_uart_dma_set_sleep called\n");
-
+    hal_cpu_set_uart_needed_during_sleep(!sleep);
 }
-
-
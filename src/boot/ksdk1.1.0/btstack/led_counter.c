@@ -54,6 +54,7 @@
 #include "btstack_defines.h"
 #include "hal_led.h"
 #include "btstack_config.h"
+#include "../warp-log.h"
 
 // #include "led_counter.h"
 
@@ -78,9 +79,7 @@ static void heartbeat_handler(btstack_timer_source_t *ts){
     UNUSED(ts);
 
     // increment counter
-    char lineBuffer[30];
-    SEGGER_RTT_printf(0, "BTstack counter %04u\n\r", ++counter);
-    SEGGER_RTT_printf(0, "line buffer %s\n\r", lineBuffer);
+    WARP_LOG("BTstack counter %04u\n\r", ++counter);
 
     // toggle LED
     hal_led_toggle();
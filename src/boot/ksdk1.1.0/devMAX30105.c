@@ -13,13 +13,48 @@
 #include "gpio_pins.h"
 #include "SEGGER_RTT.h"
 #include "warp.h"
+#include "warp-busConfig.h"
 
 extern volatile WarpI2CDeviceState deviceMAX30105State;
 extern volatile uint32_t gWarpI2cBaudRateKbps;
 extern volatile uint32_t gWarpI2cTimeoutMilliseconds;
+extern volatile uint32_t gWarpMAX30105LostSamples;
 
 extern const uint32_t THRESHOLD_UP;
 
+/*
+ *	Last value written to each configuration register, so the configuration can be
+ *	read back without touching the bus. The FIFO pointer and data registers are
+ *	not shadowed, nor is TEMP_CONFIG, whose enable bit clears itself once the
+ *	conversion is done.
+ */
+static const uint8_t shadowedRegisters[kWarpMAX30105ShadowRegisterCount] = {
+	INTERRUPT_ENABLE_1, INTERRUPT_ENABLE_2, FIFO_CONFIG, MODE_CONFIG, SPO2_CONFIG,
+	LED1_PULSE_AMPLITUDE, LED2_PULSE_AMPLITUDE, LED3_PULSE_AMPLITUDE, PROX_MODE_LED_PULSE_AMPLITUDE,
+	MULTI_LED_MODE_CONTROL_CONFIG, 0x12 /* Multi-LED mode control, slots 3 and 4 */, PROXIMITY_THRESHOLD};
+static uint8_t registerShadow[kWarpMAX30105ShadowRegisterCount];
+
+/*
+ *	FIFO_CONFIG, SPO2_CONFIG and LED2 (IR) amplitude for each acquisition profile.
+ */
+static const uint8_t profileRegisters[kWarpMAX30105ProfileCount][3] = {
+	{0x50, 0x6E, 0x3F}, // Sample averaging = 4, FIFO rolls on full; ADC range = 16384, 400 Hz, 215 us; 12.5 mA
+	{0x10, 0x65, 0x1F}, // No averaging, FIFO rolls on full; ADC range = 16384, 100 Hz, 118 us; 6.2 mA
+};
+
+static int8_t
+shadowIndex(uint8_t deviceRegister)
+{
+	for (int8_t i = 0; i < kWarpMAX30105ShadowRegisterCount; i++)
+	{
+		if (shadowedRegisters[i] == deviceRegister)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
 CommStatus
 writeSensorRegisterMAX30105(uint8_t deviceRegister, uint8_t payload)
 {
@@ -71,32 +106,65 @@ writeSensorRegisterMAX30105(uint8_t deviceRegister, uint8_t payload)
 		payloadByte,
 		1,
 		gWarpI2cTimeoutMilliseconds);
+	busConfigRecordI2cResult(status == kStatus_I2C_Success);
 
 	if (status != kStatus_I2C_Success)
 	{
 		return CommStatusDeviceCommunicationFailed;
 	}
 
+	int8_t index = shadowIndex(deviceRegister);
+	if (index >= 0)
+	{
+		registerShadow[index] = payload;
+	}
+
 	return CommStatusOK;
 }
 
+CommStatus
+getShadowRegisterMAX30105(uint8_t deviceRegister, uint8_t *payload)
+{
+	int8_t index = shadowIndex(deviceRegister);
+
+	if (index < 0)
+	{
+		return CommStatusBadDeviceCommand;
+	}
+	*payload = registerShadow[index];
+	return CommStatusOK;
+}
+
+/*
+ *	Switches the acquisition profile without stopping the sensor. Samples already
+ *	in the FIFO keep the settings they were taken with.
+ */
+CommStatus
+configureProfileMAX30105(uint8_t profile)
+{
+	if (profile >= kWarpMAX30105ProfileCount)
+	{
+		return CommStatusBadDeviceCommand;
+	}
+	return (
+		writeSensorRegisterMAX30105(FIFO_CONFIG, profileRegisters[profile][0]) |
+		writeSensorRegisterMAX30105(SPO2_CONFIG, profileRegisters[profile][1]) |
+		writeSensorRegisterMAX30105(LED2_PULSE_AMPLITUDE, profileRegisters[profile][2]));
+}
+
 CommStatus devMAX30105init(const uint8_t i2cAddress)
 {
 	deviceMAX30105State.i2cAddress = i2cAddress;
 	return (
 
-		writeSensorRegisterMAX30105(INTERRUPT_ENABLE_1, 0x10) | // SET INTERRUPT ENABLE: Data ready interrupt = Off, Proximity interrupt = On
+		writeSensorRegisterMAX30105(INTERRUPT_ENABLE_1, 0x50) | // SET INTERRUPT ENABLE: Data ready interrupt = On, Proximity interrupt = On
 
 		writeSensorRegisterMAX30105(PROXIMITY_THRESHOLD, (THRESHOLD_UP >> 10)) | // SET PROX THRESHOLD: Data ready interrupt = Off, Proximity interrupt = On
 
-		writeSensorRegisterMAX30105(FIFO_CONFIG, 0x50) | // SET FIFO: Sample averaging = 4, FIFO rolls on full = True
-
-		writeSensorRegisterMAX30105(SPO2_CONFIG, 0x6E) | // SET SPO2: ADC range = 16384, Sample rate = 400 Hz, Pulse width = 215 us
+		configureProfileMAX30105(kWarpMAX30105ProfileDefault) | // SET FIFO, SPO2 and LED2 (IR) PULSE AMPLITUDE
 
 		writeSensorRegisterMAX30105(LED1_PULSE_AMPLITUDE, 0x02) | // SET LED1 (RED) PULSE AMPLITUDE: Current level = 0.4 mA (0x02)
 
-		writeSensorRegisterMAX30105(LED2_PULSE_AMPLITUDE, 0x3F) | // SET LED2 (IR) PULSE AMPLITUDE: Current level = 12.5 mA (0x3F)
-
 		writeSensorRegisterMAX30105(LED3_PULSE_AMPLITUDE, 0x00) | // SET LED3 (GREEN) PULSE AMPLITUDE: Current level = 0.0 mA (0x00)
 
 		writeSensorRegisterMAX30105(PROX_MODE_LED_PULSE_AMPLITUDE, 0x02) | // SET LED PROXIMITY MODE PULSE AMPLITUDE: Current level = 0.4 mA (0x02)
@@ -165,6 +233,7 @@ readSensorRegisterMAX30105(uint8_t deviceRegister, int numberOfBytes)
 		(uint8_t *)deviceMAX30105State.i2cBuffer,
 		numberOfBytes,
 		gWarpI2cTimeoutMilliseconds);
+	busConfigRecordI2cResult(status == kStatus_I2C_Success);
 
 	if (status != kStatus_I2C_Success)
 	{
@@ -174,38 +243,64 @@ readSensorRegisterMAX30105(uint8_t deviceRegister, int numberOfBytes)
 	return CommStatusOK;
 }
 
-SamplingStatus readNextSample(uint16_t *sample)
-{
+WARP_STATIC_ASSERT(sizeof(((WarpI2CDeviceState *)0)->i2cBuffer) >= kWarpMAX30105FifoDepth * kWarpMAX30105BytesPerSample, "i2cBuffer must hold a burst of the whole sensor FIFO");
+WARP_STATIC_ASSERT((kWarpMAX30105FifoDepth & (kWarpMAX30105FifoDepth - 1)) == 0, "the FIFO pointers are subtracted modulo kWarpMAX30105FifoDepth");
 
-	CommStatus i2cReadStatus_FIFO_READ, i2cReadStatus_FIFO_WRITE, i2cReadStatus_FIFO_DATA;
+/*
+ *	Reads up to maxSamples samples from the sensor FIFO in a single I2C transfer,
+ *	leaving the raw samples in deviceMAX30105State.i2cBuffer for getBurstSample().
+ */
+SamplingStatus readSampleBurst(uint8_t maxSamples, uint8_t *sampleCount)
+{
+	CommStatus i2cReadStatus;
 
-	// Read READ pointer
-	i2cReadStatus_FIFO_READ = readSensorRegisterMAX30105(FIFO_READ, 1 /* numberOfBytes */);
-	uint8_t read_pointer = deviceMAX30105State.i2cBuffer[0];
+	*sampleCount = 0;
 
-	// Read WRITE pointer
-	i2cReadStatus_FIFO_WRITE = readSensorRegisterMAX30105(FIFO_WRITE, 1 /* numberOfBytes */);
+	// Read WRITE pointer, overflow counter and READ pointer, which are adjacent registers, in one transfer
+	i2cReadStatus = readSensorRegisterMAX30105(FIFO_WRITE, 3 /* numberOfBytes */);
+	if (i2cReadStatus != CommStatusOK)
+	{
+		return SamplingFailed;
+	}
 	uint8_t write_pointer = deviceMAX30105State.i2cBuffer[0];
+	uint8_t overflow = deviceMAX30105State.i2cBuffer[1];
+	uint8_t read_pointer = deviceMAX30105State.i2cBuffer[2];
+
+	// The overflow counter resets whenever a sample is read, so it only ever counts samples lost since the last read
+	gWarpMAX30105LostSamples += overflow;
 
-	if ((read_pointer == write_pointer))
+	// Equal pointers mean an empty FIFO, unless samples have been lost, in which case the FIFO is full
+	uint8_t available = (write_pointer - read_pointer) & (kWarpMAX30105FifoDepth - 1);
+	if ((available == 0) & (overflow != 0))
+	{
+		available = kWarpMAX30105FifoDepth;
+	}
+	if (available == 0)
 	{
 		return SampleNotUpdated;
 	}
-
-	i2cReadStatus_FIFO_DATA = readSensorRegisterMAX30105(FIFO_DATA, 6 /* numberOfBytes */);
-
-	if ((i2cReadStatus_FIFO_READ | i2cReadStatus_FIFO_WRITE | i2cReadStatus_FIFO_DATA) != CommStatusOK)
+	if (available > maxSamples)
 	{
-		return SamplingFailed;
+		available = maxSamples;
 	}
 
-	uint8_t data[6];
-	for (int i = 0; i < 6; i++)
+	i2cReadStatus = readSensorRegisterMAX30105(FIFO_DATA, available * kWarpMAX30105BytesPerSample);
+	if (i2cReadStatus != CommStatusOK)
 	{
-		data[i] = deviceMAX30105State.i2cBuffer[i];
+		return SamplingFailed;
 	}
 
-	*sample = (data[4] << 8) | (data[5]); // IR channel, discarding the two most significant bits that appear in byte data[3]
-
+	*sampleCount = available;
 	return SampleOK;
-}
\ No newline at end of file
+}
+
+/*
+ *	IR channel of a sample read by readSampleBurst(), discarding the two most
+ *	significant bits of the 18-bit value.
+ */
+uint16_t getBurstSample(uint8_t index)
+{
+	volatile uint8_t *data = &deviceMAX30105State.i2cBuffer[index * kWarpMAX30105BytesPerSample];
+
+	return (data[4] << 8) | (data[5]);
+}
@@ -5,4 +5,10 @@ CommStatus devMAX30105init(const uint8_t i2cAddress);
 
 CommStatus readSensorRegisterMAX30105(uint8_t deviceRegister, int numberOfBytes);
 
-CommStatus readNextSample(uint16_t *sample);
\ No newline at end of file
+SamplingStatus readSampleBurst(uint8_t maxSamples, uint8_t *sampleCount);
+
+uint16_t getBurstSample(uint8_t index);
+
+CommStatus getShadowRegisterMAX30105(uint8_t deviceRegister, uint8_t *payload);
+
+CommStatus configureProfileMAX30105(uint8_t profile);
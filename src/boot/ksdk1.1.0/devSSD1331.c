@@ -7,6 +7,7 @@
 #include "gpio_pins.h"
 #include "warp.h"
 #include "devSSD1331.h"
+#include "warp-busConfig.h"
 
 volatile uint8_t inBuffer[1];
 volatile uint8_t payloadBytes[1];
@@ -42,6 +43,35 @@ writeCommand(uint8_t commandByte)
 	 *	Drive /CS high
 	 */
 	GPIO_DRV_SetPinOutput(kSSD1331PinCSn);
+	busConfigRecordSpiResult(status == kStatus_SPI_Success);
+
+	return status;
+}
+
+/*
+ *	Sends a complete command (opcode and arguments) in a single SPI transfer, so /CS
+ *	and D/C are only toggled once per command rather than once per byte.
+ */
+static int
+writeCommandBuffer(const uint8_t *commandBytes, uint8_t commandByteCount)
+{
+	spi_status_t status;
+
+	GPIO_DRV_SetPinOutput(kSSD1331PinCSn);
+	OSA_TimeDelay(0);
+	GPIO_DRV_ClearPinOutput(kSSD1331PinCSn);
+
+	GPIO_DRV_ClearPinOutput(kSSD1331PinDC);
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */,
+											NULL /* spi_master_user_config_t */,
+											commandBytes,
+											NULL /* receive buffer */,
+											commandByteCount /* transfer size */,
+											1000 /* timeout in microseconds (unlike I2C which is ms) */);
+
+	GPIO_DRV_SetPinOutput(kSSD1331PinCSn);
+	busConfigRecordSpiResult(status == kStatus_SPI_Success);
 
 	return status;
 }
@@ -66,16 +96,55 @@ void clearScreen()
 	clearSection(0, 0, 95, 63);
 }
 
-void traceLine(uint8_t column, uint8_t prev, uint8_t next)
+/*
+ *	Trace colours (red, green, blue) indexed by SSD1331TraceQuality.
+ */
+static const uint8_t traceColours[kSSD1331TraceQualityLevels][3] = {
+	{0xFF, 0x00, 0x00}, // Poor: red
+	{0xFF, 0x20, 0x00}, // Fair: amber
+	{0x00, 0xFF, 0x00}, // Good: green
+};
+
+static void
+drawTraceSegment(uint8_t col_start, uint8_t row_start, uint8_t col_end, uint8_t row_end, uint8_t quality)
 {
-	writeCommand(kSSD1331CommandDRAWLINE);
-	writeCommand(column);	// Column start address
-	writeCommand(13 + prev); // Row start address (should be 63 - because display is upside down, but plot mirrored, and 13 + for heading bar)
-	writeCommand(column);	// Column end address
-	writeCommand(13 + next); // Row end address (should be 63 - because display is upside down, but plot mirrored, and 13 + for heading bar)
-	writeCommand(0xFF);		 // Red
-	writeCommand(0x00);		 // Green
-	writeCommand(0x00);		 // Blue
+	uint8_t commandBytes[8];
+
+	if (quality >= kSSD1331TraceQualityLevels)
+	{
+		quality = kSSD1331TraceQualityPoor;
+	}
+
+	commandBytes[0] = kSSD1331CommandDRAWLINE;
+	commandBytes[1] = col_start; // Column start address
+	commandBytes[2] = 13 + row_start; // Row start address (should be 63 - because display is upside down, but plot mirrored, and 13 + for heading bar)
+	commandBytes[3] = col_end; // Column end address
+	commandBytes[4] = 13 + row_end; // Row end address (should be 63 - because display is upside down, but plot mirrored, and 13 + for heading bar)
+	commandBytes[5] = traceColours[quality][0]; // Red
+	commandBytes[6] = traceColours[quality][1]; // Green
+	commandBytes[7] = traceColours[quality][2]; // Blue
+
+	writeCommandBuffer(commandBytes, sizeof(commandBytes));
+}
+
+// Draws a line joining the last point of the previous column to the next point in this column
+void traceLine(uint8_t column, uint8_t prev, uint8_t next, uint8_t quality)
+{
+	drawTraceSegment((column == 0) ? 0 : column - 1, prev, column, next, quality);
+}
+
+// Draws the min/max envelope of a decimated column, extended to meet the previous column so the trace stays connected
+void traceEnvelope(uint8_t column, uint8_t prev, uint8_t low, uint8_t high, uint8_t quality)
+{
+	if (prev < low)
+	{
+		low = prev;
+	}
+	else if (prev > high)
+	{
+		high = prev;
+	}
+	drawTraceSegment(column, low, column, high, quality);
 }
 
 // Draws digits in a 5x9 shaped box starting at the top left coordinates given
@@ -520,7 +589,299 @@ void writeCharacter(uint8_t column, uint8_t row, char character)
 	return;
 }
 
-int devSSD1331init(void)
+/*
+ *	5x7 bitmap font for the printable ASCII characters 0x20 to 0x7E, plus a degree
+ *	sign at 0x7F. Each glyph is five column bytes, least significant bit at the top.
+ */
+static const uint8_t font5x7[96][5] = {
+	{0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+	{0x00, 0x00, 0x5F, 0x00, 0x00}, // '!'
+	{0x00, 0x07, 0x00, 0x07, 0x00}, // '"'
+	{0x14, 0x7F, 0x14, 0x7F, 0x14}, // '#'
+	{0x24, 0x2A, 0x7F, 0x2A, 0x12}, // '$'
+	{0x23, 0x13, 0x08, 0x64, 0x62}, // '%'
+	{0x36, 0x49, 0x55, 0x22, 0x50}, // '&'
+	{0x00, 0x05, 0x03, 0x00, 0x00}, // '''
+	{0x00, 0x1C, 0x22, 0x41, 0x00}, // '('
+	{0x00, 0x41, 0x22, 0x1C, 0x00}, // ')'
+	{0x08, 0x2A, 0x1C, 0x2A, 0x08}, // '*'
+	{0x08, 0x08, 0x3E, 0x08, 0x08}, // '+'
+	{0x00, 0x50, 0x30, 0x00, 0x00}, // ','
+	{0x08, 0x08, 0x08, 0x08, 0x08}, // '-'
+	{0x00, 0x60, 0x60, 0x00, 0x00}, // '.'
+	{0x20, 0x10, 0x08, 0x04, 0x02}, // '/'
+	{0x3E, 0x51, 0x49, 0x45, 0x3E}, // '0'
+	{0x00, 0x42, 0x7F, 0x40, 0x00}, // '1'
+	{0x42, 0x61, 0x51, 0x49, 0x46}, // '2'
+	{0x21, 0x41, 0x45, 0x4B, 0x31}, // '3'
+	{0x18, 0x14, 0x12, 0x7F, 0x10}, // '4'
+	{0x27, 0x45, 0x45, 0x45, 0x39}, // '5'
+	{0x3C, 0x4A, 0x49, 0x49, 0x30}, // '6'
+	{0x01, 0x71, 0x09, 0x05, 0x03}, // '7'
+	{0x36, 0x49, 0x49, 0x49, 0x36}, // '8'
+	{0x06, 0x49, 0x49, 0x29, 0x1E}, // '9'
+	{0x00, 0x36, 0x36, 0x00, 0x00}, // ':'
+	{0x00, 0x56, 0x36, 0x00, 0x00}, // ';'
+	{0x08, 0x14, 0x22, 0x41, 0x00}, // '<'
+	{0x14, 0x14, 0x14, 0x14, 0x14}, // '='
+	{0x00, 0x41, 0x22, 0x14, 0x08}, // '>'
+	{0x02, 0x01, 0x51, 0x09, 0x06}, // '?'
+	{0x32, 0x49, 0x79, 0x41, 0x3E}, // '@'
+	{0x7E, 0x11, 0x11, 0x11, 0x7E}, // 'A'
+	{0x7F, 0x49, 0x49, 0x49, 0x36}, // 'B'
+	{0x3E, 0x41, 0x41, 0x41, 0x22}, // 'C'
+	{0x7F, 0x41, 0x41, 0x22, 0x1C}, // 'D'
+	{0x7F, 0x49, 0x49, 0x49, 0x41}, // 'E'
+	{0x7F, 0x09, 0x09, 0x01, 0x01}, // 'F'
+	{0x3E, 0x41, 0x41, 0x51, 0x32}, // 'G'
+	{0x7F, 0x08, 0x08, 0x08, 0x7F}, // 'H'
+	{0x00, 0x41, 0x7F, 0x41, 0x00}, // 'I'
+	{0x20, 0x40, 0x41, 0x3F, 0x01}, // 'J'
+	{0x7F, 0x08, 0x14, 0x22, 0x41}, // 'K'
+	{0x7F, 0x40, 0x40, 0x40, 0x40}, // 'L'
+	{0x7F, 0x02, 0x04, 0x02, 0x7F}, // 'M'
+	{0x7F, 0x04, 0x08, 0x10, 0x7F}, // 'N'
+	{0x3E, 0x41, 0x41, 0x41, 0x3E}, // 'O'
+	{0x7F, 0x09, 0x09, 0x09, 0x06}, // 'P'
+	{0x3E, 0x41, 0x51, 0x21, 0x5E}, // 'Q'
+	{0x7F, 0x09, 0x19, 0x29, 0x46}, // 'R'
+	{0x46, 0x49, 0x49, 0x49, 0x31}, // 'S'
+	{0x01, 0x01, 0x7F, 0x01, 0x01}, // 'T'
+	{0x3F, 0x40, 0x40, 0x40, 0x3F}, // 'U'
+	{0x1F, 0x20, 0x40, 0x20, 0x1F}, // 'V'
+	{0x7F, 0x20, 0x18, 0x20, 0x7F}, // 'W'
+	{0x63, 0x14, 0x08, 0x14, 0x63}, // 'X'
+	{0x03, 0x04, 0x78, 0x04, 0x03}, // 'Y'
+	{0x61, 0x51, 0x49, 0x45, 0x43}, // 'Z'
+	{0x00, 0x7F, 0x41, 0x41, 0x00}, // '['
+	{0x02, 0x04, 0x08, 0x10, 0x20}, // backslash
+	{0x00, 0x41, 0x41, 0x7F, 0x00}, // ']'
+	{0x04, 0x02, 0x01, 0x02, 0x04}, // '^'
+	{0x40, 0x40, 0x40, 0x40, 0x40}, // '_'
+	{0x00, 0x01, 0x02, 0x04, 0x00}, // '`'
+	{0x20, 0x54, 0x54, 0x54, 0x78}, // 'a'
+	{0x7F, 0x48, 0x44, 0x44, 0x38}, // 'b'
+	{0x38, 0x44, 0x44, 0x44, 0x20}, // 'c'
+	{0x38, 0x44, 0x44, 0x48, 0x7F}, // 'd'
+	{0x38, 0x54, 0x54, 0x54, 0x18}, // 'e'
+	{0x08, 0x7E, 0x09, 0x01, 0x02}, // 'f'
+	{0x0C, 0x52, 0x52, 0x52, 0x3E}, // 'g'
+	{0x7F, 0x08, 0x04, 0x04, 0x78}, // 'h'
+	{0x00, 0x44, 0x7D, 0x40, 0x00}, // 'i'
+	{0x20, 0x40, 0x44, 0x3D, 0x00}, // 'j'
+	{0x00, 0x7F, 0x10, 0x28, 0x44}, // 'k'
+	{0x00, 0x41, 0x7F, 0x40, 0x00}, // 'l'
+	{0x7C, 0x04, 0x18, 0x04, 0x78}, // 'm'
+	{0x7C, 0x08, 0x04, 0x04, 0x78}, // 'n'
+	{0x38, 0x44, 0x44, 0x44, 0x38}, // 'o'
+	{0x7C, 0x14, 0x14, 0x14, 0x08}, // 'p'
+	{0x08, 0x14, 0x14, 0x18, 0x7C}, // 'q'
+	{0x7C, 0x08, 0x04, 0x04, 0x08}, // 'r'
+	{0x48, 0x54, 0x54, 0x54, 0x20}, // 's'
+	{0x04, 0x3F, 0x44, 0x40, 0x20}, // 't'
+	{0x3C, 0x40, 0x40, 0x20, 0x7C}, // 'u'
+	{0x1C, 0x20, 0x40, 0x20, 0x1C}, // 'v'
+	{0x3C, 0x40, 0x30, 0x40, 0x3C}, // 'w'
+	{0x44, 0x28, 0x10, 0x28, 0x44}, // 'x'
+	{0x0C, 0x50, 0x50, 0x50, 0x3C}, // 'y'
+	{0x44, 0x64, 0x54, 0x4C, 0x44}, // 'z'
+	{0x00, 0x08, 0x36, 0x41, 0x00}, // '{'
+	{0x00, 0x00, 0x7F, 0x00, 0x00}, // '|'
+	{0x00, 0x41, 0x36, 0x08, 0x00}, // '}'
+	{0x08, 0x04, 0x08, 0x10, 0x08}, // '~'
+	{0x00, 0x06, 0x09, 0x09, 0x06}, // degree sign
+};
+
+/*
+ *	Selects a RAM window with SETCOLUMN/SETROW and leaves /CS asserted and D/C high,
+ *	so that everything sent up to endPixelWindow() is written into the window as
+ *	RGB565 pixels, left to right and top to bottom.
+ */
+static void
+beginPixelWindow(uint8_t col_start, uint8_t row_start, uint8_t col_end, uint8_t row_end)
+{
+	uint8_t commandBytes[6];
+	spi_status_t status;
+
+	commandBytes[0] = kSSD1331CommandSETCOLUMN;
+	commandBytes[1] = col_start;
+	commandBytes[2] = col_end;
+	commandBytes[3] = kSSD1331CommandSETROW;
+	commandBytes[4] = row_start;
+	commandBytes[5] = row_end;
+
+	GPIO_DRV_SetPinOutput(kSSD1331PinCSn);
+	OSA_TimeDelay(0);
+	GPIO_DRV_ClearPinOutput(kSSD1331PinCSn);
+
+	GPIO_DRV_ClearPinOutput(kSSD1331PinDC);
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */,
+						NULL /* spi_master_user_config_t */,
+						commandBytes,
+						NULL /* receive buffer */,
+						sizeof(commandBytes) /* transfer size */,
+						1000 /* timeout in microseconds (unlike I2C which is ms) */);
+	busConfigRecordSpiResult(status == kStatus_SPI_Success);
+
+	/*
+	 *	Drive DC high (data).
+	 */
+	GPIO_DRV_SetPinOutput(kSSD1331PinDC);
+}
+
+static int
+streamPixelBytes(const uint8_t *pixelBytes, uint16_t pixelByteCount)
+{
+	spi_status_t status;
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */,
+						NULL /* spi_master_user_config_t */,
+						pixelBytes,
+						NULL /* receive buffer */,
+						pixelByteCount /* transfer size */,
+						1000 /* timeout in microseconds (unlike I2C which is ms) */);
+	busConfigRecordSpiResult(status == kStatus_SPI_Success);
+
+	return status;
+}
+
+static void
+endPixelWindow(void)
+{
+	GPIO_DRV_SetPinOutput(kSSD1331PinCSn);
+	busConfigApplySpiStepDown();
+}
+
+// Writes a block of RGB565 pixels (two bytes per pixel, most significant byte first) into a window in one burst
+void writePixels(uint8_t col_start, uint8_t row_start, uint8_t col_end, uint8_t row_end, const uint8_t *pixelBytes, uint16_t pixelByteCount)
+{
+	beginPixelWindow(col_start, row_start, col_end, row_end);
+	streamPixelBytes(pixelBytes, pixelByteCount);
+	endPixelWindow();
+}
+
+/*
+ *	Writes a string in the 5x7 font (6x8 cells) with a black background, so no prior
+ *	clear is needed. The glyphs are expanded into RGB565 on the fly in a small chunk
+ *	buffer while /CS stays asserted, so the whole string is a single transaction.
+ *	Strings wider than the display are clipped.
+ */
+void writeString(uint8_t column, uint8_t row, const char *string, uint16_t colour)
+{
+	uint8_t chunk[32];
+	uint8_t chunkLength = 0;
+	uint8_t length = 0;
+
+	row = 63 - row; // Screen is upside down
+	while ((string[length] != '\0') & (column + 6 * (length + 1) <= 96))
+	{
+		length++;
+	}
+	if (length == 0)
+	{
+		return;
+	}
+
+	beginPixelWindow(column, row, column + 6 * length - 1, row + 7);
+	for (uint8_t pixelRow = 0; pixelRow < 8; pixelRow++)
+	{
+		for (uint8_t i = 0; i < length; i++)
+		{
+			uint8_t character = string[i];
+			const uint8_t *glyph = font5x7[((character < 0x20) | (character > 0x7F)) ? ('?' - 0x20) : (character - 0x20)];
+
+			for (uint8_t pixelColumn = 0; pixelColumn < 6; pixelColumn++)
+			{
+				uint16_t pixel = 0;
+
+				if ((pixelColumn < 5) && ((glyph[pixelColumn] >> pixelRow) & 0x01))
+				{
+					pixel = colour;
+				}
+				chunk[chunkLength++] = pixel >> 8;
+				chunk[chunkLength++] = pixel & 0xFF;
+				if (chunkLength == sizeof(chunk))
+				{
+					streamPixelBytes(chunk, chunkLength);
+					chunkLength = 0;
+				}
+			}
+		}
+	}
+	if (chunkLength > 0)
+	{
+		streamPixelBytes(chunk, chunkLength);
+	}
+	endPixelWindow();
+}
+
+/*
+ *	Initialization sequence, borrowed from https://github.com/adafruit/Adafruit-SSD1331-OLED-Driver-Library-for-Arduino
+ */
+static const uint8_t initSequence[] = {
+	kSSD1331CommandDISPLAYOFF,	// 0xAE
+	kSSD1331CommandSETREMAP,	// 0xA0
+	0x72,				// RGB Color
+	kSSD1331CommandSTARTLINE,	// 0xA1
+	0x0,
+	kSSD1331CommandDISPLAYOFFSET,	// 0xA2
+	0x0,
+	kSSD1331CommandNORMALDISPLAY,	// 0xA4
+	kSSD1331CommandSETMULTIPLEX,	// 0xA8
+	0x3F,				// 0x3F 1/64 duty
+	kSSD1331CommandSETMASTER,	// 0xAD
+	0x8E,
+	kSSD1331CommandPOWERMODE,	// 0xB0
+	0x0B,
+	kSSD1331CommandPRECHARGE,	// 0xB1
+	0x31,
+	kSSD1331CommandCLOCKDIV,	// 0xB3
+	0xF0,				// 7:4 = Oscillator Frequency, 3:0 = CLK Div Ratio (A[3:0]+1 = 1..16)
+	kSSD1331CommandPRECHARGEA,	// 0x8A
+	0x64,
+	kSSD1331CommandPRECHARGEB,	// 0x8B
+	0x78,
+	kSSD1331CommandPRECHARGEC,	// 0x8C
+	0x64,
+	kSSD1331CommandPRECHARGELEVEL,	// 0xBB
+	0x3A,
+	kSSD1331CommandVCOMH,		// 0xBE
+	0x3E,
+	kSSD1331CommandMASTERCURRENT,	// 0x87
+	0x0F,
+	kSSD1331CommandCONTRASTA,	// 0x81
+	0x91,
+	kSSD1331CommandCONTRASTB,	// 0x82
+	0x50,
+	kSSD1331CommandCONTRASTC,	// 0x83
+	0x7D,
+	kSSD1331CommandDISPLAYON,	// Turn on oled panel
+
+	/*
+	 *	To use fill commands, you will have to issue a command to the display to enable them. See the manual.
+	 */
+	kSSD1331CommandFILL,
+	0x01,
+};
+
+static SSD1331InitState initState = kSSD1331InitStateIdle;
+static uint16_t initResetDelayMilliseconds;
+static uint16_t initStateEnteredAt;
+
+static void
+enterInitState(SSD1331InitState state)
+{
+	initState = state;
+	initStateEnteredAt = OSA_TimeGetMsec(); // 16-bit LPTMR millisecond counter in the bare-metal OSA
+}
+
+/*
+ *	Starts a non-blocking initialisation: the reset pulse and the command sequence are
+ *	stepped through by devSSD1331initPoll(), so the caller can bring up other devices
+ *	while the reset delays elapse. The SSD1331 only needs a few microseconds of reset,
+ *	so resetDelayMilliseconds can be as small as 1 for a fast boot.
+ */
+void devSSD1331initStart(uint16_t resetDelayMilliseconds)
 {
 	/*
 	 *	Configure as GPIO.
@@ -530,63 +891,65 @@ int devSSD1331init(void)
 	PORT_HAL_SetMuxMode(PORTB_BASE, 0u, kPortMuxAsGpio);
 
 	/*
-	 *	RST high->low->high.
+	 *	RST high->low->high, one step per delay.
 	 */
+	initResetDelayMilliseconds = resetDelayMilliseconds;
 	GPIO_DRV_SetPinOutput(kSSD1331PinRST);
-	OSA_TimeDelay(100);
-	GPIO_DRV_ClearPinOutput(kSSD1331PinRST);
-	OSA_TimeDelay(100);
-	GPIO_DRV_SetPinOutput(kSSD1331PinRST);
-	OSA_TimeDelay(100);
+	enterInitState(kSSD1331InitStateResetHigh);
+}
 
-	/*
-	 *	Initialization sequence, borrowed from https://github.com/adafruit/Adafruit-SSD1331-OLED-Driver-Library-for-Arduino
-	 */
-	writeCommand(kSSD1331CommandDISPLAYOFF); // 0xAE
-	writeCommand(kSSD1331CommandSETREMAP);   // 0xA0
-	writeCommand(0x72);						 // RGB Color
-	writeCommand(kSSD1331CommandSTARTLINE);  // 0xA1
-	writeCommand(0x0);
-	writeCommand(kSSD1331CommandDISPLAYOFFSET); // 0xA2
-	writeCommand(0x0);
-	writeCommand(kSSD1331CommandNORMALDISPLAY); // 0xA4
-	writeCommand(kSSD1331CommandSETMULTIPLEX);  // 0xA8
-	writeCommand(0x3F);							// 0x3F 1/64 duty
-	writeCommand(kSSD1331CommandSETMASTER);		// 0xAD
-	writeCommand(0x8E);
-	writeCommand(kSSD1331CommandPOWERMODE); // 0xB0
-	writeCommand(0x0B);
-	writeCommand(kSSD1331CommandPRECHARGE); // 0xB1
-	writeCommand(0x31);
-	writeCommand(kSSD1331CommandCLOCKDIV);   // 0xB3
-	writeCommand(0xF0);						 // 7:4 = Oscillator Frequency, 3:0 = CLK Div Ratio (A[3:0]+1 = 1..16)
-	writeCommand(kSSD1331CommandPRECHARGEA); // 0x8A
-	writeCommand(0x64);
-	writeCommand(kSSD1331CommandPRECHARGEB); // 0x8B
-	writeCommand(0x78);
-	writeCommand(kSSD1331CommandPRECHARGEA); // 0x8C
-	writeCommand(0x64);
-	writeCommand(kSSD1331CommandPRECHARGELEVEL); // 0xBB
-	writeCommand(0x3A);
-	writeCommand(kSSD1331CommandVCOMH); // 0xBE
-	writeCommand(0x3E);
-	writeCommand(kSSD1331CommandMASTERCURRENT); // 0x87
-	writeCommand(0x0F);
-	writeCommand(kSSD1331CommandCONTRASTA); // 0x81
-	writeCommand(0x91);
-	writeCommand(kSSD1331CommandCONTRASTB); // 0x82
-	writeCommand(0x50);
-	writeCommand(kSSD1331CommandCONTRASTC); // 0x83
-	writeCommand(0x7D);
-	writeCommand(kSSD1331CommandDISPLAYON); // Turn on oled panel
+/*
+ *	Advances the initialisation state machine if the current step's delay has elapsed.
+ *	Returns true once the display is initialised and cleared.
+ */
+bool devSSD1331initPoll(void)
+{
+	if ((initState == kSSD1331InitStateIdle) | (initState == kSSD1331InitStateDone))
+	{
+		return initState == kSSD1331InitStateDone;
+	}
 
-	/*
-	 *	To use fill commands, you will have to issue a command to the display to enable them. See the manual.
-	 */
-	writeCommand(kSSD1331CommandFILL);
-	writeCommand(0x01);
+	if ((uint16_t)(OSA_TimeGetMsec() - initStateEnteredAt) < initResetDelayMilliseconds)
+	{
+		return false;
+	}
 
-	clearScreen();
+	switch (initState)
+	{
+	case kSSD1331InitStateResetHigh:
+	{
+		GPIO_DRV_ClearPinOutput(kSSD1331PinRST);
+		enterInitState(kSSD1331InitStateResetLow);
+		break;
+	}
+	case kSSD1331InitStateResetLow:
+	{
+		GPIO_DRV_SetPinOutput(kSSD1331PinRST);
+		enterInitState(kSSD1331InitStateResetRelease);
+		break;
+	}
+	case kSSD1331InitStateResetRelease:
+	{
+		writeCommandBuffer(initSequence, sizeof(initSequence));
+		clearScreen();
+		enterInitState(kSSD1331InitStateDone);
+		break;
+	}
+	default:
+	{
+		break;
+	}
+	}
+
+	return initState == kSSD1331InitStateDone;
+}
+
+int devSSD1331init(void)
+{
+	devSSD1331initStart(100);
+	while (!devSSD1331initPoll())
+	{
+	}
 
 	return 0;
 }
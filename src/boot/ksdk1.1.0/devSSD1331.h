@@ -40,18 +40,55 @@ typedef enum
 	kSSD1331CommandPRECHARGEC = 0x8C,
 	kSSD1331CommandPRECHARGELEVEL = 0xBB,
 	kSSD1331CommandVCOMH = 0xBE,
+	kSSD1331CommandNOP = 0xE3,
 } SSD1331Commands;
 
+typedef enum
+{
+	kSSD1331InitStateIdle = 0,
+	kSSD1331InitStateResetHigh,
+	kSSD1331InitStateResetLow,
+	kSSD1331InitStateResetRelease,
+	kSSD1331InitStateDone,
+} SSD1331InitState;
+
+typedef enum
+{
+	kSSD1331ColourBlack = 0x0000, // RGB565
+	kSSD1331ColourWhite = 0xFFFF,
+	kSSD1331ColourRed = 0xF800,
+	kSSD1331ColourAmber = 0xFC00,
+	kSSD1331ColourGreen = 0x07E0,
+} SSD1331Colours;
+
+typedef enum
+{
+	kSSD1331TraceQualityPoor = 0,
+	kSSD1331TraceQualityFair,
+	kSSD1331TraceQualityGood,
+	kSSD1331TraceQualityLevels,
+} SSD1331TraceQuality;
+
 void clearSection(uint8_t col_start, uint8_t row_start, uint8_t col_end, uint8_t row_end);
 
 void clearTraceArea(void);
 
 void clearScreen(void);
 
-void traceLine(uint8_t column, uint8_t prev, uint8_t next);
+void traceLine(uint8_t column, uint8_t prev, uint8_t next, uint8_t quality);
+
+void traceEnvelope(uint8_t column, uint8_t prev, uint8_t low, uint8_t high, uint8_t quality);
 
 void writeDigit(uint8_t column, uint8_t row, uint8_t digit);
 
 void writeCharacter(uint8_t column, uint8_t row, char character);
 
+void writePixels(uint8_t col_start, uint8_t row_start, uint8_t col_end, uint8_t row_end, const uint8_t *pixelBytes, uint16_t pixelByteCount);
+
+void writeString(uint8_t column, uint8_t row, const char *string, uint16_t colour);
+
+void devSSD1331initStart(uint16_t resetDelayMilliseconds);
+
+bool devSSD1331initPoll(void);
+
 int devSSD1331init(void);
@@ -0,0 +1,445 @@
+/*
+ *	Host-side check of btstack/hal_uart_dma.c against a fake LPUART0 behind the
+ *	KSDK driver and HAL signatures in stub/. The fake controller on the other
+ *	end sends while RTS is asserted and, like a real one, a few bytes more after
+ *	it is deasserted. Checks the block send and receive contract, that RTS is
+ *	deasserted at the end of each block, that the late bytes are carried over to
+ *	the next block through the 8-byte ring in order, and that set_baud waits for
+ *	the shift register to empty before touching the transmitter. Returns
+ *	non-zero on the first mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fsl_device_registers.h"
+#include "fsl_clock_manager.h"
+#include "fsl_mcglite_hal.h"
+#include "fsl_port_hal.h"
+#include "fsl_gpio_hal.h"
+#include "fsl_lpuart_driver.h"
+
+#include "hal_uart_dma.h"
+
+enum
+{
+	kTestRtsPin = 6,
+	kTestRingSize = 8,
+	kTestStreamLength = 4096,
+};
+
+void LPUART0_IRQHandler(void);
+
+/*
+ *	The fake LPUART0 and its interrupt line.
+ */
+static lpuart_state_t * lpuartState;
+static lpuart_rx_callback_t rxCallback;
+static uint8_t * rxByte;
+static bool rxIrqEnabled;
+static bool rtsDeasserted;
+static bool irqMasked;
+static bool uartNeededDuringSleep;
+static bool transmitterEnabled;
+static bool receiverEnabled;
+static uint32_t baudRate;
+static uint8_t txCompletePolls; // TC reads as clear this many more times
+static bool transmitterDisabledBeforeTxComplete;
+
+static bool rxPending;
+static uint8_t rxPendingByte;
+
+static uint8_t wire[64];
+static uint16_t wireLength;
+
+/*
+ *	The fake controller's stream to the host.
+ */
+static uint8_t stream[kTestStreamLength];
+static uint16_t streamSent;
+
+static uint16_t blocksSent;
+static uint16_t blocksReceived;
+
+uint32_t
+__get_PRIMASK(void)
+{
+	return irqMasked;
+}
+
+void
+__set_PRIMASK(uint32_t primask)
+{
+	irqMasked = primask;
+}
+
+void
+__disable_irq(void)
+{
+	irqMasked = true;
+}
+
+uint32_t
+CLOCK_SYS_GetLpuartFreq(uint32_t instance)
+{
+	(void)instance;
+	return 48000000;
+}
+
+void
+CLOCK_HAL_SetHircCmd(uint32_t baseAddr, bool enable)
+{
+	(void)baseAddr;
+	(void)enable;
+}
+
+void
+PORT_HAL_SetMuxMode(uint32_t baseAddr, uint32_t pin, port_mux_t mux)
+{
+	(void)baseAddr;
+	(void)pin;
+	(void)mux;
+}
+
+void
+GPIO_HAL_SetPinDir(uint32_t baseAddr, uint32_t pin, gpio_pin_direction_t direction)
+{
+	(void)baseAddr;
+	(void)pin;
+	(void)direction;
+}
+
+void
+GPIO_HAL_SetPinOutput(uint32_t baseAddr, uint32_t pin)
+{
+	if ((baseAddr == GPIOA_BASE) && (pin == kTestRtsPin))
+	{
+		rtsDeasserted = true;
+	}
+}
+
+void
+GPIO_HAL_ClearPinOutput(uint32_t baseAddr, uint32_t pin)
+{
+	if ((baseAddr == GPIOA_BASE) && (pin == kTestRtsPin))
+	{
+		rtsDeasserted = false;
+	}
+}
+
+void
+hal_cpu_set_uart_needed_during_sleep(uint8_t enabled)
+{
+	uartNeededDuringSleep = enabled;
+}
+
+lpuart_status_t
+LPUART_DRV_Init(uint32_t instance, lpuart_state_t * lpuartStatePtr, const lpuart_user_config_t * lpuartUserConfig)
+{
+	(void)instance;
+	memset(lpuartStatePtr, 0, sizeof(*lpuartStatePtr));
+	lpuartState = lpuartStatePtr;
+	baudRate = lpuartUserConfig->baudRate;
+	transmitterEnabled = true;
+	receiverEnabled = true;
+	return kStatus_LPUART_Success;
+}
+
+lpuart_rx_callback_t
+LPUART_DRV_InstallRxCallback(uint32_t instance, lpuart_rx_callback_t function, uint8_t * rxBuff, void * callbackParam, bool alwaysEnableRxIrq)
+{
+	(void)instance;
+	(void)callbackParam;
+	rxCallback = function;
+	rxByte = rxBuff;
+	rxIrqEnabled = alwaysEnableRxIrq;
+	return NULL;
+}
+
+lpuart_status_t
+LPUART_DRV_SendData(uint32_t instance, const uint8_t * txBuff, uint32_t txSize)
+{
+	(void)instance;
+	lpuartState->txBuff = txBuff;
+	lpuartState->txSize = txSize;
+	lpuartState->isTxBusy = true;
+	return kStatus_LPUART_Success;
+}
+
+/*
+ *	One interrupt: a received byte takes precedence, otherwise one byte leaves
+ *	the transmit buffer, and the transmit ends with the last one.
+ */
+void
+LPUART_DRV_IrqHandler(uint32_t instance)
+{
+	(void)instance;
+	if (rxPending)
+	{
+		rxPending = false;
+		*rxByte = rxPendingByte;
+		rxCallback(0, lpuartState);
+		return;
+	}
+	if (lpuartState->isTxBusy)
+	{
+		wire[wireLength++] = *lpuartState->txBuff++;
+		if (--lpuartState->txSize == 0)
+		{
+			lpuartState->isTxBusy = false;
+		}
+	}
+}
+
+bool
+LPUART_HAL_GetStatusFlag(uint32_t baseAddr, lpuart_status_flag_t statusFlag)
+{
+	(void)baseAddr;
+	if ((statusFlag == kLpuartTxComplete) && (txCompletePolls > 0))
+	{
+		txCompletePolls--;
+		return false;
+	}
+	return true;
+}
+
+void
+LPUART_HAL_SetTransmitterCmd(uint32_t baseAddr, bool enable)
+{
+	(void)baseAddr;
+	if (!enable && (txCompletePolls > 0))
+	{
+		transmitterDisabledBeforeTxComplete = true;
+	}
+	transmitterEnabled = enable;
+}
+
+void
+LPUART_HAL_SetReceiverCmd(uint32_t baseAddr, bool enable)
+{
+	(void)baseAddr;
+	receiverEnabled = enable;
+}
+
+lpuart_status_t
+LPUART_HAL_SetBaudRate(uint32_t baseAddr, uint32_t sourceClockInHz, uint32_t desiredBaudRate)
+{
+	(void)baseAddr;
+	if (transmitterEnabled || receiverEnabled)
+	{
+		return kStatus_LPUART_BaudRateCalculationError;
+	}
+	if (desiredBaudRate > sourceClockInHz / 4)
+	{
+		return kStatus_LPUART_BaudRateCalculationError;
+	}
+	baudRate = desiredBaudRate;
+	return kStatus_LPUART_Success;
+}
+
+static void
+blockSent(void)
+{
+	blocksSent++;
+}
+
+static void
+blockReceived(void)
+{
+	blocksReceived++;
+}
+
+/*
+ *	The controller sends from its stream while RTS is asserted, then up to
+ *	lateBytes more once RTS has been deasserted.
+ */
+static void
+controllerSend(uint8_t lateBytes)
+{
+	while (streamSent < kTestStreamLength)
+	{
+		if (rtsDeasserted)
+		{
+			if (lateBytes == 0)
+			{
+				return;
+			}
+			lateBytes--;
+		}
+		rxPending = true;
+		rxPendingByte = stream[streamSent++];
+		LPUART0_IRQHandler();
+	}
+}
+
+static int
+testInit(void)
+{
+	hal_uart_dma_init();
+	hal_uart_dma_set_block_sent(&blockSent);
+	hal_uart_dma_set_block_received(&blockReceived);
+
+	if (!rtsDeasserted || !rxIrqEnabled || !uartNeededDuringSleep || (baudRate != 115200))
+	{
+		printf("After init: RTS %s, receive interrupt %s, UART needed during sleep %u, %u baud\n",
+			rtsDeasserted ? "deasserted" : "asserted", rxIrqEnabled ? "on" : "off", uartNeededDuringSleep, baudRate);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+testSendBlock(void)
+{
+	static const uint8_t command[] = {0x01, 0x03, 0x0C, 0x00};
+	uint8_t drained[3];
+
+	for (uint8_t round = 0; round < 3; round++)
+	{
+		uint16_t before = blocksSent;
+
+		wireLength = 0;
+		hal_uart_dma_send_block(command, sizeof(command));
+		while (lpuartState->isTxBusy)
+		{
+			if (blocksSent != before)
+			{
+				printf("block_sent called after %u of %u bytes\n", wireLength, (unsigned)sizeof(command));
+				return 1;
+			}
+			LPUART0_IRQHandler();
+		}
+		if ((blocksSent != before + 1) || (wireLength != sizeof(command)) || memcmp(wire, command, sizeof(command)))
+		{
+			printf("Send %u: block_sent called %u times, %u bytes on the wire\n", round, blocksSent - before, wireLength);
+			return 1;
+		}
+
+		// A received byte, with nothing being sent, is not the end of a send
+		rxPending = true;
+		rxPendingByte = 0;
+		LPUART0_IRQHandler();
+		if (blocksSent != before + 1)
+		{
+			printf("block_sent called from a receive interrupt\n");
+			return 1;
+		}
+	}
+
+	// Those bytes arrived with no block requested, and wait in the ring
+	blocksReceived = 0;
+	hal_uart_dma_receive_block(drained, sizeof(drained));
+	if (blocksReceived != 1)
+	{
+		printf("The ring did not hand over the %u bytes received between blocks\n", (unsigned)sizeof(drained));
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ *	Reads the controller's stream back in blocks of every size from 1 to 20
+ *	bytes, with 0 to 8 late bytes after each, so that the ring is drained at
+ *	every offset and blocks are satisfied from it alone, from it and the wire,
+ *	and from the wire alone.
+ */
+static int
+testReceiveBlocks(void)
+{
+	uint8_t block[20];
+	uint16_t received = 0;
+
+	for (uint16_t i = 0; i < kTestStreamLength; i++)
+	{
+		stream[i] = (uint8_t)(i * 7 + i / 256);
+	}
+	streamSent = 0;
+	blocksReceived = 0;
+
+	for (uint16_t round = 0; received + sizeof(block) + kTestRingSize < kTestStreamLength; round++)
+	{
+		uint8_t length = 1 + round % sizeof(block);
+		uint16_t queued = streamSent - received;
+
+		memset(block, 0xEE, sizeof(block));
+		hal_uart_dma_receive_block(block, length);
+		if (irqMasked)
+		{
+			printf("Round %u: receive_block left interrupts masked\n", round);
+			return 1;
+		}
+		if (length <= queued)
+		{
+			if (!rtsDeasserted || (blocksReceived != round + 1))
+			{
+				printf("Round %u: %u of %u bytes in the ring, RTS %s, %u blocks\n", round, queued, length, rtsDeasserted ? "deasserted" : "asserted", blocksReceived);
+				return 1;
+			}
+		}
+		else
+		{
+			if (rtsDeasserted || (blocksReceived != round))
+			{
+				printf("Round %u: waiting for %u bytes, RTS %s, %u blocks\n", round, length - queued, rtsDeasserted ? "deasserted" : "asserted", blocksReceived);
+				return 1;
+			}
+			controllerSend(round % (kTestRingSize + 1));
+			if (!rtsDeasserted || (blocksReceived != round + 1))
+			{
+				printf("Round %u: RTS %s after the block, %u blocks\n", round, rtsDeasserted ? "deasserted" : "asserted", blocksReceived);
+				return 1;
+			}
+		}
+		if (memcmp(block, &stream[received], length) || ((length < sizeof(block)) && (block[length] != 0xEE)))
+		{
+			printf("Round %u: block of %u bytes from stream offset %u differs, or was overrun\n", round, length, received);
+			return 1;
+		}
+		received += length;
+	}
+	return 0;
+}
+
+static int
+testSetBaud(void)
+{
+	txCompletePolls = 5;
+	transmitterDisabledBeforeTxComplete = false;
+
+	if (hal_uart_dma_set_baud(921600) != 0)
+	{
+		printf("set_baud(921600) failed\n");
+		return 1;
+	}
+	if (transmitterDisabledBeforeTxComplete || (txCompletePolls != 0))
+	{
+		printf("set_baud disabled the transmitter before the shift register emptied\n");
+		return 1;
+	}
+	if ((baudRate != 921600) || !transmitterEnabled || !receiverEnabled)
+	{
+		printf("After set_baud: %u baud, transmitter %s, receiver %s\n", baudRate, transmitterEnabled ? "on" : "off", receiverEnabled ? "on" : "off");
+		return 1;
+	}
+	if (hal_uart_dma_set_baud(48000000) == 0)
+	{
+		printf("set_baud accepted a rate the clock cannot make\n");
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	int failures = testInit();
+
+	if (!failures)
+	{
+		failures = testSendBlock() + testReceiveBlocks() + testSetBaud();
+	}
+	printf("%s\n", failures ? "FAILED" : "OK");
+	return failures;
+}
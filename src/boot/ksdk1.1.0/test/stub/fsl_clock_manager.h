@@ -0,0 +1,9 @@
+/*
+ *	Stands in for the KSDK clock manager for the host tests.
+ */
+typedef enum
+{
+	kClockLpuartSrcIrc48M = 1,
+} clock_lpuart_src_t;
+
+uint32_t CLOCK_SYS_GetLpuartFreq(uint32_t instance);
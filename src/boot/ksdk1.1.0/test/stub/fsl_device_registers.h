@@ -0,0 +1,17 @@
+/*
+ *	Stands in for the KSDK device header for the host tests: the base addresses
+ *	and interrupt masking that hal_uart_dma.c uses. The test provides the
+ *	functions.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MCG_BASE	0x40064000u
+#define PORTA_BASE	0x40049000u
+#define PORTB_BASE	0x4004A000u
+#define GPIOA_BASE	0x400FF000u
+#define LPUART0_BASE	0x40054000u
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
@@ -0,0 +1,12 @@
+/*
+ *	Stands in for the KSDK GPIO HAL for the host tests.
+ */
+typedef enum
+{
+	kGpioDigitalInput = 0,
+	kGpioDigitalOutput = 1,
+} gpio_pin_direction_t;
+
+void GPIO_HAL_SetPinDir(uint32_t baseAddr, uint32_t pin, gpio_pin_direction_t direction);
+void GPIO_HAL_SetPinOutput(uint32_t baseAddr, uint32_t pin);
+void GPIO_HAL_ClearPinOutput(uint32_t baseAddr, uint32_t pin);
@@ -0,0 +1,58 @@
+/*
+ *	Stands in for the KSDK LPUART driver and HAL for the host tests, with the
+ *	same types and signatures. The test provides a fake LPUART behind them.
+ */
+#include <stddef.h>
+
+typedef enum
+{
+	kStatus_LPUART_Success = 0x00U,
+	kStatus_LPUART_BaudRateCalculationError = 0x01U,
+} lpuart_status_t;
+
+typedef enum
+{
+	kLpuartTxComplete = 1,
+} lpuart_status_flag_t;
+
+typedef enum
+{
+	kLpuartParityDisabled = 0x0U,
+} lpuart_parity_mode_t;
+
+typedef enum
+{
+	kLpuartOneStopBit = 0x0U,
+} lpuart_stop_bit_count_t;
+
+typedef enum
+{
+	kLpuart8BitsPerChar = 0x0U,
+} lpuart_bit_count_per_char_t;
+
+typedef void (* lpuart_rx_callback_t)(uint32_t instance, void * lpuartState);
+
+typedef struct LpuartState
+{
+	const uint8_t * txBuff;
+	volatile size_t txSize;
+	volatile bool isTxBusy;
+} lpuart_state_t;
+
+typedef struct LpuartUserConfig
+{
+	clock_lpuart_src_t clockSource;
+	uint32_t baudRate;
+	lpuart_parity_mode_t parityMode;
+	lpuart_stop_bit_count_t stopBitCount;
+	lpuart_bit_count_per_char_t bitCountPerChar;
+} lpuart_user_config_t;
+
+lpuart_status_t LPUART_DRV_Init(uint32_t instance, lpuart_state_t * lpuartStatePtr, const lpuart_user_config_t * lpuartUserConfig);
+lpuart_rx_callback_t LPUART_DRV_InstallRxCallback(uint32_t instance, lpuart_rx_callback_t function, uint8_t * rxBuff, void * callbackParam, bool alwaysEnableRxIrq);
+lpuart_status_t LPUART_DRV_SendData(uint32_t instance, const uint8_t * txBuff, uint32_t txSize);
+
+bool LPUART_HAL_GetStatusFlag(uint32_t baseAddr, lpuart_status_flag_t statusFlag);
+void LPUART_HAL_SetTransmitterCmd(uint32_t baseAddr, bool enable);
+void LPUART_HAL_SetReceiverCmd(uint32_t baseAddr, bool enable);
+lpuart_status_t LPUART_HAL_SetBaudRate(uint32_t baseAddr, uint32_t sourceClockInHz, uint32_t desiredBaudRate);
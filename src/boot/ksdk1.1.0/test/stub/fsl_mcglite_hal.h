@@ -0,0 +1,4 @@
+/*
+ *	Stands in for the KSDK MCG_Lite HAL for the host tests.
+ */
+void CLOCK_HAL_SetHircCmd(uint32_t baseAddr, bool enable);
@@ -0,0 +1,10 @@
+/*
+ *	Stands in for the KSDK PORT HAL for the host tests.
+ */
+typedef enum
+{
+	kPortMuxAsGpio = 1U,
+	kPortMuxAlt2 = 2U,
+} port_mux_t;
+
+void PORT_HAL_SetMuxMode(uint32_t baseAddr, uint32_t pin, port_mux_t mux);
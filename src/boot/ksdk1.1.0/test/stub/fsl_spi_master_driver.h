@@ -0,0 +1,4 @@
+/*
+ *	Stands in for the KSDK header that warp.h includes, so that the modules with
+ *	no hardware dependencies build on the host. None of its declarations are used.
+ */
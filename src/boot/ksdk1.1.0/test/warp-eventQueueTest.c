@@ -0,0 +1,76 @@
+/*
+ *	Host-side check of warp-eventQueue: events come out in order with their
+ *	arguments, a full queue drops and counts pushes, and the free-running
+ *	indices survive wrapping past 255. Returns non-zero on the first mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "warp-eventQueue.h"
+
+int
+main(void)
+{
+	WarpEvent event;
+	uint16_t pushed = 0;
+	uint16_t popped = 0;
+
+	if (eventQueuePop(&event))
+	{
+		printf("Popped an event from an empty queue\n");
+		return 1;
+	}
+
+	// Fill and drain in uneven steps, so the indices wrap at every offset
+	for (uint16_t round = 0; round < 1000; round++)
+	{
+		uint8_t burst = 1 + round % kWarpEventQueueLength;
+
+		for (uint8_t i = 0; i < burst; i++)
+		{
+			if (!eventQueuePush(kWarpEventSensorInterrupt, pushed))
+			{
+				printf("Push %u failed with %u of %u queued\n", pushed, pushed - popped, kWarpEventQueueLength);
+				return 1;
+			}
+			pushed++;
+		}
+		while (eventQueuePop(&event))
+		{
+			if ((event.tag != kWarpEventSensorInterrupt) || (event.argument != popped))
+			{
+				printf("Popped tag %u argument %u, expected tag %u argument %u\n", event.tag, event.argument, kWarpEventSensorInterrupt, popped);
+				return 1;
+			}
+			popped++;
+		}
+		if (popped != pushed)
+		{
+			printf("Popped %u of %u events\n", popped, pushed);
+			return 1;
+		}
+	}
+
+	for (uint8_t i = 0; i < kWarpEventQueueLength; i++)
+	{
+		eventQueuePush(kWarpEventSensorInterrupt, i);
+	}
+	if (eventQueuePush(kWarpEventSensorInterrupt, 0) || eventQueuePush(kWarpEventSensorInterrupt, 0) || (eventQueueGetDropped() != 2))
+	{
+		printf("A full queue took an event, or dropped %u rather than 2\n", eventQueueGetDropped());
+		return 1;
+	}
+	for (uint8_t i = 0; i < kWarpEventQueueLength; i++)
+	{
+		if (!eventQueuePop(&event) || (event.argument != i))
+		{
+			printf("Event %u lost or out of order after an overflow\n", i);
+			return 1;
+		}
+	}
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ *	Host-side check of warp-fixedPoint against the C operators. Every 16-bit
+ *	divisor is checked with every 16-bit dividend and with the dividends either
+ *	side of each multiple near the top of the 32-bit range, so it takes a few
+ *	seconds. Returns non-zero on the first mismatch.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "warp-fixedPoint.h"
+
+static int
+fail(const char *what, uint32_t a, uint32_t b, uint32_t got, uint32_t expected)
+{
+	printf("%s(0x%08x, 0x%08x) = 0x%08x, expected 0x%08x\n", what, a, b, got, expected);
+	return 1;
+}
+
+static int
+testMultiplyHigh(void)
+{
+	static const uint32_t edges[] = {0, 1, 2, 0xFFFF, 0x10000, 0x10001, 0x7FFFFFFF, 0x80000000, 0xFFFEFFFF, 0xFFFFFFFE, 0xFFFFFFFF};
+	uint32_t a = 1;
+	uint32_t b = 1;
+
+	for (unsigned i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+	{
+		for (unsigned j = 0; j < sizeof(edges) / sizeof(edges[0]); j++)
+		{
+			uint32_t expected = ((uint64_t)edges[i] * edges[j]) >> 32;
+			if (fixedPointMultiplyHigh(edges[i], edges[j]) != expected)
+			{
+				return fail("fixedPointMultiplyHigh", edges[i], edges[j], fixedPointMultiplyHigh(edges[i], edges[j]), expected);
+			}
+		}
+	}
+
+	// Two xorshift sequences
+	for (uint32_t i = 0; i < 100000000; i++)
+	{
+		a ^= a << 13;
+		a ^= a >> 17;
+		a ^= a << 5;
+		b ^= b << 7;
+		b ^= b >> 9;
+		b ^= b << 8;
+		uint32_t expected = ((uint64_t)a * b) >> 32;
+		if (fixedPointMultiplyHigh(a, b) != expected)
+		{
+			return fail("fixedPointMultiplyHigh", a, b, fixedPointMultiplyHigh(a, b), expected);
+		}
+	}
+	return 0;
+}
+
+static int
+testDivide(void)
+{
+	for (uint32_t divisor = 1; divisor <= 0xFFFF; divisor++)
+	{
+		uint32_t reciprocal = fixedPointReciprocal(divisor);
+		if (reciprocal != 0xFFFFFFFF / divisor)
+		{
+			return fail("fixedPointReciprocal", divisor, 0, reciprocal, 0xFFFFFFFF / divisor);
+		}
+
+		for (uint32_t dividend = 0; dividend <= 0xFFFF; dividend++)
+		{
+			if (fixedPointDivide(dividend, divisor, reciprocal) != dividend / divisor)
+			{
+				return fail("fixedPointDivide", dividend, divisor, fixedPointDivide(dividend, divisor, reciprocal), dividend / divisor);
+			}
+		}
+
+		// Either side of the last 256 multiples below 2^32, where the reciprocal's error is largest
+		for (uint32_t multiple = 0xFFFFFFFF / divisor * divisor, count = 0; count < 256 && multiple >= divisor; multiple -= divisor, count++)
+		{
+			uint32_t dividends[3] = {multiple - 1, multiple, multiple + divisor - 1};
+			for (unsigned i = 0; i < 3; i++)
+			{
+				if (fixedPointDivide(dividends[i], divisor, reciprocal) != dividends[i] / divisor)
+				{
+					return fail("fixedPointDivide", dividends[i], divisor, fixedPointDivide(dividends[i], divisor, reciprocal), dividends[i] / divisor);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static int
+testDecimal(void)
+{
+	for (uint32_t value = 0; value <= 0xFFFF; value++)
+	{
+		uint32_t expected = 0;
+		for (uint32_t rest = value, shift = 0; rest; rest /= 10, shift += 4)
+		{
+			expected |= (rest % 10) << shift;
+		}
+
+		if (fixedPointDivideBy10(value) != value / 10)
+		{
+			return fail("fixedPointDivideBy10", value, 0, fixedPointDivideBy10(value), value / 10);
+		}
+		if (fixedPointToBcd(value) != expected)
+		{
+			return fail("fixedPointToBcd", value, 0, fixedPointToBcd(value), expected);
+		}
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	int failures = testMultiplyHigh() + testDivide() + testDecimal();
+
+	printf("%s\n", failures ? "FAILED" : "OK");
+	return failures;
+}
@@ -0,0 +1,265 @@
+/*
+ *	Host-side check and benchmark of warp-pipeline. A synthetic pulse train goes
+ *	through pipelineProcess() in blocks of 1, 4, 8 and 32 samples, and every
+ *	output is compared with a plain per-sample implementation of the same
+ *	filter, normaliser and detector. The IIR filter, which has no reference, is
+ *	checked for giving the same output whatever the block size. Each block size
+ *	is then timed; the host figures only rank the block sizes, the cycles on the
+ *	target come from warp-profileReport.py. Returns non-zero on the first
+ *	mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "warp-fixedPoint.h"
+#include "warp-pipeline.h"
+
+enum
+{
+	kTestSamples = 20000,
+	kTestBenchmarkPasses = 50,
+};
+
+static const uint8_t blockSizes[] = {1, 4, 8, 32};
+
+static uint16_t signal[kTestSamples];
+
+/*
+ *	About 70 beats per minute at 100 Hz: a fast rise, a slow fall, a slowly
+ *	wandering baseline and some noise.
+ */
+static void
+makeSignal(void)
+{
+	uint32_t noise = 1;
+
+	for (uint32_t n = 0; n < kTestSamples; n++)
+	{
+		uint32_t phase = n % 86;
+		uint32_t pulse = (phase < 12) ? phase * 250 : 3000 - (phase - 12) * 40;
+		uint32_t drift = (n / 8) % 400;
+
+		noise ^= noise << 13;
+		noise ^= noise >> 17;
+		noise ^= noise << 5;
+		signal[n] = 30000 + pulse + ((drift < 200) ? drift : 400 - drift) + (noise & 0x7F);
+	}
+}
+
+/*
+ *	The filter, normaliser and detector one sample at a time, without any of
+ *	the block structure. Returns whether the filter produced an output.
+ */
+static bool
+referenceProcess(uint16_t sample, int32_t *normalised, uint16_t *beatInterval)
+{
+	static const uint32_t coefficients[13] = {17, 67, 174, 383, 731, 1232, 1874, 2615, 3391, 4119, 4715, 5107, 20861};
+	static uint16_t window[32];
+	static uint8_t windowNext;
+	static uint8_t windowCount;
+	static int16_t history[256];
+	static uint8_t historyNext;
+	static uint16_t historyCount;
+	static int32_t previous[2];
+	static int32_t derivative;
+	static uint16_t samplesSinceBeat;
+
+	uint8_t newest = windowNext;
+	uint64_t f = 0;
+	uint32_t sum = 0;
+	int16_t filtered;
+	int16_t minimum;
+	int16_t maximum;
+	int32_t previousDerivative;
+
+	window[newest] = sample;
+	windowNext = (windowNext + 1) % 32;
+	if (windowCount < 32)
+	{
+		windowCount++;
+	}
+	if (windowCount < 32)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < 13; i++)
+	{
+		f += coefficients[i] * (uint32_t)(window[(newest - 25 + i) & 31] + window[(newest - i) & 31]);
+	}
+	for (int i = 0; i < 32; i++)
+	{
+		sum += window[i];
+	}
+	filtered = (int16_t)((uint32_t)(f >> 16) - sum / 32);
+
+	history[historyNext++] = filtered;
+	if (historyCount < 256)
+	{
+		historyCount++;
+	}
+	minimum = history[0];
+	maximum = history[0];
+	for (int i = 1; i < historyCount; i++)
+	{
+		minimum = (history[i] < minimum) ? history[i] : minimum;
+		maximum = (history[i] > maximum) ? history[i] : maximum;
+	}
+	*normalised = (maximum == minimum) ? 0 : (filtered - minimum) * 50 / (maximum - minimum);
+
+	previousDerivative = derivative;
+	derivative = *normalised - previous[1];
+	*beatInterval = 0;
+	if (previousDerivative < 0 && derivative >= 0 && previous[0] < 15)
+	{
+		*beatInterval = samplesSinceBeat;
+		samplesSinceBeat = 0;
+	}
+	samplesSinceBeat++;
+	previous[1] = previous[0];
+	previous[0] = *normalised;
+	return true;
+}
+
+static int
+testAgainstReference(void)
+{
+	static int32_t expectedNormalised[kTestSamples];
+	static uint16_t expectedBeats[kTestSamples];
+	uint32_t expectedCount = 0;
+	uint32_t beats = 0;
+	WarpPipeline pipeline;
+	int32_t block[32];
+
+	makeSignal();
+	for (uint32_t n = 0; n < kTestSamples; n++)
+	{
+		if (referenceProcess(signal[n], &expectedNormalised[expectedCount], &expectedBeats[expectedCount]))
+		{
+			beats += expectedBeats[expectedCount] != 0;
+			expectedCount++;
+		}
+	}
+	if (beats < kTestSamples / 100)
+	{
+		printf("The reference found only %u beats in the test signal\n", beats);
+		return 1;
+	}
+
+	for (unsigned size = 0; size < sizeof(blockSizes); size++)
+	{
+		uint32_t outputs = 0;
+
+		pipelineReset(&pipeline);
+		for (uint32_t n = 0; n < kTestSamples; n += blockSizes[size])
+		{
+			uint8_t count = (kTestSamples - n < blockSizes[size]) ? kTestSamples - n : blockSizes[size];
+
+			for (uint8_t i = 0; i < count; i++)
+			{
+				block[i] = signal[n + i];
+			}
+			count = pipelineProcess(&pipeline, block, count);
+			for (uint8_t i = 0; i < count; i++, outputs++)
+			{
+				if (WARP_PIPELINE_NORMALISED(block[i]) != (uint32_t)expectedNormalised[outputs] || WARP_PIPELINE_BEAT_INTERVAL(block[i]) != expectedBeats[outputs])
+				{
+					printf("Block size %u, output %u: normalised %u, beat interval %u, expected %d and %u\n",
+						blockSizes[size], outputs, WARP_PIPELINE_NORMALISED(block[i]), WARP_PIPELINE_BEAT_INTERVAL(block[i]), expectedNormalised[outputs], expectedBeats[outputs]);
+					return 1;
+				}
+			}
+		}
+		if (outputs != expectedCount)
+		{
+			printf("Block size %u: %u outputs, expected %u\n", blockSizes[size], outputs, expectedCount);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+testIirBlocks(void)
+{
+	static int32_t expected[kTestSamples];
+	WarpStageIirState state;
+	int32_t block[32];
+
+	stageIirReset(&state);
+	for (uint32_t n = 0; n < kTestSamples; n++)
+	{
+		block[0] = signal[n];
+		stageIirProcess(&state, block, &expected[n], 1);
+	}
+
+	for (unsigned size = 1; size < sizeof(blockSizes); size++)
+	{
+		stageIirReset(&state);
+		for (uint32_t n = 0; n < kTestSamples; n += blockSizes[size])
+		{
+			uint8_t count = (kTestSamples - n < blockSizes[size]) ? kTestSamples - n : blockSizes[size];
+
+			for (uint8_t i = 0; i < count; i++)
+			{
+				block[i] = signal[n + i];
+			}
+			stageIirProcess(&state, block, block, count);
+			for (uint8_t i = 0; i < count; i++)
+			{
+				if (block[i] != expected[n + i])
+				{
+					printf("IIR block size %u, sample %u: %d, expected %d\n", blockSizes[size], n + i, block[i], expected[n + i]);
+					return 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static void
+benchmark(void)
+{
+	WarpPipeline pipeline;
+	int32_t block[32];
+	struct timespec start;
+	struct timespec end;
+
+	for (unsigned size = 0; size < sizeof(blockSizes); size++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (uint32_t pass = 0; pass < kTestBenchmarkPasses; pass++)
+		{
+			pipelineReset(&pipeline);
+			for (uint32_t n = 0; n + blockSizes[size] <= kTestSamples; n += blockSizes[size])
+			{
+				for (uint8_t i = 0; i < blockSizes[size]; i++)
+				{
+					block[i] = signal[n + i];
+				}
+				pipelineProcess(&pipeline, block, blockSizes[size]);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double nanoseconds = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+		printf("Block size %2u: %6.1f ns per sample\n", blockSizes[size], nanoseconds / ((double)kTestBenchmarkPasses * (kTestSamples / blockSizes[size] * blockSizes[size])));
+	}
+}
+
+int
+main(void)
+{
+	int failures = testAgainstReference() + testIirBlocks();
+
+	if (!failures)
+	{
+		benchmark();
+	}
+	printf("%s\n", failures ? "FAILED" : "OK");
+	return failures;
+}
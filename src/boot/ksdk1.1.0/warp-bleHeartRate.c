@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "btstack_config.h"
+#include "btstack_memory.h"
+#include "btstack_uart_block.h"
+#include "bluetooth_data_types.h"
+#include "bluetooth_gatt.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+#include "ble/att_server.h"
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+#include "ble/gatt-service/heart_rate_service_server.h"
+
+#include "warp-bleHeartRate.h"
+#include "warp-bleProfile.h"
+
+/*
+ *	The controller starts at its default rate and is not switched to a faster
+ *	one, since the measurement notifications need only a few bytes per beat.
+ */
+static const hci_transport_config_uart_t hciTransportConfig = {
+	HCI_TRANSPORT_CONFIG_UART,
+	kWarpBleHciBaudRate,
+	0, // Keep the initial baud rate
+	1, // RTS flow control, see hal_uart_dma.c
+	NULL,
+};
+
+static const uint8_t advertisingData[] = {
+	// Flags: general discoverable, BR/EDR not supported
+	0x02, BLUETOOTH_DATA_TYPE_FLAGS, 0x06,
+	// Name
+	0x09, BLUETOOTH_DATA_TYPE_COMPLETE_LOCAL_NAME, 'W', 'a', 'r', 'p', ' ', 'H', 'R', 'M',
+	// Heart Rate Service
+	0x03, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS,
+	ORG_BLUETOOTH_SERVICE_HEART_RATE & 0xff, ORG_BLUETOOTH_SERVICE_HEART_RATE >> 8,
+};
+
+void
+bleHeartRateInit(void)
+{
+	bd_addr_t nullAddress;
+
+	btstack_memory_init();
+	hci_init(hci_transport_h4_instance(btstack_uart_block_embedded_instance()), &hciTransportConfig);
+
+	l2cap_init();
+	le_device_db_init();
+	sm_init();
+	att_server_init(profile_data, NULL, NULL);
+	heart_rate_service_server_init(HEART_RATE_SERVICE_BODY_SENSOR_LOCATION_FINGER, 0 /* energy expended not supported */);
+
+	memset(nullAddress, 0, sizeof(nullAddress));
+	gap_advertisements_set_params(kWarpBleAdvertisingIntervalUnits, kWarpBleAdvertisingIntervalUnits, 0 /* ADV_IND */, 0, nullAddress, 0x07 /* all channels */, 0x00);
+	gap_advertisements_set_data(sizeof(advertisingData), (uint8_t *)advertisingData);
+	gap_advertisements_enable(1);
+
+	// Keep advertising after the first connection, so a second central can subscribe
+	gap_set_max_number_peripheral_connections(MAX_NR_HCI_CONNECTIONS);
+
+	hci_power_control(HCI_POWER_ON);
+	return;
+}
+
+/*
+ *	Called on each detected beat. The BPM is rounded to whole beats, and the beat
+ *	interval is converted from samples to 1/1024 s.
+ */
+void
+bleHeartRateBeat(uint16_t bpmTenths, uint16_t beatIntervalSamples)
+{
+	uint16_t rrInterval;
+
+	rrInterval = ((uint32_t)beatIntervalSamples * kWarpBleRrIntervalUnitsPerSecond) / kWarpBleSamplesPerSecond;
+	heart_rate_service_server_update_heart_rate_values((bpmTenths + 5) / 10, HEART_RATE_SERVICE_SENSOR_CONTACT_HAVE_CONTACT, 1, &rrInterval);
+	return;
+}
+
+/*
+ *	Called when the finger is removed, so a connected collector stops showing the
+ *	last reading.
+ */
+void
+bleHeartRateContactLost(void)
+{
+	heart_rate_service_server_update_heart_rate_values(0, HEART_RATE_SERVICE_SENSOR_CONTACT_NO_CONTACT, 0, NULL);
+	return;
+}
@@ -0,0 +1,20 @@
+/*
+ *	Publishes the measured heart rate through the btstack BLE Heart Rate Service.
+ *	Each detected beat sends one Heart Rate Measurement notification carrying
+ *	the BPM, sensor contact and the RR interval of that beat, so the notification
+ *	rate follows the heart rate. Built only with WARP_BUILD_ENABLE_BLE.
+ */
+
+typedef enum
+{
+	kWarpBleSamplesPerSecond = 100, // 400 Hz sample rate with 4x sample averaging
+	kWarpBleRrIntervalUnitsPerSecond = 1024, // Heart Rate Measurement RR intervals are in 1/1024 s
+	kWarpBleAdvertisingIntervalUnits = 0x0640, // 1 s, in units of 0.625 ms
+	kWarpBleHciBaudRate = 115200,
+} WarpBleConstants;
+
+void bleHeartRateInit(void);
+
+void bleHeartRateBeat(uint16_t bpmTenths, uint16_t beatIntervalSamples);
+
+void bleHeartRateContactLost(void);
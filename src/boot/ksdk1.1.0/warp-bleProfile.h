@@ -0,0 +1,82 @@
+
+// src/boot/ksdk1.1.0/warp-bleProfile.h generated from src/boot/ksdk1.1.0/warp-bleProfile.gatt for BTstack
+// att db format version 1
+
+// binary attribute representation:
+// - size in bytes (16), flags(16), handle (16), uuid (16/128), value(...)
+
+#include <stdint.h>
+
+const uint8_t profile_data[] =
+{
+    // ATT DB Version
+    1,
+
+    // GATT database for the BLE heart rate monitor. Regenerate warp-bleProfile.h after editing:
+    //	python src/btstack/tool/compile_gatt.py src/boot/ksdk1.1.0/warp-bleProfile.gatt src/boot/ksdk1.1.0/warp-bleProfile.h
+    // 0x0001 PRIMARY_SERVICE-GAP_SERVICE
+    0x0a, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x28, 0x00, 0x18, 
+    // 0x0002 CHARACTERISTIC-GAP_DEVICE_NAME-READ
+    0x0d, 0x00, 0x02, 0x00, 0x02, 0x00, 0x03, 0x28, 0x02, 0x03, 0x00, 0x00, 0x2a, 
+    // 0x0003 VALUE-GAP_DEVICE_NAME-READ-'Warp HRM'
+    // READ_ANYBODY
+    0x10, 0x00, 0x02, 0x00, 0x03, 0x00, 0x00, 0x2a, 0x57, 0x61, 0x72, 0x70, 0x20, 0x48, 0x52, 0x4d, 
+
+    // 0x0004 PRIMARY_SERVICE-GATT_SERVICE
+    0x0a, 0x00, 0x02, 0x00, 0x04, 0x00, 0x00, 0x28, 0x01, 0x18, 
+    // 0x0005 CHARACTERISTIC-GATT_SERVICE_CHANGED-READ
+    0x0d, 0x00, 0x02, 0x00, 0x05, 0x00, 0x03, 0x28, 0x02, 0x06, 0x00, 0x05, 0x2a, 
+    // 0x0006 VALUE-GATT_SERVICE_CHANGED-READ-''
+    // READ_ANYBODY
+    0x08, 0x00, 0x02, 0x00, 0x06, 0x00, 0x05, 0x2a, 
+    // #import <heart_rate_service.gatt> -- BEGIN
+    // Specification Type org.bluetooth.service.heart_rate
+    // https://www.bluetooth.com/api/gatt/xmlfile?xmlFileName=org.bluetooth.service.heart_rate.xml
+    // Heart Rate 180D
+
+    // 0x0007 PRIMARY_SERVICE-ORG_BLUETOOTH_SERVICE_HEART_RATE
+    0x0a, 0x00, 0x02, 0x00, 0x07, 0x00, 0x00, 0x28, 0x0d, 0x18, 
+    // 0x0008 CHARACTERISTIC-ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT-DYNAMIC | NOTIFY
+    0x0d, 0x00, 0x02, 0x00, 0x08, 0x00, 0x03, 0x28, 0x10, 0x09, 0x00, 0x37, 0x2a, 
+    // 0x0009 VALUE-ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT-DYNAMIC | NOTIFY-''
+    // 
+    0x08, 0x00, 0x00, 0x01, 0x09, 0x00, 0x37, 0x2a, 
+    // 0x000a CLIENT_CHARACTERISTIC_CONFIGURATION
+    // READ_ANYBODY, WRITE_ANYBODY
+    0x0a, 0x00, 0x0e, 0x01, 0x0a, 0x00, 0x02, 0x29, 0x00, 0x00, 
+    // 0x000b CHARACTERISTIC-ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION-DYNAMIC | READ
+    0x0d, 0x00, 0x02, 0x00, 0x0b, 0x00, 0x03, 0x28, 0x02, 0x0c, 0x00, 0x38, 0x2a, 
+    // 0x000c VALUE-ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION-DYNAMIC | READ-''
+    // READ_ANYBODY
+    0x08, 0x00, 0x02, 0x01, 0x0c, 0x00, 0x38, 0x2a, 
+    // 0x000d CHARACTERISTIC-ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_CONTROL_POINT-DYNAMIC | WRITE
+    0x0d, 0x00, 0x02, 0x00, 0x0d, 0x00, 0x03, 0x28, 0x08, 0x0e, 0x00, 0x39, 0x2a, 
+    // 0x000e VALUE-ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_CONTROL_POINT-DYNAMIC | WRITE-''
+    // WRITE_ANYBODY
+    0x08, 0x00, 0x08, 0x01, 0x0e, 0x00, 0x39, 0x2a, 
+    // #import <heart_rate_service.gatt> -- END
+
+    // END
+    0x00, 0x00, 
+}; // total size 97 bytes 
+
+
+//
+// list service handle ranges
+//
+#define ATT_SERVICE_GAP_SERVICE_START_HANDLE 0x0001
+#define ATT_SERVICE_GAP_SERVICE_END_HANDLE 0x0003
+#define ATT_SERVICE_GATT_SERVICE_START_HANDLE 0x0004
+#define ATT_SERVICE_GATT_SERVICE_END_HANDLE 0x0006
+#define ATT_SERVICE_ORG_BLUETOOTH_SERVICE_HEART_RATE_START_HANDLE 0x0007
+#define ATT_SERVICE_ORG_BLUETOOTH_SERVICE_HEART_RATE_END_HANDLE 0x000e
+
+//
+// list mapping between characteristics and handles
+//
+#define ATT_CHARACTERISTIC_GAP_DEVICE_NAME_01_VALUE_HANDLE 0x0003
+#define ATT_CHARACTERISTIC_GATT_SERVICE_CHANGED_01_VALUE_HANDLE 0x0006
+#define ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT_01_VALUE_HANDLE 0x0009
+#define ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT_01_CLIENT_CONFIGURATION_HANDLE 0x000a
+#define ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION_01_VALUE_HANDLE 0x000c
+#define ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_CONTROL_POINT_01_VALUE_HANDLE 0x000e
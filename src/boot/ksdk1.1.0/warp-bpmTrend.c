@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "warp-bpmTrend.h"
+
+/*
+ *	Number of finer-level units that make up one bucket at each level:
+ *	one tick per second, 60 seconds per minute, 10 minutes per 10 minutes.
+ */
+static const uint8_t levelSpans[kWarpBpmTrendLevelCount] = {
+	1,
+	60,
+	10,
+};
+
+static WarpBpmTrendLevelState trendLevels[kWarpBpmTrendLevelCount];
+
+static void
+accumulate(WarpBpmTrendLevelState *state, uint8_t min, uint8_t max, uint8_t mean)
+{
+	if ((state->accumulatorCount == 0) | (min < state->accumulatorMin))
+	{
+		state->accumulatorMin = min;
+	}
+	if ((state->accumulatorCount == 0) | (max > state->accumulatorMax))
+	{
+		state->accumulatorMax = max;
+	}
+	state->accumulatorSum += mean;
+	state->accumulatorCount++;
+	return;
+}
+
+/*
+ *	Closes the accumulating bucket of a level, pushes it into the ring, and folds
+ *	it into the next level up. The cascade is at most kWarpBpmTrendLevelCount deep.
+ */
+static void
+closeBucket(uint8_t level)
+{
+	WarpBpmTrendLevelState *state = &trendLevels[level];
+	WarpBpmTrendBucket *bucket = &state->buckets[state->head];
+
+	if (state->accumulatorCount == 0)
+	{
+		bucket->min = 0;
+		bucket->max = 0;
+		bucket->mean = 0;
+	}
+	else
+	{
+		bucket->min = state->accumulatorMin;
+		bucket->max = state->accumulatorMax;
+		bucket->mean = state->accumulatorSum / state->accumulatorCount;
+	}
+
+	state->head++;
+	if (state->head == kWarpBpmTrendBucketsPerLevel)
+	{
+		state->head = 0;
+	}
+	if (state->filled < kWarpBpmTrendBucketsPerLevel)
+	{
+		state->filled++;
+	}
+	state->accumulatorCount = 0;
+	state->accumulatorSum = 0;
+	state->children = 0;
+
+	if (level + 1 < kWarpBpmTrendLevelCount)
+	{
+		WarpBpmTrendLevelState *parent = &trendLevels[level + 1];
+
+		if (bucket->mean != 0)
+		{
+			accumulate(parent, bucket->min, bucket->max, bucket->mean);
+		}
+		parent->children++;
+		if (parent->children == levelSpans[level + 1])
+		{
+			closeBucket(level + 1);
+		}
+	}
+	return;
+}
+
+void bpmTrendInit(void)
+{
+	memset(trendLevels, 0, sizeof(trendLevels));
+	return;
+}
+
+/*
+ *	Records one detected beat. bpm is in tenths of a beat per minute, as computed
+ *	in the main loop; values outside the plausible range are ignored.
+ */
+void bpmTrendAddBeat(uint16_t bpm)
+{
+	uint16_t wholeBpm = bpm / 10;
+
+	if ((wholeBpm < kWarpBpmTrendMinimumBpm) | (wholeBpm > kWarpBpmTrendMaximumBpm))
+	{
+		return;
+	}
+	accumulate(&trendLevels[kWarpBpmTrendLevelSecond], wholeBpm, wholeBpm, wholeBpm);
+	return;
+}
+
+/*
+ *	Advances the trend clock by kWarpBpmTrendTickMilliseconds of wall-clock time,
+ *	whether or not samples were taken, so the buckets cover fixed spans of time.
+ */
+void bpmTrendTick(void)
+{
+	WarpBpmTrendLevelState *state = &trendLevels[kWarpBpmTrendLevelSecond];
+
+	state->children++;
+	if (state->children == levelSpans[kWarpBpmTrendLevelSecond])
+	{
+		closeBucket(kWarpBpmTrendLevelSecond);
+	}
+	return;
+}
+
+uint8_t bpmTrendGetBucketCount(uint8_t level)
+{
+	return trendLevels[level].filled;
+}
+
+/*
+ *	Returns a completed bucket, age 0 being the most recent. The caller must keep
+ *	age below bpmTrendGetBucketCount(level).
+ */
+const WarpBpmTrendBucket *bpmTrendGetBucket(uint8_t level, uint8_t age)
+{
+	WarpBpmTrendLevelState *state = &trendLevels[level];
+	int8_t index = state->head - 1 - age;
+
+	if (index < 0)
+	{
+		index += kWarpBpmTrendBucketsPerLevel;
+	}
+	return &state->buckets[index];
+}
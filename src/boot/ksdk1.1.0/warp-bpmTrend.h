@@ -0,0 +1,50 @@
+/*
+ *	Multi-resolution BPM trend store. Each level holds a ring of completed
+ *	buckets plus one bucket that is still accumulating; closing a bucket folds
+ *	it into the accumulator of the next coarser level, so every update is O(1).
+ */
+
+typedef enum
+{
+	kWarpBpmTrendLevelSecond = 0,
+	kWarpBpmTrendLevelMinute,
+	kWarpBpmTrendLevelTenMinutes,
+	kWarpBpmTrendLevelCount,
+} WarpBpmTrendLevel;
+
+typedef enum
+{
+	kWarpBpmTrendBucketsPerLevel = 24, // 24 buckets x 4 columns fills the 96 column display
+	kWarpBpmTrendTickMilliseconds = 1000, // Wall-clock period of bpmTrendTick(), one per-second bucket
+	kWarpBpmTrendMinimumBpm = 20, // Whole beats per minute
+	kWarpBpmTrendMaximumBpm = 250,
+} WarpBpmTrendConstants;
+
+typedef struct
+{
+	uint8_t min; // Whole beats per minute, 0 if the bucket saw no beats
+	uint8_t max;
+	uint8_t mean;
+} WarpBpmTrendBucket;
+
+typedef struct
+{
+	WarpBpmTrendBucket buckets[kWarpBpmTrendBucketsPerLevel];
+	uint8_t head; // Index of the next bucket to be written
+	uint8_t filled; // Number of valid buckets in the ring
+	uint8_t children; // Number of finer buckets (or samples) folded into the accumulator
+	uint8_t accumulatorCount;
+	uint8_t accumulatorMin;
+	uint8_t accumulatorMax;
+	uint16_t accumulatorSum;
+} WarpBpmTrendLevelState;
+
+void bpmTrendInit(void);
+
+void bpmTrendAddBeat(uint16_t bpm);
+
+void bpmTrendTick(void);
+
+uint8_t bpmTrendGetBucketCount(uint8_t level);
+
+const WarpBpmTrendBucket *bpmTrendGetBucket(uint8_t level, uint8_t age);
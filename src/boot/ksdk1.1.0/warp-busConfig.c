@@ -0,0 +1,182 @@
+#include <stdint.h>
+
+#include "fsl_i2c_master_driver.h"
+#include "fsl_spi_master_driver.h"
+
+#include "SEGGER_RTT.h"
+#include "warp.h"
+#include "warp-busConfig.h"
+#include "warp-log.h"
+#include "devMAX30105.h"
+
+extern volatile WarpI2CDeviceState deviceMAX30105State;
+extern volatile spi_master_user_config_t spiUserConfig;
+extern volatile uint32_t gWarpI2cBaudRateKbps;
+extern volatile uint32_t gWarpSpiBaudRateKbps;
+
+/*
+ *	Candidate rates, fastest first. The MAX30105 supports 400 kHz fast-mode I2C and
+ *	the SSD1331 a minimum SPI clock period of 150 ns, so 6 MHz is within its rating.
+ */
+static const uint16_t i2cRatesKbps[kWarpBusI2cRateCount] = {400, 200, 100};
+static const uint16_t spiRatesKbps[kWarpBusSpiRateCount] = {6000, 4000, 2000, 1000, 200};
+
+volatile WarpBusState busState;
+
+static void
+applyI2cRate(uint8_t rateIndex)
+{
+	busState.i2cRateIndex = rateIndex;
+	gWarpI2cBaudRateKbps = i2cRatesKbps[rateIndex];
+}
+
+static void
+applySpiRate(uint8_t rateIndex)
+{
+	uint32_t calculatedBaudRate;
+
+	busState.spiRateIndex = rateIndex;
+	spiUserConfig.bitsPerSec = spiRatesKbps[rateIndex] * 1000;
+	SPI_DRV_MasterConfigureBus(0 /* SPI master instance */, (spi_master_user_config_t *)&spiUserConfig, &calculatedBaudRate);
+
+	// The prescalers only reach some rates; report the one they give, at most the one requested
+	gWarpSpiBaudRateKbps = calculatedBaudRate / 1000;
+}
+
+static bool
+selfTestI2c(void)
+{
+	for (int i = 0; i < kWarpBusSelfTestRepeats; i++)
+	{
+		if ((readSensorRegisterMAX30105(PART_ID, 1 /* numberOfBytes */) != CommStatusOK) ||
+		    (deviceMAX30105State.i2cBuffer[0] != kWarpBusMAX30105PartId))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ *	Finds the fastest I2C rate at which repeated reads of the MAX30105 PART_ID
+ *	register succeed, or leaves it at the slowest. SPI is set to its fastest rate
+ *	directly: the SSD1331 has no read-back, and a write that completes on the
+ *	master side says nothing about what the display received.
+ */
+void busConfigCalibrate(void)
+{
+	uint8_t rateIndex;
+
+	for (rateIndex = 0; rateIndex < kWarpBusI2cRateCount - 1; rateIndex++)
+	{
+		applyI2cRate(rateIndex);
+		if (selfTestI2c())
+		{
+			break;
+		}
+	}
+	applyI2cRate(rateIndex);
+
+	applySpiRate(0);
+	busState.spiStepDownPending = false;
+
+	/*
+	 *	The self-test transfers are not counted.
+	 */
+	busState.i2cTransfers = 0;
+	busState.i2cErrors = 0;
+	busState.spiTransfers = 0;
+	busState.spiErrors = 0;
+	busState.i2cConsecutiveErrors = 0;
+	busState.spiConsecutiveErrors = 0;
+}
+
+/*
+ *	Called by the drivers after every transfer. A run of failures steps the bus down
+ *	to the next slower rate: I2C at once, SPI once the display transaction in
+ *	progress has ended, see busConfigApplySpiStepDown().
+ */
+void busConfigRecordI2cResult(bool ok)
+{
+	busState.i2cTransfers++;
+	if (ok)
+	{
+		busState.i2cConsecutiveErrors = 0;
+		return;
+	}
+
+	busState.i2cErrors++;
+	busState.i2cConsecutiveErrors++;
+	if ((busState.i2cConsecutiveErrors >= kWarpBusConsecutiveErrorLimit) && (busState.i2cRateIndex < kWarpBusI2cRateCount - 1))
+	{
+		applyI2cRate(busState.i2cRateIndex + 1);
+		busState.i2cConsecutiveErrors = 0;
+	}
+}
+
+void busConfigRecordSpiResult(bool ok)
+{
+	busState.spiTransfers++;
+	if (ok)
+	{
+		busState.spiConsecutiveErrors = 0;
+		return;
+	}
+
+	busState.spiErrors++;
+	busState.spiConsecutiveErrors++;
+	if ((busState.spiConsecutiveErrors >= kWarpBusConsecutiveErrorLimit) && (busState.spiRateIndex < kWarpBusSpiRateCount - 1))
+	{
+		busState.spiStepDownPending = true;
+	}
+}
+
+/*
+ *	Called by the display driver at the end of a pixel window, with /CS deasserted,
+ *	so the SPI clock never changes part way through a pixel stream.
+ */
+void busConfigApplySpiStepDown(void)
+{
+	if (!busState.spiStepDownPending)
+	{
+		return;
+	}
+
+	busState.spiStepDownPending = false;
+	applySpiRate(busState.spiRateIndex + 1);
+	busState.spiConsecutiveErrors = 0;
+}
+
+/*
+ *	Forces a bus to one of its candidate rates, 0 being the fastest. Runtime error
+ *	accounting may still step it down afterwards.
+ */
+bool busConfigSetI2cRate(uint8_t rateIndex)
+{
+	if (rateIndex >= kWarpBusI2cRateCount)
+	{
+		return false;
+	}
+	applyI2cRate(rateIndex);
+	busState.i2cConsecutiveErrors = 0;
+	return true;
+}
+
+bool busConfigSetSpiRate(uint8_t rateIndex)
+{
+	if (rateIndex >= kWarpBusSpiRateCount)
+	{
+		return false;
+	}
+	applySpiRate(rateIndex);
+	busState.spiConsecutiveErrors = 0;
+	busState.spiStepDownPending = false;
+	return true;
+}
+
+void busConfigPrintStatistics(void)
+{
+	WARP_LOG("I2C %u kbps: %u/%u failed, SPI %u kbps: %u/%u failed\n\r",
+		 gWarpI2cBaudRateKbps, busState.i2cErrors, busState.i2cTransfers,
+		 gWarpSpiBaudRateKbps, busState.spiErrors, busState.spiTransfers);
+}
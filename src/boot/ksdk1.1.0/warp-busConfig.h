@@ -0,0 +1,43 @@
+/*
+ *	Bus rate calibration and error accounting for the I2C (MAX30105) and SPI
+ *	(SSD1331) buses. I2C starts at its fastest candidate rate and steps down until
+ *	a self-test passes; SPI starts at its fastest, as the write-only SSD1331 gives
+ *	nothing to test against. Either steps down again at runtime if transfers keep
+ *	failing.
+ */
+
+typedef enum
+{
+	kWarpBusI2cRateCount = 3,
+	kWarpBusSpiRateCount = 5,
+	kWarpBusSelfTestRepeats = 4,
+	kWarpBusConsecutiveErrorLimit = 3,
+	kWarpBusMAX30105PartId = 0x15,
+} WarpBusConstants;
+
+typedef struct
+{
+	uint32_t i2cTransfers;
+	uint32_t i2cErrors;
+	uint32_t spiTransfers;
+	uint32_t spiErrors;
+	uint8_t i2cConsecutiveErrors;
+	uint8_t spiConsecutiveErrors;
+	uint8_t i2cRateIndex; // Index into the candidate rate tables, 0 being the fastest
+	uint8_t spiRateIndex;
+	bool spiStepDownPending; // Applied by busConfigApplySpiStepDown() between display transactions
+} WarpBusState;
+
+void busConfigCalibrate(void);
+
+void busConfigRecordI2cResult(bool ok);
+
+void busConfigRecordSpiResult(bool ok);
+
+void busConfigApplySpiStepDown(void);
+
+bool busConfigSetI2cRate(uint8_t rateIndex);
+
+bool busConfigSetSpiRate(uint8_t rateIndex);
+
+void busConfigPrintStatistics(void);
@@ -0,0 +1,225 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "SEGGER_RTT.h"
+#include "warp.h"
+#include "warp-busConfig.h"
+#include "warp-command.h"
+#include "warp-profile.h"
+#include "warp-rawStream.h"
+#include "warp-sessionLog.h"
+#include "warp-stack.h"
+#include "devMAX30105.h"
+
+#ifdef WARP_BUILD_ENABLE_COMMANDS
+
+extern volatile uint32_t gWarpI2cBaudRateKbps;
+extern volatile uint32_t gWarpSpiBaudRateKbps;
+extern volatile uint32_t gWarpMAX30105LostSamples;
+
+static char commandRttDownBuffer[kWarpCommandRttDownBufferSize];
+static char commandRttUpBuffer[kWarpCommandRttUpBufferSize];
+
+// A command can arrive split across two polls
+static uint8_t commandBuffer[kWarpCommandBytes];
+static uint8_t commandBufferCount;
+
+WARP_STATIC_ASSERT(sizeof(WarpCommandResponse) == 8, "tools/scripts/warp-command.py parses responses as <2sBBI");
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+WARP_STATIC_ASSERT(sizeof(WarpSessionLogRecord) == 2 * sizeof(uint32_t), "kWarpCommandGetSessionLogRecord returns a record as two longwords");
+#endif
+
+void
+commandInit(void)
+{
+	commandBufferCount = 0;
+	SEGGER_RTT_ConfigDownBuffer(kWarpCommandRttDownChannel, "Commands", commandRttDownBuffer, sizeof(commandRttDownBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	SEGGER_RTT_ConfigUpBuffer(kWarpCommandRttUpChannel, "Responses", commandRttUpBuffer, sizeof(commandRttUpBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	return;
+}
+
+static WarpCommandStatus
+executeCommand(const uint8_t *command, uint32_t *value)
+{
+	uint8_t payload;
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	WarpSessionLogRecord record;
+#endif
+
+	*value = 0;
+	switch (command[0])
+	{
+	case kWarpCommandPing:
+	{
+		*value = kWarpCommandProtocolVersion;
+		return kWarpCommandStatusOK;
+	}
+
+	case kWarpCommandGetRegister:
+	{
+		if (getShadowRegisterMAX30105(command[1], &payload) != CommStatusOK)
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+		*value = payload;
+		return kWarpCommandStatusOK;
+	}
+
+	case kWarpCommandSetRegister:
+	{
+		// Only shadowed registers: writing the FIFO pointers would corrupt the drain
+		if (getShadowRegisterMAX30105(command[1], &payload) != CommStatusOK)
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+
+		/*
+		 *	Nor the registers that set the sample rate: the pipeline and the beat
+		 *	interval conversion assume 100 samples a second, which every profile
+		 *	keeps. Use kWarpCommandSetProfile for those.
+		 */
+		if ((command[1] == MODE_CONFIG) | (command[1] == FIFO_CONFIG) | (command[1] == SPO2_CONFIG))
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+		return (writeSensorRegisterMAX30105(command[1], command[2]) == CommStatusOK) ? kWarpCommandStatusOK : kWarpCommandStatusBusError;
+	}
+
+	case kWarpCommandSetProfile:
+	{
+		if (command[1] >= kWarpMAX30105ProfileCount)
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+		return (configureProfileMAX30105(command[1]) == CommStatusOK) ? kWarpCommandStatusOK : kWarpCommandStatusBusError;
+	}
+
+	case kWarpCommandDumpProfiling:
+	{
+#ifdef WARP_BUILD_ENABLE_PROFILING
+		profileDump();
+		return kWarpCommandStatusOK;
+#else
+		return kWarpCommandStatusNotBuilt;
+#endif
+	}
+
+	case kWarpCommandRawStream:
+	{
+#ifdef WARP_BUILD_ENABLE_RAW_STREAM
+		if (command[1] > 1)
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+		rawStreamEnable(command[1]);
+		return kWarpCommandStatusOK;
+#else
+		return kWarpCommandStatusNotBuilt;
+#endif
+	}
+
+	case kWarpCommandSetBusRate:
+	{
+		if (command[1] == 0)
+		{
+			if (!busConfigSetI2cRate(command[2]))
+			{
+				return kWarpCommandStatusBadArgument;
+			}
+			*value = gWarpI2cBaudRateKbps;
+			return kWarpCommandStatusOK;
+		}
+		if (command[1] == 1)
+		{
+			if (!busConfigSetSpiRate(command[2]))
+			{
+				return kWarpCommandStatusBadArgument;
+			}
+			*value = gWarpSpiBaudRateKbps;
+			return kWarpCommandStatusOK;
+		}
+		return kWarpCommandStatusBadArgument;
+	}
+
+	case kWarpCommandGetLostSamples:
+	{
+		*value = gWarpMAX30105LostSamples;
+		return kWarpCommandStatusOK;
+	}
+
+	case kWarpCommandGetSessionLogCount:
+	{
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+		*value = sessionLogGetRecordCount();
+		return kWarpCommandStatusOK;
+#else
+		return kWarpCommandStatusNotBuilt;
+#endif
+	}
+
+	case kWarpCommandGetSessionLogRecord:
+	{
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+		if ((command[3] > 1) || !sessionLogReadRecord(command[1] | (command[2] << 8), &record))
+		{
+			return kWarpCommandStatusBadArgument;
+		}
+		memcpy(value, (uint8_t *)&record + command[3] * sizeof(*value), sizeof(*value));
+		return kWarpCommandStatusOK;
+#else
+		return kWarpCommandStatusNotBuilt;
+#endif
+	}
+
+	case kWarpCommandGetSessionLogDropped:
+	{
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+		*value = sessionLogGetDropped();
+		return kWarpCommandStatusOK;
+#else
+		return kWarpCommandStatusNotBuilt;
+#endif
+	}
+
+	case kWarpCommandGetStackHighWater:
+	{
+		*value = stackGetHighWater() | ((uint32_t)stackGetReserve() << 16);
+		return kWarpCommandStatusOK;
+	}
+
+	default:
+	{
+		return kWarpCommandStatusUnknownOpcode;
+	}
+	}
+}
+
+/*
+ *	Called on every run loop pass. Costs one check of the down-buffer offsets
+ *	when there is no command waiting.
+ */
+void
+commandPoll(void)
+{
+	WarpCommandResponse response;
+
+	while (SEGGER_RTT_HasData(kWarpCommandRttDownChannel))
+	{
+		commandBufferCount += SEGGER_RTT_Read(kWarpCommandRttDownChannel, &commandBuffer[commandBufferCount], kWarpCommandBytes - commandBufferCount);
+		if (commandBufferCount < kWarpCommandBytes)
+		{
+			continue;
+		}
+		commandBufferCount = 0;
+
+		response.sync[0] = kWarpCommandResponseSync0;
+		response.sync[1] = kWarpCommandResponseSync1;
+		response.opcode = commandBuffer[0];
+		response.status = executeCommand(commandBuffer, &response.value);
+		SEGGER_RTT_Write(kWarpCommandRttUpChannel, &response, sizeof(response));
+	}
+	return;
+}
+
+#endif
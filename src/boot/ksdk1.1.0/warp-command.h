@@ -0,0 +1,61 @@
+/*
+ *	Binary command interface for live reconfiguration, built only with
+ *	WARP_BUILD_ENABLE_COMMANDS. The host writes fixed-size commands to RTT
+ *	down-buffer kWarpCommandRttDownChannel:
+ *
+ *		uint8_t opcode, uint8_t arguments[3]
+ *
+ *	and every command is answered with one WarpCommandResponse on RTT up-buffer
+ *	kWarpCommandRttUpChannel. Commands are executed from the run loop between
+ *	pipeline tasks, so sampling carries on and the sensor FIFO absorbs the delay.
+ *	tools/scripts/warp-command.py sends commands and prints the responses.
+ */
+
+typedef enum
+{
+	kWarpCommandRttDownChannel = 1,
+	kWarpCommandRttUpChannel = 4,
+	kWarpCommandRttDownBufferSize = 16, // Four commands
+	kWarpCommandRttUpBufferSize = 33, // Four responses; RTT keeps one byte free
+	kWarpCommandBytes = 4,
+	kWarpCommandResponseSync0 = 0xA5,
+	kWarpCommandResponseSync1 = 0x5C,
+	kWarpCommandProtocolVersion = 3,
+} WarpCommandConstants;
+
+typedef enum
+{
+	kWarpCommandPing = 0x00, // Returns kWarpCommandProtocolVersion
+	kWarpCommandGetRegister = 0x01, // arguments[0]: MAX30105 register. Returns the shadowed value, without bus traffic
+	kWarpCommandSetRegister = 0x02, // arguments[0]: MAX30105 register, arguments[1]: value. Configuration registers only, other than MODE_CONFIG, FIFO_CONFIG and SPO2_CONFIG
+	kWarpCommandSetProfile = 0x03, // arguments[0]: WarpMAX30105ProfileConstants acquisition profile
+	kWarpCommandDumpProfiling = 0x04, // Sends the profiling record now rather than at the next housekeeping pass
+	kWarpCommandRawStream = 0x05, // arguments[0]: 0 stops, 1 starts the raw sample stream
+	kWarpCommandSetBusRate = 0x06, // arguments[0]: 0 for I2C, 1 for SPI, arguments[1]: rate index, 0 being the fastest. Returns the rate in kbps; for SPI, the one the prescalers actually give
+	kWarpCommandGetLostSamples = 0x07, // Returns the number of samples lost to sensor FIFO overflow since boot
+	kWarpCommandGetSessionLogCount = 0x08, // Returns the number of records in the flash session log
+	kWarpCommandGetSessionLogRecord = 0x09, // arguments[0..1]: record index, little endian, 0 being the oldest, arguments[2]: 0 or 1 for the first or second longword. Returns that longword of the WarpSessionLogRecord
+	kWarpCommandGetStackHighWater = 0x0A, // Returns the deepest the stack has reached since reset in the low 16 bits and the stack reserve in the high 16 bits, both in bytes, see warp-stack.h
+	kWarpCommandGetSessionLogDropped = 0x0B, // Returns the number of session log records dropped since reset because the RAM batch was full
+} WarpCommandOpcode;
+
+typedef enum
+{
+	kWarpCommandStatusOK = 0,
+	kWarpCommandStatusUnknownOpcode,
+	kWarpCommandStatusBadArgument,
+	kWarpCommandStatusBusError,
+	kWarpCommandStatusNotBuilt, // The feature behind the command is compiled out
+} WarpCommandStatus;
+
+typedef struct
+{
+	uint8_t sync[2];
+	uint8_t opcode;
+	uint8_t status; // WarpCommandStatus
+	uint32_t value; // Little endian
+} WarpCommandResponse;
+
+void commandInit(void);
+
+void commandPoll(void);
@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsl_spi_master_driver.h"
+
+#include "warp.h"
+#include "warp-eventQueue.h"
+
+/*
+ *	Keeps the compiler from moving memory accesses across it. The M0+ itself
+ *	performs them in program order, and the queue is only shared with
+ *	interrupt handlers on the same core, so no DMB is needed.
+ */
+#define WARP_EVENT_QUEUE_BARRIER()	__asm volatile("" ::: "memory")
+
+/*
+ *	head and tail run freely and wrap at 256; tail - head is the number of
+ *	events queued, which is why the length is at most 128.
+ */
+WARP_STATIC_ASSERT((kWarpEventQueueLength & (kWarpEventQueueLength - 1)) == 0, "kWarpEventQueueLength must be a power of two");
+WARP_STATIC_ASSERT(kWarpEventQueueLength <= 128, "The queue indices are uint8_t");
+
+static WarpEvent events[kWarpEventQueueLength];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+static volatile uint16_t dropped;
+
+/*
+ *	Producer side, from interrupt handlers only. Returns false, and counts the
+ *	event as dropped, if the queue is full.
+ */
+bool
+eventQueuePush(WarpEventTag tag, uint16_t argument)
+{
+	uint8_t position = tail;
+
+	if ((uint8_t)(position - head) == kWarpEventQueueLength)
+	{
+		if (dropped < 0xFFFF)
+		{
+			dropped++;
+		}
+		return false;
+	}
+
+	events[position & (kWarpEventQueueLength - 1)].tag = tag;
+	events[position & (kWarpEventQueueLength - 1)].argument = argument;
+	WARP_EVENT_QUEUE_BARRIER();
+	tail = position + 1;
+	return true;
+}
+
+/*
+ *	Consumer side, from the run loop only. Returns false if the queue is empty.
+ */
+bool
+eventQueuePop(WarpEvent *event)
+{
+	uint8_t position = head;
+
+	if (position == tail)
+	{
+		return false;
+	}
+
+	/*
+	 *	The event must not be read before tail, or it could be the slot's
+	 *	contents from before the producer wrote it.
+	 */
+	WARP_EVENT_QUEUE_BARRIER();
+	*event = events[position & (kWarpEventQueueLength - 1)];
+	WARP_EVENT_QUEUE_BARRIER();
+	head = position + 1;
+	return true;
+}
+
+/*
+ *	Events dropped because the queue was full, since reset, saturating.
+ */
+uint16_t
+eventQueueGetDropped(void)
+{
+	return dropped;
+}
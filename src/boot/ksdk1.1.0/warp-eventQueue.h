@@ -0,0 +1,37 @@
+/*
+ *	Tagged events from interrupt handlers to the run loop: a fixed-length ring
+ *	with one producer and one consumer, and no locks. The producer writes only
+ *	tail and the consumer only head; both are single bytes, which the M0+ loads
+ *	and stores atomically, so neither side needs LDREX/STREX (which ARMv6-M
+ *	does not have) or to mask interrupts. An event is written before tail
+ *	publishes it, and read before head releases its slot.
+ *
+ *	The producer side is every interrupt handler that calls eventQueuePush().
+ *	They must all run at the same NVIC priority, the reset default, so that none
+ *	preempts another mid-push and together they act as a single producer. The
+ *	consumer is the run loop's event task. A push to a full queue is dropped and
+ *	counted; since each handler also triggers the run loop, the core only goes
+ *	back to sleep once the queue has been drained.
+ */
+
+typedef enum
+{
+	kWarpEventQueueLength = 8, // A power of two, at most 128
+} WarpEventQueueConstants;
+
+typedef enum
+{
+	kWarpEventSensorInterrupt = 0, // The MAX30105 interrupt line fell; argument is the PORTA interrupt flags
+} WarpEventTag;
+
+typedef struct
+{
+	uint8_t tag; // WarpEventTag
+	uint16_t argument;
+} WarpEvent;
+
+bool eventQueuePush(WarpEventTag tag, uint16_t argument);
+
+bool eventQueuePop(WarpEvent *event);
+
+uint16_t eventQueueGetDropped(void);
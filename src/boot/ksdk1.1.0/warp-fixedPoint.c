@@ -0,0 +1,93 @@
+#include <stdint.h>
+
+#include "fsl_spi_master_driver.h"
+
+#include "warp.h"
+#include "warp-fixedPoint.h"
+
+const uint32_t gWarpFixedPointReciprocals[kWarpFixedPointReciprocalTableDivisors] = {
+	0xFFFFFFFF, 0x7FFFFFFF, 0x55555555, 0x3FFFFFFF, // 1 to 4
+	0x33333333, 0x2AAAAAAA, 0x24924924, 0x1FFFFFFF, // 5 to 8
+	0x1C71C71C, 0x19999999, 0x1745D174, 0x15555555, // 9 to 12
+	0x13B13B13, 0x12492492, 0x11111111, 0x0FFFFFFF, // 13 to 16
+	0x0F0F0F0F, 0x0E38E38E, 0x0D79435E, 0x0CCCCCCC, // 17 to 20
+	0x0C30C30C, 0x0BA2E8BA, 0x0B21642C, 0x0AAAAAAA, // 21 to 24
+	0x0A3D70A3, 0x09D89D89, 0x097B425E, 0x09249249, // 25 to 28
+	0x08D3DCB0, 0x08888888, 0x08421084, 0x07FFFFFF, // 29 to 32
+	0x07C1F07C, 0x07878787, 0x07507507, 0x071C71C7, // 33 to 36
+	0x06EB3E45, 0x06BCA1AF, 0x06906906, 0x06666666, // 37 to 40
+	0x063E7063, 0x06186186, 0x05F417D0, 0x05D1745D, // 41 to 44
+	0x05B05B05, 0x0590B216, 0x0572620A, 0x05555555, // 45 to 48
+	0x05397829, 0x051EB851, 0x05050505, 0x04EC4EC4, // 49 to 52
+	0x04D4873E, 0x04BDA12F, 0x04A7904A, 0x04924924, // 53 to 56
+	0x047DC11F, 0x0469EE58, 0x0456C797, 0x04444444, // 57 to 60
+	0x04325C53, 0x04210842, 0x04104104, 0x03FFFFFF, // 61 to 64
+};
+
+/*
+ *	floor((2^32 - 1) / divisor) for divisors above the table. The divisor is
+ *	shifted up to [2^15, 2^16), and its reciprocal x ~ 2^46 / normalised kept as
+ *	a Q30 fraction in [1, 2]. The seed is the table entry for the next whole
+ *	multiple of 2^10 above the normalised divisor, which is 5 bits good and
+ *	never too large; each Newton-Raphson step, x += x (1 - normalised x),
+ *	doubles the good bits. What the truncations leave is put right by the
+ *	remainder check at the end.
+ */
+WARP_RAMFUNC uint32_t
+fixedPointReciprocalNewton(uint16_t divisor)
+{
+	uint32_t normalised = divisor;
+	uint8_t shift = 0;
+	uint32_t x;
+	uint32_t product;
+	uint32_t reciprocal;
+
+	while (!(normalised & 0x8000))
+	{
+		normalised <<= 1;
+		shift++;
+	}
+
+	x = gWarpFixedPointReciprocals[normalised >> 10] << 4;
+	for (uint8_t step = 0; step < 3; step++)
+	{
+		product = fixedPointMultiplyHigh(normalised << 16, x); // normalised x in Q30
+		if (product <= (1UL << 30))
+		{
+			x += fixedPointMultiplyHigh(x, ((1UL << 30) - product) << 2);
+		}
+		else
+		{
+			x -= fixedPointMultiplyHigh(x, (product - (1UL << 30)) << 2);
+		}
+	}
+
+	reciprocal = x >> (14 - shift);
+	while (reciprocal * divisor < 0x80000000) // The product wrapped past 2^32
+	{
+		reciprocal--;
+	}
+	while (~(reciprocal * divisor) >= divisor) // (2^32 - 1) - reciprocal divisor is the remainder
+	{
+		reciprocal++;
+	}
+	return reciprocal;
+}
+
+/*
+ *	value as packed BCD, the least significant digit in the lowest nibble.
+ */
+uint32_t
+fixedPointToBcd(uint16_t value)
+{
+	uint32_t bcd = 0;
+	uint16_t quotient;
+
+	for (uint8_t digit = 0; digit < kWarpFixedPointBcdDigits; digit++)
+	{
+		quotient = fixedPointDivideBy10(value);
+		bcd |= (uint32_t)(value - quotient * 10) << (4 * digit);
+		value = quotient;
+	}
+	return bcd;
+}
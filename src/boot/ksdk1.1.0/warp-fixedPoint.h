@@ -0,0 +1,96 @@
+/*
+ *	Integer division without a divider. The Cortex-M0+ multiplies 32 by 32 bits
+ *	in a single cycle but has no divide instruction, so each / and % becomes a
+ *	call to libgcc's shift-and-subtract loop. The divisions on the per-sample
+ *	path are done here with multiplications instead:
+ *
+ *	fixedPointReciprocal() gives floor((2^32 - 1) / divisor) for any non-zero
+ *	16-bit divisor. Divisors up to kWarpFixedPointReciprocalTableDivisors come
+ *	from gWarpFixedPointReciprocals; larger ones take three Newton-Raphson steps
+ *	from a seed in the same table. fixedPointDivide() turns a reciprocal into
+ *	an exact quotient with one multiplication and at most one correction, so a
+ *	divisor shared by several dividends costs a single reciprocal.
+ *
+ *	fixedPointDivideBy10() divides by a constant with a multiply and a shift, and
+ *	fixedPointToBcd() uses it to split a value into decimal digits.
+ *
+ *	The helpers are static inline, so WARP_RAMFUNC callers keep them in SRAM,
+ *	except fixedPointReciprocalNewton(), which is too large to inline and is
+ *	itself WARP_RAMFUNC. A Newton reciprocal costs more than the one libgcc
+ *	division it stands in for, so it only pays where the divisor is reused:
+ *	callers keep the reciprocal and recompute it only when the divisor changes.
+ *	test/warp-fixedPointTest.c checks every 16-bit divisor and every 16-bit
+ *	value against the C operators on the host: make -C test.
+ */
+
+typedef enum
+{
+	kWarpFixedPointReciprocalTableDivisors = 64, // Also sets the seed precision for the larger divisors
+	kWarpFixedPointBcdDigits = 5, // Enough for any uint16_t
+} WarpFixedPointConstants;
+
+extern const uint32_t gWarpFixedPointReciprocals[kWarpFixedPointReciprocalTableDivisors]; // floor((2^32 - 1) / (index + 1))
+
+uint32_t fixedPointReciprocalNewton(uint16_t divisor);
+
+uint32_t fixedPointToBcd(uint16_t value);
+
+/*
+ *	The upper half of the 64-bit product, from four 16 by 16 bit products, since
+ *	the M0+ multiplier only returns the lower half.
+ */
+static inline uint32_t
+fixedPointMultiplyHigh(uint32_t a, uint32_t b)
+{
+	uint32_t aLow = a & 0xFFFF;
+	uint32_t aHigh = a >> 16;
+	uint32_t bLow = b & 0xFFFF;
+	uint32_t bHigh = b >> 16;
+	uint32_t low = aLow * bLow;
+	uint32_t middle0 = aHigh * bLow;
+	uint32_t middle1 = aLow * bHigh;
+	uint32_t carry = ((low >> 16) + (middle0 & 0xFFFF) + (middle1 & 0xFFFF)) >> 16;
+
+	return aHigh * bHigh + (middle0 >> 16) + (middle1 >> 16) + carry;
+}
+
+/*
+ *	divisor must not be 0. Divisors above the table take the Newton-Raphson
+ *	path, several times the cost of a table read.
+ */
+static inline uint32_t
+fixedPointReciprocal(uint16_t divisor)
+{
+	if (divisor <= kWarpFixedPointReciprocalTableDivisors)
+	{
+		return gWarpFixedPointReciprocals[divisor - 1];
+	}
+	return fixedPointReciprocalNewton(divisor);
+}
+
+/*
+ *	dividend / divisor, rounded down, for any 32-bit dividend. reciprocal is
+ *	fixedPointReciprocal(divisor). Since the reciprocal is at most one unit
+ *	short, the first estimate is the quotient or one less.
+ */
+static inline uint32_t
+fixedPointDivide(uint32_t dividend, uint16_t divisor, uint32_t reciprocal)
+{
+	uint32_t quotient = fixedPointMultiplyHigh(dividend, reciprocal);
+
+	if (dividend - quotient * divisor >= divisor)
+	{
+		quotient++;
+	}
+	return quotient;
+}
+
+/*
+ *	value / 10 for every uint16_t: 0xCCCD / 2^19 is 1/10 plus an error too small
+ *	to reach the next integer below 2^16.
+ */
+static inline uint16_t
+fixedPointDivideBy10(uint16_t value)
+{
+	return ((uint32_t)value * 0xCCCD) >> 19;
+}
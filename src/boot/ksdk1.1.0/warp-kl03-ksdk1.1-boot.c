@@ -58,16 +58,40 @@
 
 #include "devSSD1331.h"
 #include "devMAX30105.h"
+#include "warp-bpmTrend.h"
+#include "warp-fixedPoint.h"
+#include "warp-pipeline.h"
+#include "warp-busConfig.h"
+#include "warp-profile.h"
+#include "warp-rawStream.h"
+#include "warp-log.h"
+#include "warp-command.h"
+#include "warp-sessionLog.h"
+#include "warp-stack.h"
+#include "warp-eventQueue.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_embedded.h"
+#include "hal_time_ms.h"
+
+#ifdef WARP_BUILD_ENABLE_BLE
+#include "warp-bleHeartRate.h"
+#endif
 
 #define WARP_BUILD_ENABLE_SEGGER_RTT_PRINTF
 
+/*
+ *	Skip the boot countdown, the LED toggling and the long display reset delays.
+ */
+#define WARP_BUILD_ENABLE_FAST_BOOT
+
 volatile WarpI2CDeviceState deviceMAX30105State;
 
 volatile i2c_master_state_t i2cMasterState;
 volatile spi_master_state_t spiMasterState;
 volatile spi_master_user_config_t spiUserConfig;
 
-volatile uint32_t gWarpI2cBaudRateKbps = 200;
+volatile uint32_t gWarpI2cBaudRateKbps = 200; // Safe defaults until busConfigCalibrate() has run
 volatile uint32_t gWarpSpiBaudRateKbps = 200;
 volatile uint32_t gWarpI2cTimeoutMilliseconds = 5;
 volatile uint32_t gWarpSpiTimeoutMicroseconds = 5;
@@ -75,32 +99,84 @@ volatile uint32_t gWarpSpiTimeoutMicroseconds = 5;
 // CONSTANTS
 const uint32_t THRESHOLD_UP = 1024;
 const uint32_t THRESHOLD_DOWN = 2000;
-const uint32_t FIR_COEFFS[13] = {17, 67, 174, 383, 731, 1232, 1874, 2615, 3391, 4119, 4715, 5107, 20861}; //{17, 67, 174, 383, 731, 1232, 1874, 2615, 3391, 4119, 4715, 5107, 6000};
+const uint8_t TRACE_DECIMATION = 1; // Normalised samples per display column; the column shows their min/max envelope when > 1
 
 // GLOBAL VARIABLES
-volatile bool active = false;
-
-uint8_t buffer_pointer = 0;
-uint8_t buffer_size = 0;
-
-uint8_t filtered_buffer_pointer = 0;
-uint16_t filtered_buffer_size = 0;
-uint32_t filtered_buffer_mean;
-int16_t filtered_buffer_max;
-int16_t filtered_buffer_min;
+bool active = false;
 
-uint8_t normalised_buffer_pointer = 0;
-int16_t previous_derivative = 0;
-int16_t derivative = 0;
-uint16_t samples_since_beat = 0;
+uint16_t previous_beat_interval = 0;
+uint8_t signal_quality = kSSD1331TraceQualityPoor;
 
 int8_t display_count = 0;
+uint8_t trace_previous = 0;
+uint8_t trace_min;
+uint8_t trace_max;
+uint8_t trace_sample_count = 0;
 
 uint8_t previous_temperature = 0;
 uint8_t temperature = 1;
 uint16_t previous_bpm = 0;
 uint16_t bpm = 1;
 
+uint16_t boot_start_time = 0;
+bool first_bpm_reported = false;
+
+/*
+ *	The application runs as run-loop tasks, polled in priority order each pass:
+ *	interrupt events, sensor drain, DSP, then display flush. Interrupt handlers
+ *	share nothing with the tasks but the event queue (warp-eventQueue.h). Each stage hands work to the next
+ *	through a short queue. The DSP stage takes every queued sample as one block,
+ *	and the display stage one column per pass, so a slow display update cannot
+ *	hold off the sensor drain. The core sleeps once no stage has work left.
+ */
+typedef enum
+{
+	kWarpTaskSampleQueueLength = WARP_PIPELINE_BLOCK_SAMPLES, // Both queue lengths must be powers of two
+	kWarpTaskTraceQueueLength = WARP_PIPELINE_BLOCK_SAMPLES, // Room for a whole block
+	kWarpTaskHousekeepingPeriodMilliseconds = 1000,
+} WarpTaskConstants;
+
+/*
+ *	The queues are indexed with their lengths minus one.
+ */
+WARP_STATIC_ASSERT((kWarpTaskSampleQueueLength & (kWarpTaskSampleQueueLength - 1)) == 0, "kWarpTaskSampleQueueLength must be a power of two");
+WARP_STATIC_ASSERT((kWarpTaskTraceQueueLength & (kWarpTaskTraceQueueLength - 1)) == 0, "kWarpTaskTraceQueueLength must be a power of two");
+#ifdef WARP_STACK_SIZE
+WARP_STATIC_ASSERT(sizeof(WarpPipeline) + kWarpTaskSampleQueueLength * sizeof(int32_t) + kWarpStackMinimumHeadroomBytes <= WARP_STACK_SIZE, "WarpPipeline and the DSP block leave too little of the stack, raise WARP_STACK_SIZE in CMakeLists.txt");
+#endif
+
+/*
+ *	The DSP stage state. It is allocated on main()'s stack, which is never
+ *	unwound because the run loop does not return.
+ */
+WarpPipeline *pipeline;
+
+btstack_data_source_t event_task;
+btstack_data_source_t sensor_task;
+btstack_data_source_t dsp_task;
+btstack_data_source_t display_task;
+btstack_timer_source_t housekeeping_timer;
+#ifdef WARP_BUILD_ENABLE_COMMANDS
+btstack_data_source_t command_task;
+#endif
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+btstack_data_source_t session_log_task;
+#endif
+
+bool sensor_interrupt_pending = false;
+bool temperature_requested = false;
+uint32_t trend_tick_due; // btstack_run_loop_get_time_ms() at which the next trend second closes
+
+uint16_t sample_queue[kWarpTaskSampleQueueLength];
+uint8_t sample_queue_head = 0;
+uint8_t sample_queue_count = 0;
+
+uint8_t trace_queue[kWarpTaskTraceQueueLength];
+uint8_t trace_queue_head = 0;
+uint8_t trace_queue_count = 0;
+
+volatile uint32_t gWarpMAX30105LostSamples = 0; // Samples overwritten in the sensor FIFO before the drain task read them
+
 void enableSPIpins(void)
 {
 	CLOCK_SYS_EnableSpiClock(0);
@@ -119,9 +195,13 @@ void enableSPIpins(void)
 	spiUserConfig.polarity = kSpiClockPolarity_ActiveHigh;
 	spiUserConfig.phase = kSpiClockPhase_FirstEdge;
 	spiUserConfig.direction = kSpiMsbFirst;
-	spiUserConfig.bitsPerSec = gWarpSpiBaudRateKbps * 1000;
+	if (spiUserConfig.bitsPerSec == 0) // Otherwise keep the rate busConfig last requested, rather than the rounded-down one it reports
+	{
+		spiUserConfig.bitsPerSec = gWarpSpiBaudRateKbps * 1000;
+	}
 	SPI_DRV_MasterInit(0 /* SPI master instance */, (spi_master_state_t *)&spiMasterState);
 	SPI_DRV_MasterConfigureBus(0 /* SPI master instance */, (spi_master_user_config_t *)&spiUserConfig, &calculatedBaudRate);
+	gWarpSpiBaudRateKbps = calculatedBaudRate / 1000;
 }
 
 void disableSPIpins(void)
@@ -174,9 +254,11 @@ void disableI2Cpins(void)
 
 void PORTA_IRQHandler(void)
 {
-	// Perhaps need to abstract out large code to another function due to little space in the vector table
+	uint32_t flags = PORT_HAL_GetPortIntFlag(PORTA_BASE);
+
 	PORT_HAL_ClearPortIntFlag(PORTA_BASE);
-	active = true;
+	eventQueuePush(kWarpEventSensorInterrupt, flags);
+	btstack_run_loop_embedded_trigger();
 	return;
 }
 
@@ -188,140 +270,459 @@ void clearPowerReadyStatus(void)
 	return;
 }
 
+// Maps 40..200 bpm onto the 50 rows of the trace area
+uint8_t trendRow(uint8_t bpm)
+{
+	if (bpm < 40)
+	{
+		return 0;
+	}
+	if (bpm > 200)
+	{
+		return 50;
+	}
+	return ((bpm - 40) * 5) >> 4;
+}
+
+/*
+ *	Renders the trend page from the precomputed trend buckets: one 4-column bar per
+ *	bucket, oldest on the left, spanning the bucket min to max with a tick at the
+ *	mean. Uses the coarsest level that holds at least two buckets.
+ */
+void displayTrend(void)
+{
+	uint8_t level = kWarpBpmTrendLevelTenMinutes;
+	while ((level > kWarpBpmTrendLevelSecond) & (bpmTrendGetBucketCount(level) < 2))
+	{
+		level--;
+	}
+
+	uint8_t count = bpmTrendGetBucketCount(level);
+	for (uint8_t age = 0; age < count; age++)
+	{
+		const WarpBpmTrendBucket *bucket = bpmTrendGetBucket(level, age);
+		uint8_t column = (kWarpBpmTrendBucketsPerLevel - 1 - age) * 4;
+
+		if (bucket->mean == 0) // No beats during this bucket
+		{
+			continue;
+		}
+
+		uint8_t low = trendRow(bucket->min);
+		uint8_t high = trendRow(bucket->max);
+
+		traceEnvelope(column, low, low, high, kSSD1331TraceQualityFair);
+		traceEnvelope(column + 1, low, low, high, kSSD1331TraceQualityFair);
+		traceLine(column + 2, trendRow(bucket->mean), trendRow(bucket->mean), kSSD1331TraceQualityGood);
+	}
+	return;
+}
+
 void reset(void)
 {
 	// Reset mode
 	writeSensorRegisterMAX30105(MODE_CONFIG, 0x03);
 	clearPowerReadyStatus();
 
-	// Clear screen
+	// Clear screen and show the trend page until the next finger is detected
 	clearScreen();
-	display_count = 0;
+	displayTrend();
+	display_count = 96; // Clears the trend page and redraws the header on the first sample
+
+#ifdef WARP_BUILD_ENABLE_BLE
+	bleHeartRateContactLost();
+#endif
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	sessionLogContactLost();
+#endif
+
+#ifdef WARP_BUILD_ENABLE_SEGGER_RTT_PRINTF
+	busConfigPrintStatistics();
+	WARP_LOG("Lost %u samples\n\r", gWarpMAX30105LostSamples);
+	WARP_LOG("Dropped %u interrupt events\n\r", eventQueueGetDropped());
+	WARP_LOG("Stack high water %u of %u bytes\n\r", stackGetHighWater(), stackGetReserve());
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	WARP_LOG("Dropped %u session log records\n\r", sessionLogGetDropped());
+#endif
+#endif
+	trace_sample_count = 0;
+	signal_quality = kSSD1331TraceQualityPoor;
+	previous_beat_interval = 0;
 
 	// Reset variables
 	active = false;
-	buffer_pointer = 0;
-	buffer_size = 0;
-	filtered_buffer_pointer = 0;
-	filtered_buffer_size = 0;
+	pipelineReset(pipeline);
 	previous_temperature = 0;
 	temperature = 1; // temperature != previous_temperature so screen updates
+	temperature_requested = false;
+	sample_queue_count = 0;
+	trace_queue_count = 0;
 	return;
 }
 
-int16_t bandPassFilter(uint16_t *buffer)
+void readTemp(void)
 {
-	uint64_t f = FIR_COEFFS[13] * buffer[(buffer_pointer - 13) & 0x1F];
-	for (int i = 0; i < 13; i++)
+	readSensorRegisterMAX30105(TEMP_INT, 1);
+	previous_temperature = temperature;
+	temperature = deviceMAX30105State.i2cBuffer[0];
+	return;
+}
+
+// Text is drawn with the bitmap font over a black background, so the header needs no clearing beforehand
+void displayTemp(uint8_t temp)
+{
+	char text[] = "   \x7F" "C"; // 0x7F is the degree sign in the display font
+	uint32_t digits = fixedPointToBcd(temp);
+
+	int i = 2;
+	do
+	{
+		text[i] = '0' + (digits & 0xF);
+		digits >>= 4;
+		i--;
+	} while (digits && (i >= 0));
+
+	writeString(66, 63, text, kSSD1331ColourWhite);
+	return;
+}
+
+void displayBPM(uint16_t bpm)
+{
+	char text[] = "---.- bpm";
+	uint32_t digits;
+
+	if (!((bpm < 200) | (bpm > 4000))) // Extreme values are shown as dashes
 	{
-		f += FIR_COEFFS[i] * (buffer[(buffer_pointer - 25 + i) & 0x1F] + buffer[(buffer_pointer - i) & 0x1F]);
+		digits = fixedPointToBcd(bpm);
+		text[4] = '0' + (digits & 0xF);
+		digits >>= 4;
+		for (int i = 2; i >= 0; i--)
+		{
+			text[i] = digits ? '0' + (digits & 0xF) : ' ';
+			digits >>= 4;
+		}
+	}
+
+	writeString(0, 63, text, kSSD1331ColourWhite);
+	return;
+}
+
+/*
+ *	Grades the signal from the consistency of successive beat intervals: a clean
+ *	pulse gives intervals within 1/8 of each other, a noisy one does not.
+ */
+void updateSignalQuality(uint16_t beat_interval)
+{
+	uint16_t difference = (beat_interval > previous_beat_interval) ? (beat_interval - previous_beat_interval) : (previous_beat_interval - beat_interval);
+
+	if ((bpm < 200) | (bpm > 4000)) // Extreme values
+	{
+		signal_quality = kSSD1331TraceQualityPoor;
+	}
+	else if (difference <= (beat_interval >> 3))
+	{
+		signal_quality = kSSD1331TraceQualityGood;
+	}
+	else if (difference <= (beat_interval >> 2))
+	{
+		signal_quality = kSSD1331TraceQualityFair;
+	}
+	else
+	{
+		signal_quality = kSSD1331TraceQualityPoor;
+	}
+	previous_beat_interval = beat_interval;
+	return;
+}
+
+void writeToDisplay(uint8_t next_value)
+{
+	if (display_count > 95)
+	{
+		clearTraceArea();
+		display_count = 0;
+		if (bpm != previous_bpm)
+		{
+			displayBPM(bpm);
+		}
 	}
-	f = f >> 16;
 
-	uint64_t g = 0;
-	for (int i = 0; i < buffer_size; i++)
+	// Accumulate the envelope of the samples that share this column
+	if ((trace_sample_count == 0) | (next_value < trace_min))
+	{
+		trace_min = next_value;
+	}
+	if ((trace_sample_count == 0) | (next_value > trace_max))
 	{
-		g += buffer[i];
+		trace_max = next_value;
 	}
-	g = (g / buffer_size);
+	trace_sample_count++;
+	if (trace_sample_count < TRACE_DECIMATION)
+	{
+		return;
+	}
+	trace_sample_count = 0;
 
-	return f - g;
+	if (TRACE_DECIMATION == 1)
+	{
+		traceLine(display_count, trace_previous, next_value, signal_quality);
+	}
+	else
+	{
+		traceEnvelope(display_count, trace_previous, trace_min, trace_max, signal_quality);
+	}
+	trace_previous = next_value;
+	display_count++;
+	return;
 }
 
-uint8_t getNormalisedValue(int16_t filtered_sample, int16_t *filtered_buffer)
+/*
+ *	Runs a block of raw samples through the pipeline in place and, for each
+ *	sample out of the filter, reports any beat and queues the normalised value
+ *	for the display task.
+ */
+void processBlock(int32_t *block, uint8_t count)
 {
-	filtered_buffer_mean = 0;
-	filtered_buffer_max = filtered_buffer[0];
-	filtered_buffer_min = filtered_buffer[0];
+	uint16_t beat_interval;
 
-	for (int i = 0; i < filtered_buffer_size; i++)
+	count = pipelineProcess(pipeline, block, count);
+	for (uint8_t i = 0; i < count; i++)
 	{
-		filtered_buffer_mean += filtered_buffer[i];
-		if (filtered_buffer[i] > filtered_buffer_max)
+		beat_interval = WARP_PIPELINE_BEAT_INTERVAL(block[i]);
+		if (beat_interval)
 		{
-			filtered_buffer_max = filtered_buffer[i];
+			bpm = fixedPointDivide(60000, beat_interval, fixedPointReciprocal(beat_interval)); // The least significant digit has order 0.1
+			updateSignalQuality(beat_interval);
+			bpmTrendAddBeat(bpm);
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+			sessionLogBeat(bpm, beat_interval);
+#endif
+#ifdef WARP_BUILD_ENABLE_BLE
+			bleHeartRateBeat(bpm, beat_interval);
+#endif
+#ifdef WARP_BUILD_ENABLE_SEGGER_RTT_PRINTF
+			if (!first_bpm_reported)
+			{
+				// The OSA millisecond counter is 16 bits wide, so this wraps after 65 s
+				WARP_LOG("First BPM after %u ms\n\r", (uint16_t)(OSA_TimeGetMsec() - boot_start_time));
+				first_bpm_reported = true;
+			}
+#endif
 		}
-		else if (filtered_buffer[i] < filtered_buffer_min)
+		// Queue for the display
+		trace_queue[(trace_queue_head + trace_queue_count) & (kWarpTaskTraceQueueLength - 1)] = WARP_PIPELINE_NORMALISED(block[i]);
+		trace_queue_count++;
+	}
+	return;
+}
+
+/*
+ *	Highest priority: drains the events queued by the interrupt handlers and
+ *	turns them into work for the other tasks in the same pass.
+ */
+void eventTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+	WarpEvent event;
+
+	while (eventQueuePop(&event))
+	{
+		switch (event.tag)
 		{
-			filtered_buffer_min = filtered_buffer[i];
+		case kWarpEventSensorInterrupt:
+		{
+			active = true;
+			sensor_interrupt_pending = true;
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
 		}
 	}
-	filtered_buffer_mean /= filtered_buffer_size;
-	return (filtered_sample - filtered_buffer_min) * 50 / (filtered_buffer_max - filtered_buffer_min);
+	return;
 }
 
-void readTemp(void)
+/*
+ *	Next priority: runs after each sensor interrupt and moves every sample in
+ *	the sensor FIFO into the sample queue, so the FIFO never fills while the
+ *	lower priority tasks are busy. Samples are read in bursts of as many as the
+ *	queue has room for.
+ */
+void sensorTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
 {
-	readSensorRegisterMAX30105(TEMP_INT, 1);
-	previous_temperature = temperature;
-	temperature = deviceMAX30105State.i2cBuffer[0];
+	uint16_t sample;
+	uint8_t burst_count;
+
+	if (!sensor_interrupt_pending)
+	{
+		return;
+	}
+	sensor_interrupt_pending = false;
+
+	// Release the interrupt line first, so any sample arriving during the drain raises a new edge
+	clearPowerReadyStatus();
+
+	while (sample_queue_count < kWarpTaskSampleQueueLength)
+	{
+		WARP_PROFILE_BEGIN(kWarpProfileProbeI2cBurst);
+		SamplingStatus status = readSampleBurst(kWarpTaskSampleQueueLength - sample_queue_count, &burst_count);
+		WARP_PROFILE_END(kWarpProfileProbeI2cBurst);
+		if (status != SampleOK)
+		{
+			return;
+		}
+
+#ifdef WARP_BUILD_ENABLE_RAW_STREAM
+		rawStreamWriteBurst(deviceMAX30105State.i2cBuffer, burst_count);
+#endif
+
+		for (uint8_t i = 0; i < burst_count; i++)
+		{
+			sample = getBurstSample(i);
+
+			// Check if finger has been removed
+			if (sample < THRESHOLD_DOWN)
+			{
+				reset();
+				return;
+			}
+
+			sample_queue[(sample_queue_head + sample_queue_count) & (kWarpTaskSampleQueueLength - 1)] = sample;
+			sample_queue_count++;
+		}
+	}
+
+	// The sample queue is full: leave the rest in the sensor FIFO and drain again on the next pass
+	sensor_interrupt_pending = true;
+	btstack_run_loop_embedded_trigger();
 	return;
 }
 
-void displayTemp(uint8_t temp)
+void dspTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
 {
-	writeCharacter(86, 63, 'o');
-	writeCharacter(91, 63, 'C');
+	int32_t block[kWarpTaskSampleQueueLength];
+	uint8_t count = sample_queue_count;
+
+	// The filter puts out at most one sample per sample in, so the block is bounded by the room in the trace queue
+	if (count > kWarpTaskTraceQueueLength - trace_queue_count)
+	{
+		count = kWarpTaskTraceQueueLength - trace_queue_count;
+	}
+	if (count == 0)
+	{
+		return;
+	}
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		block[i] = sample_queue[sample_queue_head];
+		sample_queue_head = (sample_queue_head + 1) & (kWarpTaskSampleQueueLength - 1);
+	}
+	sample_queue_count -= count;
+
+	processBlock(block, count);
 
-	int i = 78;
-	while (temp)
+	if (sample_queue_count)
 	{
-		writeDigit(i, 63, temp % 10);
-		temp /= 10;
-		i -= 6;
+		btstack_run_loop_embedded_trigger();
 	}
+	return;
 }
 
-void displayBPM(uint16_t bpm)
+void displayTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
 {
-	writeCharacter(30, 63, 'b');
-	writeCharacter(36, 63, 'p');
-	writeCharacter(42, 63, 'm');
+	if (trace_queue_count == 0)
+	{
+		return;
+	}
 
-	if ((bpm < 200) | (bpm > 4000)) // Extreme values
+	uint8_t next_value = trace_queue[trace_queue_head];
+	trace_queue_head = (trace_queue_head + 1) & (kWarpTaskTraceQueueLength - 1);
+	trace_queue_count--;
+
+	WARP_PROFILE_BEGIN(kWarpProfileProbeDisplay);
+	writeToDisplay(next_value);
+	WARP_PROFILE_END(kWarpProfileProbeDisplay);
+
+	if (trace_queue_count)
 	{
-		writeCharacter(0, 63, '-');
-		writeCharacter(6, 63, '-');
-		writeCharacter(12, 63, '-');
-		writeCharacter(18, 63, '.');
-		writeCharacter(22, 63, '-');
+		btstack_run_loop_embedded_trigger();
 	}
-	else
+	return;
+}
+
+#ifdef WARP_BUILD_ENABLE_COMMANDS
+/*
+ *	Low priority: executes host commands waiting in the RTT down-buffer. While
+ *	idle the core sleeps, so a command waits for the next sensor interrupt or
+ *	housekeeping pass.
+ */
+void commandTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+	commandPoll();
+	return;
+}
+#endif
+
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+/*
+ *	Lowest priority: writes batched session log records to flash. Runs only when
+ *	no sensor drain is outstanding, so the sensor FIFO has just been emptied and
+ *	can hold the samples that arrive while the flash is busy.
+ */
+void sessionLogTaskProcess(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+	if (sensor_interrupt_pending)
 	{
-		writeDigit(22, 63, bpm % 10);
-		writeCharacter(18, 63, '.');
-		bpm /= 10;
-		int i = 12;
-		while (bpm)
-		{
-			writeDigit(i, 63, bpm % 10);
-			bpm /= 10;
-			i -= 6;
-		}
+		return;
 	}
+	sessionLogPoll();
 	return;
 }
+#endif
 
-void writeToDisplay(uint8_t previous_value, uint8_t next_value)
+/*
+ *	Once a second while a finger is present: show the temperature converted since
+ *	the last pass and start the next conversion. Also forces a sensor drain, in
+ *	case an interrupt edge was missed. Always: advances the BPM trend by the
+ *	seconds that have passed, since the timer itself runs a little late each time.
+ */
+void housekeepingTimerProcess(btstack_timer_source_t *ts)
 {
-	if (display_count > 95)
+	if (active)
 	{
-		clearTraceArea();
-		display_count = 0;
-		readTemp();
-		if (temperature != previous_temperature)
-		{
-			clearSection(72, 0, 90, 8);
-			displayTemp(temperature);
-		}
-		if (bpm != previous_bpm)
+		if (temperature_requested)
 		{
-			clearSection(0, 0, 28, 8);
-			displayBPM(bpm);
+			readTemp();
+			if (temperature != previous_temperature)
+			{
+				displayTemp(temperature);
+			}
 		}
+		temperature_requested = (writeSensorRegisterMAX30105(TEMP_CONFIG, 0x01) == CommStatusOK);
+
+		// Timers run after the data sources in a pass, so trigger another one before the core sleeps
+		sensor_interrupt_pending = true;
+		btstack_run_loop_embedded_trigger();
 	}
-	traceLine(display_count, previous_value, next_value);
-	display_count++;
+
+	while ((int32_t)(btstack_run_loop_get_time_ms() - trend_tick_due) >= 0)
+	{
+		bpmTrendTick();
+		trend_tick_due += kWarpBpmTrendTickMilliseconds;
+	}
+
+#ifdef WARP_BUILD_ENABLE_PROFILING
+	profileDump();
+#endif
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	sessionLogSecond();
+#endif
+
+	btstack_run_loop_set_timer(ts, kWarpTaskHousekeepingPeriodMilliseconds);
+	btstack_run_loop_add_timer(ts);
 	return;
 }
 
@@ -343,6 +744,25 @@ int main(void)
 	 */
 	OSA_Init();
 
+	/*
+	 *	Start the RTC time base for the run loop timers now, since its crystal
+	 *	takes a while to start.
+	 */
+	hal_time_ms_init();
+
+#ifdef WARP_BUILD_ENABLE_DEFERRED_LOG
+	logInit();
+#endif
+#ifdef WARP_BUILD_ENABLE_PROFILING
+	profileInit();
+#endif
+#ifdef WARP_BUILD_ENABLE_RAW_STREAM
+	rawStreamInit();
+#endif
+#ifdef WARP_BUILD_ENABLE_COMMANDS
+	commandInit();
+#endif
+
 	/*
 	 *	Setup SEGGER RTT to output as much as fits in buffers.
 	 *
@@ -351,12 +771,18 @@ int main(void)
 	 */
 	SEGGER_RTT_ConfigUpBuffer(0, NULL, NULL, 0, SEGGER_RTT_MODE_NO_BLOCK_TRIM);
 
+	boot_start_time = OSA_TimeGetMsec();
+
+#ifdef WARP_BUILD_ENABLE_FAST_BOOT
+	SEGGER_RTT_WriteString(0, "\n\n\n\rBooting Heart Rate Monitor\n\r");
+#else
 	SEGGER_RTT_WriteString(0, "\n\n\n\rBooting Heart Rate Monitor, in 3... ");
 	OSA_TimeDelay(200);
 	SEGGER_RTT_WriteString(0, "2... ");
 	OSA_TimeDelay(200);
 	SEGGER_RTT_WriteString(0, "1...\n\r");
 	OSA_TimeDelay(200);
+#endif
 
 	/*
 	 *	Initialize the GPIO pins with the appropriate pull-up, etc.,
@@ -366,6 +792,7 @@ int main(void)
 	 */
 	GPIO_DRV_Init(inputPins /* input pins */, outputPins /* output pins */);
 
+#ifndef WARP_BUILD_ENABLE_FAST_BOOT
 	/*
 	 *	Toggle LED3 (kWarpPinSI4705_nRST)
 	 */
@@ -380,6 +807,7 @@ int main(void)
 	GPIO_DRV_SetPinOutput(kWarpPinSI4705_nRST);
 	OSA_TimeDelay(200);
 	GPIO_DRV_ClearPinOutput(kWarpPinSI4705_nRST);
+#endif
 
 	// Enable interrupt port
 	PORT_HAL_SetMuxMode(PORTA_BASE, 7u, kPortMuxAsGpio);
@@ -388,80 +816,85 @@ int main(void)
 	enableSPIpins();
 	enableI2Cpins(32768);
 
-	// Initialise and configure all devices
-	devSSD1331init();
+	/*
+	 *	Initialise and configure all devices. The display reset runs in the
+	 *	background while the sensor is configured and its power-ready status
+	 *	is cleared.
+	 */
+#ifdef WARP_BUILD_ENABLE_FAST_BOOT
+	devSSD1331initStart(1 /* reset delay in milliseconds */);
+#else
+	devSSD1331initStart(100 /* reset delay in milliseconds */);
+#endif
 	devMAX30105init(0x57 /* i2cAddress */);
-
-	// Initialise data buffers
-	uint16_t sample;
-	uint16_t buffer[32];
-	int16_t filtered_sample;
-	int16_t filtered_buffer[256];
-	uint8_t normalised_buffer[4];
-
+	bpmTrendInit();
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	sessionLogInit();
+#endif
 	clearPowerReadyStatus();
-
-	while (1)
+	while (!devSSD1331initPoll())
 	{
-		while (active)
-		{
-			SamplingStatus readStatus = readNextSample(&sample);
-			if (readStatus == SampleOK)
-			{
-				// Check if finger has been removed
-				if ((sample < THRESHOLD_DOWN))
-				{
-					reset();
-					break;
-				}
-
-				// Write sample to buffer
-				buffer[buffer_pointer] = sample;
-
-				// If buffer is full, filter and trace the signal
-				if (buffer_size == 32)
-				{
-					filtered_sample = bandPassFilter(buffer);
-
-					// Write filtered sample to filtered buffer
-					filtered_buffer[filtered_buffer_pointer] = filtered_sample;
-					filtered_buffer_pointer++; // Increment filtered buffer pointer. No need to modulo as the 8 bit pointer overflows at 256.
-					if (filtered_buffer_size < 256)
-					{
-						filtered_buffer_size++;
-					}
-
-					// Calculate normalised value
-					normalised_buffer[normalised_buffer_pointer] = getNormalisedValue(filtered_sample, filtered_buffer);
-
-					// Check for beat
-					previous_derivative = derivative;
-					derivative = normalised_buffer[normalised_buffer_pointer] - normalised_buffer[(normalised_buffer_pointer - 2) & 0x03]; // Calculates derivative at previous sample
-
-					if ((previous_derivative < 0) & (derivative >= 0) & (normalised_buffer[(normalised_buffer_pointer - 1) & 0x03] < 15))
-					{
-						bpm = 60000 / samples_since_beat; // The least significant digit has order 0.1
-						samples_since_beat = 0;
-					}
-					samples_since_beat++;
-
-					// Request a temperature reading every 96 samples, 0.5 seconds before reading it
-					if (display_count == 46)
-					{
-						writeSensorRegisterMAX30105(TEMP_CONFIG, 0x01);
-					}
-
-					// Write to display and increment normalised buffer pointer
-					writeToDisplay(normalised_buffer[(normalised_buffer_pointer - 1) & 0x03], normalised_buffer[normalised_buffer_pointer]);
-					normalised_buffer_pointer = (normalised_buffer_pointer + 1) & 0x03; // Increment normliased buffer pointer, modulo 4
-				}
-				else
-				{
-					buffer_size++;
-				}
-				buffer_pointer = (buffer_pointer + 1) & 0x1F; // Increment buffer pointer, modulo 32
-			}
-		}
 	}
+
+	// Run I2C at the fastest rate that passes its self-test, SPI at its fastest
+	busConfigCalibrate();
+#ifdef WARP_BUILD_ENABLE_SEGGER_RTT_PRINTF
+	busConfigPrintStatistics();
+#endif
+
+#ifdef WARP_BUILD_ENABLE_SEGGER_RTT_PRINTF
+	WARP_LOG("Ready to sample after %u ms\n\r", (uint16_t)(OSA_TimeGetMsec() - boot_start_time));
+#endif
+
+	/*
+	 *	Hand over to the run loop. The tasks are added lowest priority first,
+	 *	since each is polled in the reverse order of being added.
+	 */
+	WarpPipeline stages;
+
+	pipeline = &stages;
+	pipelineReset(pipeline);
+
+	btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
+
+#ifdef WARP_BUILD_ENABLE_BLE
+	// Brings up the controller and starts advertising in the background
+	bleHeartRateInit();
+#endif
+
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+	btstack_run_loop_set_data_source_handler(&session_log_task, &sessionLogTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&session_log_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&session_log_task);
+#endif
+
+#ifdef WARP_BUILD_ENABLE_COMMANDS
+	btstack_run_loop_set_data_source_handler(&command_task, &commandTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&command_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&command_task);
+#endif
+
+	btstack_run_loop_set_data_source_handler(&display_task, &displayTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&display_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&display_task);
+
+	btstack_run_loop_set_data_source_handler(&dsp_task, &dspTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&dsp_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&dsp_task);
+
+	btstack_run_loop_set_data_source_handler(&sensor_task, &sensorTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&sensor_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&sensor_task);
+
+	btstack_run_loop_set_data_source_handler(&event_task, &eventTaskProcess);
+	btstack_run_loop_enable_data_source_callbacks(&event_task, DATA_SOURCE_CALLBACK_POLL);
+	btstack_run_loop_add_data_source(&event_task);
+
+	trend_tick_due = btstack_run_loop_get_time_ms() + kWarpBpmTrendTickMilliseconds;
+	btstack_run_loop_set_timer_handler(&housekeeping_timer, &housekeepingTimerProcess);
+	btstack_run_loop_set_timer(&housekeeping_timer, kWarpTaskHousekeepingPeriodMilliseconds);
+	btstack_run_loop_add_timer(&housekeeping_timer);
+
+	btstack_run_loop_execute();
 	return 0;
 }
@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "SEGGER_RTT.h"
+#include "warp-log.h"
+
+#ifdef WARP_BUILD_ENABLE_DEFERRED_LOG
+
+typedef enum
+{
+	kWarpLogRttChannel = 3,
+	kWarpLogRttBufferSize = 128,
+	kWarpLogRecordHeaderBytes = 4,
+	kWarpLogMaxArgs = 10, // Enough for the longest btstack log_info(), see WARP_LOG_ARGS()
+} WarpLogConstants;
+
+static char logRttBuffer[kWarpLogRttBufferSize];
+static uint8_t logSequence;
+
+void
+logInit(void)
+{
+	logSequence = 0;
+	SEGGER_RTT_ConfigUpBuffer(kWarpLogRttChannel, "Log", logRttBuffer, sizeof(logRttBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	return;
+}
+
+/*
+ *	A record is written whole or not at all. The sequence number advances for
+ *	dropped records too, so the host can count them.
+ */
+void
+logDeferred(uint16_t formatId, uint8_t argCount, const uint32_t *args)
+{
+	uint8_t record[kWarpLogRecordHeaderBytes + kWarpLogMaxArgs * sizeof(uint32_t)];
+
+	record[0] = formatId & 0xFF;
+	record[1] = formatId >> 8;
+	record[2] = argCount;
+	record[3] = logSequence++;
+	memcpy(&record[kWarpLogRecordHeaderBytes], args, argCount * sizeof(uint32_t));
+
+	SEGGER_RTT_Write(kWarpLogRttChannel, record, kWarpLogRecordHeaderBytes + argCount * sizeof(uint32_t));
+	return;
+}
+
+#endif
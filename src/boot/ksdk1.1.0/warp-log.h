@@ -0,0 +1,59 @@
+/*
+ *	Diagnostic logging. WARP_LOG() takes a printf-style format string and up to
+ *	ten integer, character or pointer arguments.
+ *
+ *	By default it is SEGGER_RTT_printf() on RTT channel 0. With
+ *	WARP_BUILD_ENABLE_DEFERRED_LOG (the CMake option of the same name) nothing
+ *	is formatted on the device: each format string is placed in the
+ *	.warp_log_format section, which the linker script keeps in the ELF but does
+ *	not load into flash, and its offset in that section is the format ID. A call
+ *	writes one record to RTT up-buffer 3:
+ *
+ *		uint16_t formatId, uint8_t argCount, uint8_t sequence, uint32_t args[argCount]
+ *
+ *	(little endian). tools/scripts/warp-logDecode.py reads the format strings
+ *	back out of Warp.elf and expands the records. A %s argument is printed only
+ *	if it points at a constant string in the image.
+ *
+ *	btstack_config.h also includes this header, so it holds only macros and
+ *	prototypes, which may be repeated.
+ */
+
+#ifdef WARP_BUILD_ENABLE_DEFERRED_LOG
+
+#define WARP_LOG_STRINGIFY_(x)	#x
+#define WARP_LOG_STRINGIFY(x)	WARP_LOG_STRINGIFY_(x)
+
+/*
+ *	WARP_LOG_ARGS(a, b, ...) expands to ", (uint32_t)(uintptr_t)(a), (uint32_t)(uintptr_t)(b), ..."
+ */
+#define WARP_LOG_ARG(x)		, (uint32_t)(uintptr_t)(x)
+#define WARP_LOG_ARGS_0()
+#define WARP_LOG_ARGS_1(a)			WARP_LOG_ARG(a)
+#define WARP_LOG_ARGS_2(a, b)			WARP_LOG_ARG(a) WARP_LOG_ARGS_1(b)
+#define WARP_LOG_ARGS_3(a, b, c)		WARP_LOG_ARG(a) WARP_LOG_ARGS_2(b, c)
+#define WARP_LOG_ARGS_4(a, b, c, d)		WARP_LOG_ARG(a) WARP_LOG_ARGS_3(b, c, d)
+#define WARP_LOG_ARGS_5(a, b, c, d, e)		WARP_LOG_ARG(a) WARP_LOG_ARGS_4(b, c, d, e)
+#define WARP_LOG_ARGS_6(a, b, c, d, e, f)	WARP_LOG_ARG(a) WARP_LOG_ARGS_5(b, c, d, e, f)
+#define WARP_LOG_ARGS_7(a, b, c, d, e, f, g)	WARP_LOG_ARG(a) WARP_LOG_ARGS_6(b, c, d, e, f, g)
+#define WARP_LOG_ARGS_8(a, b, c, d, e, f, g, h)	WARP_LOG_ARG(a) WARP_LOG_ARGS_7(b, c, d, e, f, g, h)
+#define WARP_LOG_ARGS_9(a, b, c, d, e, f, g, h, i)	WARP_LOG_ARG(a) WARP_LOG_ARGS_8(b, c, d, e, f, g, h, i)
+#define WARP_LOG_ARGS_10(a, b, c, d, e, f, g, h, i, j)	WARP_LOG_ARG(a) WARP_LOG_ARGS_9(b, c, d, e, f, g, h, i, j)
+#define WARP_LOG_ARGS_SELECT(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, name, ...)	name
+#define WARP_LOG_ARGS(...)	WARP_LOG_ARGS_SELECT(_0, ## __VA_ARGS__, WARP_LOG_ARGS_10, WARP_LOG_ARGS_9, WARP_LOG_ARGS_8, WARP_LOG_ARGS_7, WARP_LOG_ARGS_6, WARP_LOG_ARGS_5, WARP_LOG_ARGS_4, WARP_LOG_ARGS_3, WARP_LOG_ARGS_2, WARP_LOG_ARGS_1, WARP_LOG_ARGS_0)(__VA_ARGS__)
+
+#define WARP_LOG(format, ...)										\
+	do												\
+	{												\
+		static const char warpLogFormat[] __attribute__((section(".warp_log_format"), used)) = format;	\
+		const uint32_t warpLogArgs[] = {0 WARP_LOG_ARGS(__VA_ARGS__)};				\
+		logDeferred((uint16_t)(uintptr_t)warpLogFormat, sizeof(warpLogArgs) / sizeof(warpLogArgs[0]) - 1, &warpLogArgs[1]);	\
+	} while (0)
+
+void logInit(void);
+
+void logDeferred(uint16_t formatId, uint8_t argCount, const uint32_t *args);
+
+#else
+#define WARP_LOG(format, ...)	SEGGER_RTT_printf(0, format, ## __VA_ARGS__)
+#endif
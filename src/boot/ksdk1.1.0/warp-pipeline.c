@@ -0,0 +1,306 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsl_spi_master_driver.h"
+
+#include "warp.h"
+#include "warp-fixedPoint.h"
+#include "warp-profile.h"
+#include "warp-pipeline.h"
+
+/*
+ *	The stages index their histories with masks and wrapping counters rather
+ *	than their sizes.
+ */
+WARP_STATIC_ASSERT((kWarpStageFirWindow & (kWarpStageFirWindow - 1)) == 0, "kWarpStageFirWindow must be a power of two");
+WARP_STATIC_ASSERT(kWarpStageFirWindow >= 2 * kWarpStageFirHalfTaps, "The FIR taps must fit in its window");
+WARP_STATIC_ASSERT(kWarpStageFirHalfTaps == 13, "stageFirProcess() is unrolled for 13 tap pairs");
+WARP_STATIC_ASSERT(kWarpStageFirWindow < 256, "WarpStageFirState.count is a uint8_t");
+WARP_STATIC_ASSERT((kWarpStageMinMaxHistory & (kWarpStageMinMaxHistory - 1)) == 0, "kWarpStageMinMaxHistory must be a power of two");
+WARP_STATIC_ASSERT(kWarpStageMinMaxHistory <= 256, "WarpStageMinMaxState.next is a uint8_t");
+
+/*
+ *	Half of the symmetric FIR, oldest tap first. Each is applied to a pair of
+ *	samples, so the sum of both halves sets the gain, in units of 2^-16.
+ */
+static const uint32_t firCoefficients[kWarpStageFirHalfTaps] = {17, 67, 174, 383, 731, 1232, 1874, 2615, 3391, 4119, 4715, 5107, 20861};
+
+void
+stageFirReset(WarpStageFirState *state)
+{
+	state->sum = 0;
+	state->next = 0;
+	state->count = 0;
+}
+
+/*
+ *	One tap pair, oldest and newest samples first. The products are at most 32
+ *	bits wide, and so is the sum of the first twelve pairs; the centre pair is
+ *	kept apart so that nothing needs 64-bit arithmetic.
+ */
+#define WARP_STAGE_FIR_TAP(i)	(firCoefficients[i] * (uint32_t)(window[(oldest + (i)) & (kWarpStageFirWindow - 1)] + window[(newest - (i)) & (kWarpStageFirWindow - 1)]))
+
+WARP_RAMFUNC uint8_t
+stageFirProcess(WarpStageFirState *state, const int32_t *input, int32_t *output, uint8_t count)
+{
+	uint16_t *window = state->window;
+	uint32_t sum = state->sum;
+	uint8_t next = state->next;
+	uint8_t filled = state->count;
+	uint8_t produced = 0;
+	uint8_t newest;
+	uint8_t oldest;
+	uint32_t outer;
+	uint32_t centre;
+
+	for (uint8_t n = 0; n < count; n++)
+	{
+		newest = next;
+		next = (next + 1) & (kWarpStageFirWindow - 1);
+		if (filled == kWarpStageFirWindow)
+		{
+			sum -= window[newest];
+		}
+		window[newest] = input[n];
+		sum += window[newest];
+		if (filled < kWarpStageFirWindow)
+		{
+			filled++;
+			if (filled < kWarpStageFirWindow)
+			{
+				continue;
+			}
+		}
+
+		oldest = newest - (2 * kWarpStageFirHalfTaps - 1);
+		outer = WARP_STAGE_FIR_TAP(0) + WARP_STAGE_FIR_TAP(1) + WARP_STAGE_FIR_TAP(2) + WARP_STAGE_FIR_TAP(3)
+			+ WARP_STAGE_FIR_TAP(4) + WARP_STAGE_FIR_TAP(5) + WARP_STAGE_FIR_TAP(6) + WARP_STAGE_FIR_TAP(7)
+			+ WARP_STAGE_FIR_TAP(8) + WARP_STAGE_FIR_TAP(9) + WARP_STAGE_FIR_TAP(10) + WARP_STAGE_FIR_TAP(11);
+		centre = WARP_STAGE_FIR_TAP(12);
+
+		// (outer + centre) >> 16 without the carry out of 32 bits; a power-of-two window makes the mean a shift
+		output[produced++] = (int16_t)((outer >> 16) + (centre >> 16) + (((outer & 0xFFFF) + (centre & 0xFFFF)) >> 16) - sum / kWarpStageFirWindow);
+	}
+
+	state->sum = sum;
+	state->next = next;
+	state->count = filled;
+	return produced;
+}
+
+void
+stageIirReset(WarpStageIirState *state)
+{
+	state->highPass = 0;
+	state->lowPass = 0;
+	state->primed = false;
+}
+
+uint8_t
+stageIirProcess(WarpStageIirState *state, const int32_t *input, int32_t *output, uint8_t count)
+{
+	int32_t x;
+
+	for (uint8_t n = 0; n < count; n++)
+	{
+		x = input[n];
+		if (!state->primed)
+		{
+			state->previousInput = x;
+			state->primed = true;
+		}
+
+		state->highPass += (x - state->previousInput) - (state->highPass >> kWarpStageIirHighPassShift);
+		state->previousInput = x;
+		state->lowPass += (state->highPass - state->lowPass) >> kWarpStageIirLowPassShift;
+
+		if (state->lowPass > INT16_MAX)
+		{
+			output[n] = INT16_MAX;
+		}
+		else if (state->lowPass < INT16_MIN)
+		{
+			output[n] = INT16_MIN;
+		}
+		else
+		{
+			output[n] = state->lowPass;
+		}
+	}
+	return count;
+}
+
+void
+stageMinMaxReset(WarpStageMinMaxState *state)
+{
+	state->range = 0;
+	state->next = 0;
+	state->count = 0;
+}
+
+/*
+ *	Every sample's range is over the history as it stood once that sample was
+ *	added. Within a block those windows share everything except the entries the
+ *	block overwrites, so the shared part is scanned once per block, and each
+ *	sample adds the block's samples so far and the older entries it still sees.
+ *	Entries are addressed by their offset from next, the oldest once the history
+ *	is full; offsets below empty have never been written. The range only changes
+ *	when an extreme enters or leaves the history, so its reciprocal is kept
+ *	across samples and blocks.
+ */
+WARP_RAMFUNC uint8_t
+stageMinMaxProcess(WarpStageMinMaxState *state, const int32_t *input, int32_t *output, uint8_t count)
+{
+	int16_t *history = state->history;
+	uint8_t next = state->next;
+	uint16_t empty = kWarpStageMinMaxHistory - state->count;
+	int16_t sharedMinimum = INT16_MAX;
+	int16_t sharedMaximum = INT16_MIN;
+	int16_t minimum;
+	int16_t maximum;
+	int16_t entry;
+	uint16_t range;
+	uint16_t reciprocalRange = state->range;
+	uint32_t reciprocal = state->reciprocal;
+
+	for (uint16_t offset = (count > empty) ? count : empty; offset < kWarpStageMinMaxHistory; offset++)
+	{
+		entry = history[(next + offset) & (kWarpStageMinMaxHistory - 1)];
+		if (entry > sharedMaximum)
+		{
+			sharedMaximum = entry;
+		}
+		if (entry < sharedMinimum)
+		{
+			sharedMinimum = entry;
+		}
+	}
+
+	for (uint8_t n = 0; n < count; n++)
+	{
+		entry = input[n];
+		history[(next + n) & (kWarpStageMinMaxHistory - 1)] = entry;
+		if (entry > sharedMaximum)
+		{
+			sharedMaximum = entry;
+		}
+		if (entry < sharedMinimum)
+		{
+			sharedMinimum = entry;
+		}
+
+		// The oldest entries, which later samples in this block overwrite
+		minimum = sharedMinimum;
+		maximum = sharedMaximum;
+		for (uint16_t offset = (n + 1 > empty) ? n + 1 : empty; offset < count; offset++)
+		{
+			entry = history[(next + offset) & (kWarpStageMinMaxHistory - 1)];
+			if (entry > maximum)
+			{
+				maximum = entry;
+			}
+			if (entry < minimum)
+			{
+				minimum = entry;
+			}
+		}
+
+		range = maximum - minimum;
+		if (range == 0) // Only the first sample, or a flat signal
+		{
+			output[n] = 0;
+			continue;
+		}
+		if (range != reciprocalRange)
+		{
+			reciprocalRange = range;
+			reciprocal = fixedPointReciprocal(range);
+		}
+		output[n] = fixedPointDivide((uint32_t)(input[n] - minimum) * kWarpPipelineNormalisedMaximum, range, reciprocal);
+	}
+
+	state->range = reciprocalRange;
+	state->reciprocal = reciprocal;
+	state->next = (next + count) & (kWarpStageMinMaxHistory - 1);
+	state->count = (count >= empty) ? kWarpStageMinMaxHistory : kWarpStageMinMaxHistory - empty + count;
+	return count;
+}
+
+void
+stagePeakReset(WarpStagePeakState *state)
+{
+	state->previous[0] = 0;
+	state->previous[1] = 0;
+	state->derivative = 0;
+	state->samplesSinceBeat = 0;
+}
+
+uint8_t
+stagePeakProcess(WarpStagePeakState *state, const int32_t *input, int32_t *output, uint8_t count)
+{
+	int16_t previous0 = state->previous[0];
+	int16_t previous1 = state->previous[1];
+	int16_t derivative = state->derivative;
+	uint16_t samplesSinceBeat = state->samplesSinceBeat;
+	int16_t previousDerivative;
+	int16_t sample;
+
+	for (uint8_t n = 0; n < count; n++)
+	{
+		// The derivative over the last two samples is centred on previous0
+		sample = input[n];
+		previousDerivative = derivative;
+		derivative = sample - previous1;
+
+		output[n] = (uint16_t)sample;
+		if ((previousDerivative < 0) & (derivative >= 0) & (previous0 < kWarpStagePeakBaseline))
+		{
+			output[n] |= (uint32_t)samplesSinceBeat << 16;
+			samplesSinceBeat = 0;
+		}
+		samplesSinceBeat++;
+
+		previous1 = previous0;
+		previous0 = sample;
+	}
+
+	state->previous[0] = previous0;
+	state->previous[1] = previous1;
+	state->derivative = derivative;
+	state->samplesSinceBeat = samplesSinceBeat;
+	return count;
+}
+
+void
+pipelineReset(WarpPipeline *pipeline)
+{
+	WARP_PIPELINE_RESET(WARP_PIPELINE_FILTER)(&pipeline->filter);
+	WARP_PIPELINE_RESET(WARP_PIPELINE_NORMALISER)(&pipeline->normaliser);
+	WARP_PIPELINE_RESET(WARP_PIPELINE_DETECTOR)(&pipeline->detector);
+}
+
+/*
+ *	Runs a block of count raw samples through the three stages in place.
+ *	Returns how many came out of the filter; samples then holds the detector's
+ *	output for each of those.
+ */
+uint8_t
+pipelineProcess(WarpPipeline *pipeline, int32_t *samples, uint8_t count)
+{
+	uint8_t filtered;
+
+	WARP_PROFILE_BEGIN(kWarpProfileProbeFir);
+	filtered = WARP_PIPELINE_PROCESS(WARP_PIPELINE_FILTER)(&pipeline->filter, samples, samples, count);
+	WARP_PROFILE_END_BLOCK(kWarpProfileProbeFir, count);
+	count = filtered;
+
+	WARP_PROFILE_BEGIN(kWarpProfileProbeNormalise);
+	count = WARP_PIPELINE_PROCESS(WARP_PIPELINE_NORMALISER)(&pipeline->normaliser, samples, samples, count);
+	WARP_PROFILE_END_BLOCK(kWarpProfileProbeNormalise, count);
+
+	WARP_PROFILE_BEGIN(kWarpProfileProbeBeat);
+	count = WARP_PIPELINE_PROCESS(WARP_PIPELINE_DETECTOR)(&pipeline->detector, samples, samples, count);
+	WARP_PROFILE_END_BLOCK(kWarpProfileProbeBeat, count);
+
+	return count;
+}
@@ -0,0 +1,136 @@
+/*
+ *	The signal-processing pipeline: a filter, a normaliser and a beat detector,
+ *	each a statically allocated stage object behind one interface:
+ *
+ *		void stage<Name>Reset(WarpStage<Name>State *state)
+ *		uint8_t stage<Name>Process(WarpStage<Name>State *state, const int32_t *input, int32_t *output, uint8_t count)
+ *
+ *	Process consumes a block of count samples and writes up to count outputs,
+ *	returning how many. output may be input: each output is written only after
+ *	its input has been read, and never ahead of it. Each stage keeps the history
+ *	it needs in its own state, sized by its own constants, and holds it in
+ *	locals across the block, so the per-call overhead is paid once per block.
+ *
+ *	Which stage fills each slot is fixed at compile time by the
+ *	WARP_PIPELINE_FILTER, WARP_PIPELINE_NORMALISER and WARP_PIPELINE_DETECTOR
+ *	names, so every call is direct. Another implementation with the same input
+ *	and output drops in by defining its state type and functions and naming it,
+ *	for example -DWARP_PIPELINE_FILTER=Iir. Unused stages are dropped by
+ *	--gc-sections.
+ */
+
+#ifndef WARP_PIPELINE_FILTER
+#define WARP_PIPELINE_FILTER		Fir	// Raw samples in, band-passed samples out, within int16_t
+#endif
+#ifndef WARP_PIPELINE_NORMALISER
+#define WARP_PIPELINE_NORMALISER	MinMax	// Band-passed samples in, 0 to kWarpPipelineNormalisedMaximum out
+#endif
+#ifndef WARP_PIPELINE_DETECTOR
+#define WARP_PIPELINE_DETECTOR		Peak	// Normalised samples in; out, the same samples with WARP_PIPELINE_BEAT_INTERVAL() set at each beat
+#endif
+
+#ifndef WARP_PIPELINE_BLOCK_SAMPLES
+#define WARP_PIPELINE_BLOCK_SAMPLES	8	// Most samples the DSP task passes to pipelineProcess() at once; a power of two
+#endif
+
+#define WARP_PIPELINE_PASTE(a, b, c)	a##b##c
+#define WARP_PIPELINE_STATE(name)	WARP_PIPELINE_PASTE(WarpStage, name, State)
+#define WARP_PIPELINE_RESET(name)	WARP_PIPELINE_PASTE(stage, name, Reset)
+#define WARP_PIPELINE_PROCESS(name)	WARP_PIPELINE_PASTE(stage, name, Process)
+
+/*
+ *	The detector's output packs two 16-bit fields: the normalised sample, and
+ *	the beat interval in samples at a beat or 0 elsewhere.
+ */
+#define WARP_PIPELINE_NORMALISED(output)	((output) & 0xFFFF)
+#define WARP_PIPELINE_BEAT_INTERVAL(output)	((uint32_t)(output) >> 16)
+
+typedef enum
+{
+	kWarpPipelineNormalisedMaximum = 50,
+
+	kWarpStageFirWindow = 32, // Samples held; a power of two
+	kWarpStageFirHalfTaps = 13, // The filter is symmetric, with twice this many taps; unrolled in stageFirProcess()
+
+	kWarpStageIirHighPassShift = 6, // DC blocker pole at 1 - 2^-6, a corner near 0.25 Hz at 100 Hz
+	kWarpStageIirLowPassShift = 2, // Smoothing by 2^-2, a corner near 4.6 Hz at 100 Hz
+
+	kWarpStageMinMaxHistory = 256, // Samples the range is taken over; a power of two, at most 256
+
+	kWarpStagePeakBaseline = 15, // A beat is a derivative minimum whose sample is below this
+} WarpPipelineConstants;
+
+/*
+ *	Symmetric FIR low-pass with the window mean subtracted, which together make
+ *	a band-pass. Outputs nothing until the window has filled.
+ */
+typedef struct
+{
+	uint16_t window[kWarpStageFirWindow];
+	uint32_t sum; // Of the samples in window, for the mean
+	uint8_t next; // Where the next sample goes
+	uint8_t count;
+} WarpStageFirState;
+
+/*
+ *	First-order DC blocker then first-order low-pass: cheaper and shorter to
+ *	settle than the FIR, with a softer roll-off.
+ */
+typedef struct
+{
+	int32_t previousInput;
+	int32_t highPass;
+	int32_t lowPass;
+	bool primed; // previousInput holds a sample, so the first one does not read as a step
+} WarpStageIirState;
+
+/*
+ *	Scales each sample by the range of the last kWarpStageMinMaxHistory.
+ */
+typedef struct
+{
+	int16_t history[kWarpStageMinMaxHistory];
+	uint32_t reciprocal; // fixedPointReciprocal(range), kept while the range holds
+	uint16_t range; // 0 until the first non-zero range
+	uint16_t count;
+	uint8_t next;
+} WarpStageMinMaxState;
+
+/*
+ *	Takes a beat where the derivative over two samples turns from falling to
+ *	rising near the bottom of the normalised range. Passes its input through,
+ *	with the beat interval packed above it.
+ */
+typedef struct
+{
+	int16_t previous[2]; // The last two inputs, newest first
+	int16_t derivative;
+	uint16_t samplesSinceBeat;
+} WarpStagePeakState;
+
+typedef struct
+{
+	WARP_PIPELINE_STATE(WARP_PIPELINE_FILTER) filter;
+	WARP_PIPELINE_STATE(WARP_PIPELINE_NORMALISER) normaliser;
+	WARP_PIPELINE_STATE(WARP_PIPELINE_DETECTOR) detector;
+} WarpPipeline;
+
+void stageFirReset(WarpStageFirState *state);
+
+uint8_t stageFirProcess(WarpStageFirState *state, const int32_t *input, int32_t *output, uint8_t count);
+
+void stageIirReset(WarpStageIirState *state);
+
+uint8_t stageIirProcess(WarpStageIirState *state, const int32_t *input, int32_t *output, uint8_t count);
+
+void stageMinMaxReset(WarpStageMinMaxState *state);
+
+uint8_t stageMinMaxProcess(WarpStageMinMaxState *state, const int32_t *input, int32_t *output, uint8_t count);
+
+void stagePeakReset(WarpStagePeakState *state);
+
+uint8_t stagePeakProcess(WarpStagePeakState *state, const int32_t *input, int32_t *output, uint8_t count);
+
+void pipelineReset(WarpPipeline *pipeline);
+
+uint8_t pipelineProcess(WarpPipeline *pipeline, int32_t *samples, uint8_t count);
@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "fsl_device_registers.h"
+
+#include "SEGGER_RTT.h"
+#include "warp-profile.h"
+
+#ifdef WARP_BUILD_ENABLE_PROFILING
+
+static WarpProfileRecord profileRecordBuffer;
+
+/*
+ *	RTT keeps one byte of the ring free, so this holds exactly one record. With
+ *	SEGGER_RTT_MODE_NO_BLOCK_SKIP a record is written whole or not at all.
+ */
+static char profileRttBuffer[sizeof(WarpProfileRecord) + 1];
+
+/*
+ *	Cycles taken by an empty BEGIN/END pair, subtracted from every measurement.
+ */
+static uint32_t profileOverheadCycles;
+
+static void
+clearAccumulators(void)
+{
+	memset(profileRecordBuffer.probes, 0, sizeof(profileRecordBuffer.probes));
+	for (uint8_t i = 0; i < kWarpProfileProbeCount; i++)
+	{
+		profileRecordBuffer.probes[i].minCycles = kWarpProfileSysTickMask;
+	}
+	return;
+}
+
+void
+profileInit(void)
+{
+	SysTick->LOAD = kWarpProfileSysTickMask;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk; // Core clock, no interrupt
+
+	profileRecordBuffer.magic = kWarpProfileRecordMagic;
+	profileRecordBuffer.version = kWarpProfileRecordVersion;
+	profileRecordBuffer.probeCount = kWarpProfileProbeCount;
+	profileRecordBuffer.histogramBins = kWarpProfileHistogramBins;
+	profileRecordBuffer.sequence = 0;
+
+	SEGGER_RTT_ConfigUpBuffer(kWarpProfileRttChannel, "Profile", profileRttBuffer, sizeof(profileRttBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+	uint32_t start = profileNow();
+	profileOverheadCycles = (start - profileNow()) & kWarpProfileSysTickMask;
+
+	clearAccumulators();
+	return;
+}
+
+uint32_t
+profileNow(void)
+{
+	return SysTick->VAL;
+}
+
+void
+profileRecord(WarpProfileProbe probe, uint32_t start, uint8_t samples)
+{
+	WarpProfileAccumulator *accumulator = &profileRecordBuffer.probes[probe];
+
+	// SysTick counts down
+	uint32_t cycles = (start - SysTick->VAL) & kWarpProfileSysTickMask;
+	cycles = (cycles > profileOverheadCycles) ? cycles - profileOverheadCycles : 0;
+
+	accumulator->count++;
+	accumulator->samples += samples;
+	accumulator->sumCycles += cycles;
+	if (cycles < accumulator->minCycles)
+	{
+		accumulator->minCycles = cycles;
+	}
+	if (cycles > accumulator->maxCycles)
+	{
+		accumulator->maxCycles = cycles;
+	}
+
+	// Two octaves per bin, starting at 2^7 cycles. The M0+ has no CLZ instruction.
+	uint8_t bin = 0;
+	cycles >>= 9;
+	while (cycles && (bin < kWarpProfileHistogramBins - 1))
+	{
+		cycles >>= 2;
+		bin++;
+	}
+	if (accumulator->histogram[bin] < 0xFFFF)
+	{
+		accumulator->histogram[bin]++;
+	}
+	return;
+}
+
+void
+profileDump(void)
+{
+	SEGGER_RTT_Write(kWarpProfileRttChannel, &profileRecordBuffer, sizeof(profileRecordBuffer));
+	profileRecordBuffer.sequence++; // Gaps in the sequence show records dropped by a full up-buffer
+	clearAccumulators();
+	return;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ *	Per-stage cycle profiling, built only with WARP_BUILD_ENABLE_PROFILING (the
+ *	CMake option of the same name, which applies to debug builds only). Without
+ *	it the probe macros expand to nothing and no RAM or RTT buffer is used.
+ *
+ *	Probes read the SysTick down-counter, which free-runs over 24 bits at the
+ *	48 MHz core clock, so a single probe can span up to 349 ms. Once a second
+ *	the accumulators are written to RTT up-buffer kWarpProfileRttChannel as one
+ *	WarpProfileRecord (little endian, no padding) and then cleared. Probes
+ *	around a block of samples end with WARP_PROFILE_END_BLOCK() and count its
+ *	samples, so the cycles per sample can be compared across block sizes; the
+ *	rest count one sample per call.
+ */
+
+typedef enum
+{
+	kWarpProfileProbeI2cBurst = 0, // readSampleBurst(): FIFO pointers and up to a queue of samples over I2C
+	kWarpProfileProbeFir, // The pipeline filter stage
+	kWarpProfileProbeNormalise, // The pipeline normaliser stage
+	kWarpProfileProbeBeat, // The pipeline beat detector stage
+	kWarpProfileProbeDisplay, // writeToDisplay(): SPI traffic to the SSD1331
+	kWarpProfileProbeCount,
+} WarpProfileProbe;
+
+typedef enum
+{
+	kWarpProfileRttChannel = 2,
+	kWarpProfileRecordMagic = 0xA5,
+	kWarpProfileRecordVersion = 2,
+	kWarpProfileHistogramBins = 8, // Bin n counts durations of 2^(2n+7) up to 2^(2n+9) cycles; the first and last bins are open ended
+	kWarpProfileSysTickMask = 0x00FFFFFF,
+} WarpProfileConstants;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t samples;
+	uint32_t minCycles;
+	uint32_t maxCycles;
+	uint32_t sumCycles; // The mean is sumCycles / count, computed on the host
+	uint16_t histogram[kWarpProfileHistogramBins];
+} WarpProfileAccumulator;
+
+typedef struct
+{
+	uint8_t magic;
+	uint8_t version;
+	uint8_t probeCount;
+	uint8_t histogramBins;
+	uint32_t sequence;
+	WarpProfileAccumulator probes[kWarpProfileProbeCount];
+} WarpProfileRecord;
+
+#ifdef WARP_BUILD_ENABLE_PROFILING
+#define WARP_PROFILE_BEGIN(probe)	uint32_t profileStart_##probe = profileNow()
+#define WARP_PROFILE_END(probe)		profileRecord(probe, profileStart_##probe, 1)
+#define WARP_PROFILE_END_BLOCK(probe, samples)	profileRecord(probe, profileStart_##probe, samples)
+
+void profileInit(void);
+
+uint32_t profileNow(void);
+
+void profileRecord(WarpProfileProbe probe, uint32_t start, uint8_t samples);
+
+void profileDump(void);
+#else
+#define WARP_PROFILE_BEGIN(probe)
+#define WARP_PROFILE_END(probe)
+#define WARP_PROFILE_END_BLOCK(probe, samples)
+#endif
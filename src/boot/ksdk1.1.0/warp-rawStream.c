@@ -0,0 +1,76 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SEGGER_RTT.h"
+#include "warp.h"
+#include "warp-rawStream.h"
+
+#ifdef WARP_BUILD_ENABLE_RAW_STREAM
+
+extern volatile uint32_t gWarpMAX30105LostSamples;
+
+static char rawStreamRttBuffer[kWarpRawStreamRttBufferSize];
+static WarpRawStreamFrameHeader rawStreamHeader;
+static uint32_t rawStreamReportedLostSamples;
+static bool rawStreamEnabled;
+
+void
+rawStreamInit(void)
+{
+	rawStreamHeader.sync[0] = kWarpRawStreamSync0;
+	rawStreamHeader.sync[1] = kWarpRawStreamSync1;
+	rawStreamHeader.sequence = 0;
+	rawStreamHeader.firstSample = 0;
+	rawStreamReportedLostSamples = gWarpMAX30105LostSamples;
+	rawStreamEnabled = true;
+
+	SEGGER_RTT_ConfigUpBuffer(kWarpRawStreamRttChannel, "RawSamples", rawStreamRttBuffer, sizeof(rawStreamRttBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	return;
+}
+
+/*
+ *	Stopping the stream stops the frame and sample counters too, so the host sees
+ *	no drops across a stop and start.
+ */
+void
+rawStreamEnable(bool enable)
+{
+	rawStreamEnabled = enable;
+	return;
+}
+
+/*
+ *	Only this function writes to the up-buffer, and the host only ever frees
+ *	space, so a frame that fits now still fits after the header is written.
+ */
+void
+rawStreamWriteBurst(const volatile uint8_t *samples, uint8_t sampleCount)
+{
+	if (!rawStreamEnabled)
+	{
+		return;
+	}
+
+	SEGGER_RTT_BUFFER_UP *ring = &_SEGGER_RTT.aUp[kWarpRawStreamRttChannel];
+	unsigned readOffset = ring->RdOff;
+	unsigned space = (readOffset > ring->WrOff) ? readOffset - ring->WrOff - 1 : ring->SizeOfBuffer - 1 - ring->WrOff + readOffset;
+	unsigned payloadBytes = sampleCount * kWarpMAX30105BytesPerSample;
+
+	if (space >= sizeof(rawStreamHeader) + payloadBytes)
+	{
+		uint32_t lost = gWarpMAX30105LostSamples - rawStreamReportedLostSamples;
+
+		rawStreamHeader.sampleCount = sampleCount;
+		rawStreamHeader.sensorLostSamples = (lost > 0xFF) ? 0xFF : lost;
+		rawStreamReportedLostSamples = gWarpMAX30105LostSamples;
+
+		SEGGER_RTT_WriteSkipNoLock(kWarpRawStreamRttChannel, &rawStreamHeader, sizeof(rawStreamHeader));
+		SEGGER_RTT_WriteSkipNoLock(kWarpRawStreamRttChannel, (const void *)samples, payloadBytes);
+	}
+
+	rawStreamHeader.sequence++;
+	rawStreamHeader.firstSample += sampleCount;
+	return;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ *	Raw sample streaming over RTT up-buffer 1, built only with
+ *	WARP_BUILD_ENABLE_RAW_STREAM. Each sensor FIFO burst becomes one frame: a
+ *	WarpRawStreamFrameHeader (little endian) followed by sampleCount raw FIFO
+ *	samples of kWarpMAX30105BytesPerSample bytes, copied straight from the I2C
+ *	receive buffer. A frame is written whole or not at all; the host sees dropped
+ *	frames as gaps in firstSample. tools/scripts/warp-rawCapture.py decodes the
+ *	stream.
+ */
+
+typedef enum
+{
+	kWarpRawStreamRttChannel = 1,
+	kWarpRawStreamRttBufferSize = 128, // Two full frames of kWarpTaskSampleQueueLength samples
+	kWarpRawStreamSync0 = 0xA5,
+	kWarpRawStreamSync1 = 0x5A,
+} WarpRawStreamConstants;
+
+typedef struct
+{
+	uint8_t sync[2];
+	uint16_t sequence; // Frame counter, including frames that were dropped
+	uint16_t firstSample; // Running index of the first sample in the frame
+	uint8_t sampleCount;
+	uint8_t sensorLostSamples; // Samples lost to sensor FIFO overflow since the previous frame, saturating
+} WarpRawStreamFrameHeader;
+
+void rawStreamInit(void);
+
+void rawStreamEnable(bool enable);
+
+void rawStreamWriteBurst(const volatile uint8_t *samples, uint8_t sampleCount);
@@ -0,0 +1,364 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "warp-sessionLog.h"
+#include "hal_flash_bank_kl03.h"
+
+#ifdef WARP_BUILD_ENABLE_SESSION_LOG
+
+extern uint8_t __storage_start__[]; // First storage sector, see MKL03Z32xxx4_flash.ld
+
+static hal_flash_bank_kl03_t flashBankContext;
+static const hal_flash_bank_t *flashBank;
+
+static uint8_t activeBank;
+static uint32_t activeEpoch;
+static uint8_t activeCount; // Record slots used in the active bank
+static uint8_t olderCount; // Record slots used in the other bank, 0 if it holds no log
+
+static WarpSessionLogRecord batch[kWarpSessionLogBatchRecords];
+static uint8_t batchCount;
+static bool flushRequested;
+static uint16_t dropped; // Records lost to a full batch since reset, saturating
+
+// Accumulators for the minute in progress
+static uint8_t session;
+static uint16_t minute;
+static uint8_t secondsInMinute;
+static uint8_t beatCount;
+static uint8_t minBpm;
+static uint8_t maxBpm;
+static uint16_t bpmSum;
+static uint8_t differenceCount;
+static uint32_t squaredDifferenceSum; // Beat interval differences in samples, squared
+static uint16_t previousInterval; // 0 when the next beat has no predecessor to compare with
+
+static uint32_t
+recordOffset(uint8_t slot)
+{
+	return kWarpSessionLogHeaderBytes + slot * kWarpSessionLogRecordBytes;
+}
+
+static bool
+readHeader(uint8_t bank, uint32_t *epoch)
+{
+	uint32_t header[2]; // Magic, epoch
+
+	flashBank->read(&flashBankContext, bank, 0, (uint8_t *)header, sizeof(header));
+	*epoch = header[1];
+	return header[0] == kWarpSessionLogMagic;
+}
+
+/*
+ *	Records are appended in order, so the used slots end at the first erased one.
+ *	A record torn by power loss still counts as used, since its slot can no
+ *	longer be programmed.
+ */
+static uint8_t
+countUsedSlots(uint8_t bank)
+{
+	uint32_t words[2];
+	uint8_t slot;
+
+	for (slot = 0; slot < kWarpSessionLogRecordsPerBank; slot++)
+	{
+		flashBank->read(&flashBankContext, bank, recordOffset(slot), (uint8_t *)words, sizeof(words));
+		if ((words[0] == 0xFFFFFFFF) & (words[1] == 0xFFFFFFFF))
+		{
+			break;
+		}
+	}
+	return slot;
+}
+
+/*
+ *	Erases a bank and writes its header. The magic number goes last, so a bank
+ *	whose header was interrupted is not taken for a valid one.
+ */
+static void
+startBank(uint8_t bank, uint32_t epoch)
+{
+	uint32_t magic = kWarpSessionLogMagic;
+
+	flashBank->erase(&flashBankContext, bank);
+	flashBank->write(&flashBankContext, bank, sizeof(magic), (uint8_t *)&epoch, sizeof(epoch));
+	flashBank->write(&flashBankContext, bank, 0, (uint8_t *)&magic, sizeof(magic));
+	return;
+}
+
+static void
+clearMinute(void)
+{
+	beatCount = 0;
+	bpmSum = 0;
+	differenceCount = 0;
+	squaredDifferenceSum = 0;
+	return;
+}
+
+static uint16_t
+squareRoot(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+	while (bit)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/*
+ *	Finds the newest bank and the end of the log in each bank. Starts a new log
+ *	if neither bank holds one; that erase happens here, before sampling starts.
+ */
+void
+sessionLogInit(void)
+{
+	uint32_t epochs[2];
+	bool valid[2];
+	WarpSessionLogRecord newest;
+
+	flashBank = hal_flash_bank_kl03_init_instance(&flashBankContext, kWarpSessionLogBankSize,
+		(uintptr_t)__storage_start__, (uintptr_t)__storage_start__ + kWarpSessionLogBankSize);
+
+	valid[0] = readHeader(0, &epochs[0]);
+	valid[1] = readHeader(1, &epochs[1]);
+	if (!valid[0] & !valid[1])
+	{
+		startBank(0, 0);
+		valid[0] = true;
+		epochs[0] = 0;
+	}
+
+	activeBank = (valid[1] & (!valid[0] | (epochs[1] > epochs[0]))) ? 1 : 0;
+	activeEpoch = epochs[activeBank];
+	activeCount = countUsedSlots(activeBank);
+	olderCount = valid[activeBank ^ 1] ? countUsedSlots(activeBank ^ 1) : 0;
+
+	// Continue the boot count from the newest record
+	session = 0;
+	if (sessionLogReadRecord(sessionLogGetRecordCount() - 1, &newest))
+	{
+		session = newest.session + 1;
+	}
+
+	batchCount = 0;
+	flushRequested = false;
+	dropped = 0;
+	minute = 0;
+	secondsInMinute = 0;
+	previousInterval = 0;
+	clearMinute();
+	return;
+}
+
+/*
+ *	Records one detected beat. bpm is in tenths of a beat per minute and
+ *	beatInterval in samples, as computed in the main loop.
+ */
+void
+sessionLogBeat(uint16_t bpm, uint16_t beatInterval)
+{
+	uint16_t wholeBpm = bpm / 10;
+	int16_t difference;
+
+	if ((wholeBpm < kWarpSessionLogMinimumBpm) | (wholeBpm > kWarpSessionLogMaximumBpm))
+	{
+		previousInterval = 0;
+		return;
+	}
+	if (beatCount == kWarpSessionLogMaximumBeats)
+	{
+		return;
+	}
+
+	if ((beatCount == 0) | (wholeBpm < minBpm))
+	{
+		minBpm = wholeBpm;
+	}
+	if ((beatCount == 0) | (wholeBpm > maxBpm))
+	{
+		maxBpm = wholeBpm;
+	}
+	bpmSum += wholeBpm;
+	beatCount++;
+
+	if (previousInterval)
+	{
+		difference = beatInterval - previousInterval;
+		squaredDifferenceSum += (int32_t)difference * difference;
+		differenceCount++;
+	}
+	previousInterval = beatInterval;
+	return;
+}
+
+/*
+ *	The next beat starts a new interval sequence, and whatever is batched is
+ *	written without waiting for the batch to fill.
+ */
+void
+sessionLogContactLost(void)
+{
+	previousInterval = 0;
+	flushRequested = (batchCount > 0);
+	return;
+}
+
+/*
+ *	Called once a second by the housekeeping timer. Closes the minute in progress
+ *	every kWarpSessionLogSecondsPerRecord calls; a minute without beats leaves no
+ *	record. The batch is only still full if sessionLogPoll() has not run for a
+ *	whole minute, and then the new record is counted as dropped.
+ */
+void
+sessionLogSecond(void)
+{
+	WarpSessionLogRecord *record;
+	uint32_t rmssd;
+
+	secondsInMinute++;
+	if (secondsInMinute < kWarpSessionLogSecondsPerRecord)
+	{
+		return;
+	}
+	secondsInMinute = 0;
+
+	if ((beatCount > 0) & (batchCount < kWarpSessionLogBatchRecords))
+	{
+		record = &batch[batchCount++];
+		record->minute = minute;
+		record->session = session;
+		record->beatCount = beatCount;
+		record->minBpm = minBpm;
+		record->meanBpm = bpmSum / beatCount;
+		record->maxBpm = maxBpm;
+
+		// Intervals are in 10 ms samples: scale the mean square by 10^2 for milliseconds
+		rmssd = differenceCount ? squareRoot(squaredDifferenceSum * 100 / differenceCount) : 0;
+		record->rmssd = (rmssd > 0xFF) ? 0xFF : rmssd;
+	}
+	else if ((beatCount > 0) & (dropped < 0xFFFF))
+	{
+		dropped++;
+	}
+	if (batchCount == kWarpSessionLogBatchRecords)
+	{
+		flushRequested = true;
+	}
+
+	minute++;
+	clearMinute();
+	return;
+}
+
+/*
+ *	Called from the lowest priority task, right after the sensor has been
+ *	drained, so the sensor FIFO absorbs the time the flash is busy. Does either
+ *	one bank erase or one batch of record programs per call.
+ */
+void
+sessionLogPoll(void)
+{
+	const uint8_t *bytes;
+	uint32_t offset;
+	uint8_t written;
+
+	if (!flushRequested)
+	{
+		return;
+	}
+
+	if (activeCount == kWarpSessionLogRecordsPerBank)
+	{
+		// The older bank is overwritten; the bank that just filled becomes the older one
+		activeBank ^= 1;
+		activeEpoch++;
+		startBank(activeBank, activeEpoch);
+		olderCount = activeCount;
+		activeCount = 0;
+		return;
+	}
+
+	written = 0;
+	while ((written < batchCount) & (activeCount < kWarpSessionLogRecordsPerBank))
+	{
+		bytes = (const uint8_t *)&batch[written];
+		offset = recordOffset(activeCount);
+
+		// The first longword, never all ones in a record, commits it
+		flashBank->write(&flashBankContext, activeBank, offset + 4, &bytes[4], 4);
+		flashBank->write(&flashBankContext, activeBank, offset, bytes, 4);
+		activeCount++;
+		written++;
+	}
+
+	batchCount -= written;
+	memmove(batch, &batch[written], batchCount * sizeof(batch[0]));
+	flushRequested = (batchCount > 0);
+	return;
+}
+
+/*
+ *	Number of records in flash, including any torn by power loss. Records still
+ *	batched in RAM are not counted.
+ */
+uint16_t
+sessionLogGetRecordCount(void)
+{
+	return olderCount + activeCount;
+}
+
+/*
+ *	Records dropped because the batch was full, since reset, saturating.
+ */
+uint16_t
+sessionLogGetDropped(void)
+{
+	return dropped;
+}
+
+/*
+ *	Reads a record from flash, index 0 being the oldest. A torn record reads with
+ *	its first four bytes erased, minute 0xFFFF and session 0xFF.
+ */
+bool
+sessionLogReadRecord(uint16_t index, WarpSessionLogRecord *record)
+{
+	uint8_t bank;
+
+	if (index < olderCount)
+	{
+		bank = activeBank ^ 1;
+	}
+	else if (index - olderCount < activeCount)
+	{
+		bank = activeBank;
+		index -= olderCount;
+	}
+	else
+	{
+		return false;
+	}
+
+	flashBank->read(&flashBankContext, bank, recordOffset(index), (uint8_t *)record, sizeof(*record));
+	return true;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ *	Append-only session log in flash, built only with
+ *	WARP_BUILD_ENABLE_SESSION_LOG. Every minute with at least one beat becomes
+ *	one WarpSessionLogRecord, so the summaries survive reset() and power loss.
+ *
+ *	The log lives in the two flash banks of hal_flash_bank_kl03, one P-Flash
+ *	sector each, reserved at the top of flash through __storage_size__ (see
+ *	CMakeLists.txt). Records are appended to the active bank behind an 8-byte
+ *	bank header holding a magic number and an epoch. When it fills, the other
+ *	bank is erased and becomes the active one with the next epoch, so each sector
+ *	is erased once per two banks' worth of records and the log always keeps at
+ *	least one full bank of history.
+ *
+ *	Records are collected kWarpSessionLogBatchRecords at a time in RAM and
+ *	programmed together, or sooner when the finger is removed. Flash operations
+ *	only run from sessionLogPoll(), at most one batch or one erase per call. A
+ *	minute that closes while the batch is still full is dropped and counted.
+ *	Recorded records are read back over the RTT command interface
+ *	(tools/scripts/warp-command.py log).
+ */
+
+typedef enum
+{
+	kWarpSessionLogBankSize = 1024, // One P-Flash sector; __storage_size__ must be twice this
+	kWarpSessionLogHeaderBytes = 8,
+	kWarpSessionLogRecordBytes = 8,
+	kWarpSessionLogRecordsPerBank = (kWarpSessionLogBankSize - kWarpSessionLogHeaderBytes) / kWarpSessionLogRecordBytes,
+	kWarpSessionLogBatchRecords = 4,
+	kWarpSessionLogSecondsPerRecord = 60,
+	kWarpSessionLogMaximumBeats = 254, // Keeps the first longword of a written record from reading as erased
+	kWarpSessionLogMinimumBpm = 20, // Whole beats per minute, as for the BPM trend
+	kWarpSessionLogMaximumBpm = 250,
+	kWarpSessionLogMagic = 0x4C535357, // "WSSL" in flash
+} WarpSessionLogConstants;
+
+typedef struct
+{
+	uint16_t minute; // Minutes since boot
+	uint8_t session; // Boot count, modulo 256
+	uint8_t beatCount; // Beats detected during the minute, saturating at kWarpSessionLogMaximumBeats
+	uint8_t minBpm; // Whole beats per minute
+	uint8_t meanBpm;
+	uint8_t maxBpm;
+	uint8_t rmssd; // Root mean square of successive beat interval differences, in milliseconds, saturating
+} WarpSessionLogRecord;
+
+void sessionLogInit(void);
+
+void sessionLogBeat(uint16_t bpm, uint16_t beatInterval);
+
+void sessionLogContactLost(void);
+
+void sessionLogSecond(void);
+
+void sessionLogPoll(void);
+
+uint16_t sessionLogGetRecordCount(void);
+
+uint16_t sessionLogGetDropped(void);
+
+bool sessionLogReadRecord(uint16_t index, WarpSessionLogRecord *record);
@@ -0,0 +1,30 @@
+#include <stdint.h>
+
+#include "warp-stack.h"
+
+extern uint32_t __HeapLimit[]; // Painting starts here, see MKL03Z32xxx4_flash.ld
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+
+/*
+ *	Bytes between the top of the stack and the deepest word written since reset.
+ *	Exceeds stackGetReserve() if the stack has overflowed its reserve, and reads
+ *	the whole painted area once the stack has reached .bss.
+ */
+uint16_t
+stackGetHighWater(void)
+{
+	const uint32_t *word = __HeapLimit;
+
+	while ((word < __StackTop) && (*word == kWarpStackPaintPattern))
+	{
+		word++;
+	}
+	return (uintptr_t)__StackTop - (uintptr_t)word;
+}
+
+uint16_t
+stackGetReserve(void)
+{
+	return (uintptr_t)__StackTop - (uintptr_t)__StackLimit;
+}
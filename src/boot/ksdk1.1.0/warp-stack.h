@@ -0,0 +1,29 @@
+/*
+ *	Stack high-water mark. Before main() runs, Reset_Handler fills the SRAM
+ *	between the end of the heap (__HeapLimit) and the stack pointer with
+ *	kWarpStackPaintPattern. The deepest the stack has reached since reset is
+ *	then the lowest word that no longer holds the pattern. Painting starts below
+ *	the stack reserve (__stack_size__, WARP_STACK_SIZE in CMakeLists.txt), so a
+ *	stack that outgrew its reserve into the unallocated gap still reads its true
+ *	depth.
+ *
+ *	The static side of the SRAM budget comes from the map file, see
+ *	tools/scripts/warp-ramReport.py. The high-water mark is logged on each
+ *	reset() and read over RTT with tools/scripts/warp-command.py stack.
+ */
+
+typedef enum
+{
+	kWarpStackPaintPattern = 0x4B435453, // "STCK" in memory; must match Reset_Handler in startup_MKL03Z4.S
+
+	/*
+	 *	Stack left to the run loop, the tasks and an exception frame once
+	 *	main() has placed the WarpPipeline on it. Revise against
+	 *	stackGetHighWater() when the call chains grow.
+	 */
+	kWarpStackMinimumHeadroomBytes = 128,
+} WarpStackConstants;
+
+uint16_t stackGetHighWater(void);
+
+uint16_t stackGetReserve(void);
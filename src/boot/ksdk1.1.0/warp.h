@@ -20,6 +20,25 @@ typedef struct
 	uint8_t i2cBuffer[192]; // Maximum number of bytes in MAX30105's FIFO for 2 channels
 } WarpI2CDeviceState;
 
+typedef enum
+{
+	kWarpMAX30105FifoDepth = 32,
+	kWarpMAX30105BytesPerSample = 6, // 3 bytes per LED, red then IR, most significant byte first
+} WarpMAX30105FifoConstants;
+
+/*
+ *	Acquisition presets selectable at runtime, see configureProfileMAX30105().
+ *	Every profile delivers samples to the FIFO at 100 Hz, the rate the beat
+ *	detector assumes.
+ */
+typedef enum
+{
+	kWarpMAX30105ProfileDefault = 0, // 400 Hz averaged over 4, 215 us pulses, IR 12.5 mA
+	kWarpMAX30105ProfileLowPower, // 100 Hz without averaging, 118 us pulses, IR 6.2 mA
+	kWarpMAX30105ProfileCount,
+	kWarpMAX30105ShadowRegisterCount = 12,
+} WarpMAX30105ProfileConstants;
+
 typedef enum
 {
 	INTERRUPT_STATUS_1 = 0x00,
@@ -27,6 +46,7 @@ typedef enum
 	INTERRUPT_ENABLE_1 = 0x02,
 	INTERRUPT_ENABLE_2 = 0x03,
 	FIFO_WRITE = 0x04,
+	OVERFLOW_COUNTER = 0x05,
 	FIFO_READ = 0x06,
 	FIFO_DATA = 0x07, // Read from this register
 	FIFO_CONFIG = 0x08,
@@ -41,9 +61,31 @@ typedef enum
 	TEMP_FRAC = 0x20,
 	TEMP_CONFIG = 0x21,
 	PROXIMITY_THRESHOLD = 0x30,
+	REVISION_ID = 0xFE,
+	PART_ID = 0xFF,
 } MAX30105Register;
 
 void enableI2Cpins(uint16_t pullupValue);
 void disableI2Cpins(void);
 void enableSPIpins(void);
 void disableSPIpins(void);
+
+/*
+ *	Places a function in SRAM (the .ramfunc section of MKL03Z32xxx4_flash.ld,
+ *	copied from flash by Reset_Handler), where it runs without flash wait
+ *	states. Its code comes out of the 2 KB of SRAM, so reserve this for the
+ *	per-sample DSP loops; tools/scripts/warp-ramfuncReport.py reports the cost.
+ *	The calls are long calls, since SRAM is out of reach of a BL from flash.
+ *	Without WARP_BUILD_ENABLE_RAMFUNC the functions stay in flash.
+ */
+#ifdef WARP_BUILD_ENABLE_RAMFUNC
+#define WARP_RAMFUNC	__attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define WARP_RAMFUNC
+#endif
+
+/*
+ *	Fails the build when a buffer and the code that indexes it, or a structure
+ *	and the host tool that parses it, disagree on a size.
+ */
+#define WARP_STATIC_ASSERT(condition, message)	_Static_assert(condition, message)
@@ -77,6 +77,10 @@
 #define TIMER_SUPPORT
 #endif
 
+#if defined(HAVE_EMBEDDED_TICKLESS) && !defined(TIMER_SUPPORT)
+#error "HAVE_EMBEDDED_TICKLESS requires HAVE_EMBEDDED_TICK or HAVE_EMBEDDED_TIME_MS"
+#endif
+
 static const btstack_run_loop_t btstack_run_loop_embedded;
 
 // the run loop
@@ -209,6 +213,12 @@ static void btstack_run_loop_embedded_disable_data_source_callbacks(btstack_data
 void btstack_run_loop_embedded_execute_once(void) {
     btstack_data_source_t *ds;
 
+#if defined(HAVE_EMBEDDED_TICKLESS) && defined(HAVE_EMBEDDED_TICK)
+    // account for the ticks that passed while asleep, before anything sets a timer.
+    // the tick handler is not used, as it would trigger another iteration instead of sleeping
+    system_ticks += hal_tick_sync();
+#endif
+
     // process data sources
     btstack_data_source_t *next;
     for (ds = (btstack_data_source_t *) data_sources; ds != NULL ; ds = next){
@@ -244,6 +254,23 @@ void btstack_run_loop_embedded_execute_once(void) {
         trigger_event_received = 0;
         hal_cpu_enable_irqs();
     } else {
+#ifdef HAVE_EMBEDDED_TICKLESS
+        // only wake for the first pending timer, instead of on every tick
+        uint32_t time_to_deadline = 0;
+        if (timers){
+#ifdef HAVE_EMBEDDED_TICK
+            int32_t delta = ((btstack_timer_source_t *) timers)->timeout - system_ticks;
+#else
+            int32_t delta = ((btstack_timer_source_t *) timers)->timeout - hal_time_ms();
+#endif
+            time_to_deadline = (delta > 0) ? (uint32_t) delta : 1;
+        }
+#ifdef HAVE_EMBEDDED_TICK
+        hal_tick_set_next_deadline(time_to_deadline);
+#else
+        hal_time_ms_set_next_deadline(time_to_deadline);
+#endif
+#endif
         hal_cpu_enable_irqs_and_sleep();
     }
 }
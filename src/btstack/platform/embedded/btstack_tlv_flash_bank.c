@@ -56,6 +56,18 @@
 #define BTSTACK_FLASH_ALIGNMENT_MAX 8
 #endif
 
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+#ifndef TLV_FLASH_BANK_COMPACTION_ENTRIES_PER_STEP
+#define TLV_FLASH_BANK_COMPACTION_ENTRIES_PER_STEP 1
+#endif
+
+enum {
+	TLV_FLASH_BANK_COMPACTION_IDLE = 0,
+	TLV_FLASH_BANK_COMPACTION_ERASE,
+	TLV_FLASH_BANK_COMPACTION_COPY,
+};
+#endif
+
 static const char * btstack_tlv_header_magic = "BTstack";
 
 // TLV Iterator
@@ -209,6 +221,64 @@ static void btstack_tlv_flash_bank_erase_bank(btstack_tlv_flash_bank_t * self, i
 	}
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+
+// RAM index: tag -> offset of its live entry in the current bank
+// - rebuilt on init and migration, kept up to date on store and delete
+// - if the live tags do not all fit, lookups of tags missing from the index fall back to scanning the bank
+
+static void btstack_tlv_flash_bank_index_reset(btstack_tlv_flash_bank_t * self){
+	self->index_count = 0;
+	self->index_complete = 1;
+}
+
+static int btstack_tlv_flash_bank_index_find(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	int i;
+	for (i=0;i<self->index_count;i++){
+		if (self->index[i].tag == tag) return i;
+	}
+	return -1;
+}
+
+static void btstack_tlv_flash_bank_index_update(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+	int i = btstack_tlv_flash_bank_index_find(self, tag);
+	if (i < 0){
+		if (self->index_count == MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES){
+			log_info("index full, tag '%x' not indexed", tag);
+			self->index_complete = 0;
+			return;
+		}
+		i = self->index_count++;
+		self->index[i].tag = tag;
+	}
+	self->index[i].offset = offset;
+}
+
+static void btstack_tlv_flash_bank_index_remove(btstack_tlv_flash_bank_t * self, int i){
+	self->index_count--;
+	self->index[i] = self->index[self->index_count];
+}
+
+#endif
+
+// copy entry to bank at offset, @returns offset after the copy
+static uint32_t btstack_tlv_flash_bank_copy_entry(btstack_tlv_flash_bank_t * self, tlv_iterator_t * it, int bank, uint32_t offset){
+	uint32_t tag_index = it->offset;
+	uint32_t next_write_pos = offset;
+	int bytes_to_copy = 8 + it->len;
+	log_info("migrate pos %u, tag '%x' len %u -> new pos %u", tag_index, it->tag, bytes_to_copy, offset);
+	uint8_t copy_buffer[32];
+	while (bytes_to_copy){
+		int bytes_this_iteration = btstack_min(bytes_to_copy, sizeof(copy_buffer));
+		btstack_tlv_flash_bank_read(self, it->bank, tag_index, copy_buffer, bytes_this_iteration);
+		btstack_tlv_flash_bank_write(self, bank, next_write_pos, copy_buffer, bytes_this_iteration);
+		tag_index      += bytes_this_iteration;
+		next_write_pos += bytes_this_iteration;
+		bytes_to_copy  -= bytes_this_iteration;
+	}
+	return offset + 8 + btstack_tlv_flash_bank_align_size(self, it->len);
+}
+
 static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 
 	int next_bank = 1 - self->current_bank;
@@ -217,26 +287,19 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	btstack_tlv_flash_bank_erase_bank(self, next_bank);
 	int next_write_pos = 8;
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_reset(self);
+#endif
+
 	tlv_iterator_t it;
 	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
 	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
 		// skip deleted entries
 		if (it.tag) {
-			uint32_t tag_len = it.len;
-			uint32_t tag_index = it.offset;
-
-			// copy
-			int bytes_to_copy = 8 + tag_len;
-			log_info("migrate pos %u, tag '%x' len %u -> new pos %u", tag_index, it.tag, bytes_to_copy, next_write_pos);
-			uint8_t copy_buffer[32];
-			while (bytes_to_copy){
-				int bytes_this_iteration = btstack_min(bytes_to_copy, sizeof(copy_buffer));
-				btstack_tlv_flash_bank_read(self, self->current_bank, tag_index, copy_buffer, bytes_this_iteration);
-				btstack_tlv_flash_bank_write(self, next_bank, next_write_pos, copy_buffer, bytes_this_iteration);
-				tag_index      += bytes_this_iteration;
-				next_write_pos += bytes_this_iteration;
-				bytes_to_copy  -= bytes_this_iteration;
-			}
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+			btstack_tlv_flash_bank_index_update(self, it.tag, next_write_pos);
+#endif
+			next_write_pos = btstack_tlv_flash_bank_copy_entry(self, &it, next_bank, next_write_pos);
 		}
 		tlv_iterator_fetch_next(self, &it);
 	}
@@ -249,20 +312,175 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	self->write_offset = next_write_pos;
 }
 
-static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, int bank, uint32_t tag, uint32_t offset){
 	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	btstack_tlv_flash_bank_iterator_init(self, &it, bank);
 	while (btstack_tlv_flash_bank_iterator_has_next(self, &it) && it.offset < offset){
 		if (it.tag == tag){
 			log_info("Erase tag '%x' at position %u", tag, it.offset);
 			// overwrite tag with invalid tag
 			uint32_t zero_tag = 0;
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset, (uint8_t*) &zero_tag, sizeof(zero_tag));
+			btstack_tlv_flash_bank_write(self, bank, it.offset, (uint8_t*) &zero_tag, sizeof(zero_tag));
 		}
 		tlv_iterator_fetch_next(self, &it);
 	}
 }
 
+// delete the live entry of a tag before offset, without scanning if the index knows where it is
+static void btstack_tlv_flash_bank_delete_live_tag(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	int index = btstack_tlv_flash_bank_index_find(self, tag);
+	if (index >= 0){
+		log_info("Erase tag '%x' at position %u", tag, self->index[index].offset);
+		uint32_t zero_tag = 0;
+		btstack_tlv_flash_bank_write(self, self->current_bank, self->index[index].offset, (uint8_t*) &zero_tag, sizeof(zero_tag));
+		btstack_tlv_flash_bank_index_remove(self, index);
+		return;
+	}
+	if (self->index_complete) return;
+#endif
+	btstack_tlv_flash_bank_delete_tag_until_offset(self, self->current_bank, tag, offset);
+}
+
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+
+// Incremental compaction: copies the live entries of the current bank to the other bank
+// a few at a time from a run loop timer, instead of all at once in the store that finds the bank full.
+// - it starts when write_offset passes compaction_threshold, leaving a reserve for stores made meanwhile
+// - reads, stores and deletes keep using the current bank, so a reset during compaction loses nothing
+// - the copy follows the stores appended meanwhile; a store or delete of a tag that has already been copied
+//   also deletes the copy, so the other bank always mirrors the current bank up to the copy position
+// - the header of the other bank is written last, which makes it the current bank
+
+static void btstack_tlv_flash_bank_compaction_set_threshold(btstack_tlv_flash_bank_t * self){
+	uint32_t size = self->hal_flash_bank_impl->get_size(self->hal_flash_bank_context);
+#ifdef TLV_FLASH_BANK_COMPACTION_RESERVE
+	uint32_t reserve = TLV_FLASH_BANK_COMPACTION_RESERVE;
+#else
+	uint32_t reserve = size / 4;
+#endif
+	// don't compact again before a few stores if a compaction did not free up the reserve
+	self->compaction_threshold = btstack_max(size - reserve, self->write_offset + reserve / 2);
+}
+
+static void btstack_tlv_flash_bank_compaction_schedule(btstack_tlv_flash_bank_t * self){
+	btstack_run_loop_remove_timer(&self->compaction_timer);
+	btstack_run_loop_set_timer(&self->compaction_timer, 0);
+	btstack_run_loop_add_timer(&self->compaction_timer);
+}
+
+static void btstack_tlv_flash_bank_compaction_start(btstack_tlv_flash_bank_t * self){
+	log_info("start compaction bank %u -> bank %u", self->current_bank, 1 - self->current_bank);
+	self->compaction_state        = TLV_FLASH_BANK_COMPACTION_ERASE;
+	self->compaction_read_offset  = BTSTACK_TLV_HEADER_LEN;
+	self->compaction_write_offset = BTSTACK_TLV_HEADER_LEN;
+	btstack_tlv_flash_bank_compaction_schedule(self);
+}
+
+static void btstack_tlv_flash_bank_compaction_complete(btstack_tlv_flash_bank_t * self){
+	int next_bank = 1 - self->current_bank;
+	uint8_t epoch_buffer;
+	btstack_tlv_flash_bank_read(self, self->current_bank, BTSTACK_TLV_HEADER_LEN-1, &epoch_buffer, 1);
+	btstack_tlv_flash_bank_write_header(self, next_bank, (epoch_buffer + 1) & 3);
+	self->current_bank = next_bank;
+	self->write_offset = self->compaction_write_offset;
+	self->compaction_state = TLV_FLASH_BANK_COMPACTION_IDLE;
+	btstack_tlv_flash_bank_compaction_set_threshold(self);
+	log_info("compaction complete, write offset %u", self->write_offset);
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_reset(self);
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		if (it.tag){
+			btstack_tlv_flash_bank_index_update(self, it.tag, it.offset);
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+#endif
+}
+
+// erase the other bank or copy up to TLV_FLASH_BANK_COMPACTION_ENTRIES_PER_STEP entries
+// @returns 1 if compaction is complete
+static int btstack_tlv_flash_bank_compaction_step(btstack_tlv_flash_bank_t * self){
+	int next_bank = 1 - self->current_bank;
+	int entries_copied = 0;
+	tlv_iterator_t it;
+	switch (self->compaction_state){
+		case TLV_FLASH_BANK_COMPACTION_ERASE:
+			btstack_tlv_flash_bank_erase_bank(self, next_bank);
+			self->compaction_state = TLV_FLASH_BANK_COMPACTION_COPY;
+			return 0;
+		case TLV_FLASH_BANK_COMPACTION_COPY:
+			while (entries_copied < TLV_FLASH_BANK_COMPACTION_ENTRIES_PER_STEP){
+				if (self->compaction_read_offset >= (uint32_t) self->write_offset){
+					btstack_tlv_flash_bank_compaction_complete(self);
+					return 1;
+				}
+				it.bank   = self->current_bank;
+				it.offset = self->compaction_read_offset;
+				btstack_tlv_flash_bank_iterator_fetch_tag_len(self, &it);
+				// skip deleted entries
+				if (it.tag){
+					self->compaction_write_offset = btstack_tlv_flash_bank_copy_entry(self, &it, next_bank, self->compaction_write_offset);
+					entries_copied++;
+				}
+				self->compaction_read_offset += 8 + btstack_tlv_flash_bank_align_size(self, it.len);
+			}
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+static void btstack_tlv_flash_bank_compaction_handler(btstack_timer_source_t * ts){
+	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) btstack_run_loop_get_timer_context(ts);
+	if (btstack_tlv_flash_bank_compaction_step(self)) return;
+	btstack_tlv_flash_bank_compaction_schedule(self);
+}
+
+// run a pending compaction to completion
+static void btstack_tlv_flash_bank_compaction_finish(btstack_tlv_flash_bank_t * self){
+	if (self->compaction_state == TLV_FLASH_BANK_COMPACTION_IDLE) return;
+	btstack_run_loop_remove_timer(&self->compaction_timer);
+	while (!btstack_tlv_flash_bank_compaction_step(self));
+}
+
+// a tag stored or deleted in the current bank must not survive in the copy
+static void btstack_tlv_flash_bank_compaction_delete_copied_tag(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	if (self->compaction_state != TLV_FLASH_BANK_COMPACTION_COPY) return;
+	btstack_tlv_flash_bank_delete_tag_until_offset(self, 1 - self->current_bank, tag, self->compaction_write_offset);
+}
+
+#endif
+
+// @returns offset of the live entry of a tag in the current bank, or 0 if none
+static uint32_t btstack_tlv_flash_bank_find_tag(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t * tag_len){
+	tlv_iterator_t it;
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	int index = btstack_tlv_flash_bank_index_find(self, tag);
+	if (index >= 0){
+		it.bank   = self->current_bank;
+		it.offset = self->index[index].offset;
+		btstack_tlv_flash_bank_iterator_fetch_tag_len(self, &it);
+		*tag_len = it.len;
+		return it.offset;
+	}
+	if (self->index_complete) return 0;
+#endif
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		if (it.tag == tag){
+			log_info("Found tag '%x' at position %u", tag, it.offset);
+			*tag_len = it.len;
+			return it.offset;
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+	return 0;
+}
+
 /**
  * Get Value for Tag
  * @param tag
@@ -274,19 +492,8 @@ static int btstack_tlv_flash_bank_get_tag(void * context, uint32_t tag, uint8_t
 
 	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
 
-	uint32_t tag_index = 0;
 	uint32_t tag_len   = 0;
-	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
-	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
-		if (it.tag == tag){
-			log_info("Found tag '%x' at position %u", tag, it.offset);
-			tag_index = it.offset;
-			tag_len   = it.len;
-			break;
-		}
-		tlv_iterator_fetch_next(self, &it);
-	}
+	uint32_t tag_index = btstack_tlv_flash_bank_find_tag(self, tag, &tag_len);
 	if (tag_index == 0) return 0;
 	if (!buffer) return tag_len;
 	int copy_size = btstack_min(buffer_size, tag_len);
@@ -304,9 +511,19 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 
 	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
 
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	// complete a running compaction first, it frees the space of deleted entries
+	if (self->write_offset + 8 + data_size > self->hal_flash_bank_impl->get_size(self->hal_flash_bank_context)){
+		btstack_tlv_flash_bank_compaction_finish(self);
+	}
+#endif
+
 	// trigger migration if not enough space
 	if (self->write_offset + 8 + data_size > self->hal_flash_bank_impl->get_size(self->hal_flash_bank_context)){
 		btstack_tlv_flash_bank_migrate(self);
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+		btstack_tlv_flash_bank_compaction_set_threshold(self);
+#endif
 	}
 
 	if (self->write_offset + 8 + data_size > self->hal_flash_bank_impl->get_size(self->hal_flash_bank_context)){
@@ -328,11 +545,25 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 	btstack_tlv_flash_bank_write(self, self->current_bank, self->write_offset, entry, sizeof(entry));
 
 	// overwrite old entries (if exists)
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	btstack_tlv_flash_bank_delete_live_tag(self, tag, self->write_offset);
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_update(self, tag, self->write_offset);
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	btstack_tlv_flash_bank_compaction_delete_copied_tag(self, tag);
+#endif
 
 	// done
 	self->write_offset += sizeof(entry) + btstack_tlv_flash_bank_align_size(self, data_size);
 
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	if ((self->compaction_state == TLV_FLASH_BANK_COMPACTION_IDLE) && ((uint32_t) self->write_offset > self->compaction_threshold)){
+		btstack_tlv_flash_bank_compaction_start(self);
+	}
+#endif
+
 	return 0;
 }
 
@@ -342,7 +573,10 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
  */
 static void btstack_tlv_flash_bank_delete_tag(void * context, uint32_t tag){
 	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	btstack_tlv_flash_bank_delete_live_tag(self, tag, self->write_offset);
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	btstack_tlv_flash_bank_compaction_delete_copied_tag(self, tag);
+#endif
 }
 
 static const btstack_tlv_t btstack_tlv_flash_bank = {
@@ -359,6 +593,17 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 	self->hal_flash_bank_impl    = hal_flash_bank_impl;
 	self->hal_flash_bank_context = hal_flash_bank_context;
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_reset(self);
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	// a compaction interrupted by reset is started over, the other bank has no valid header yet
+	self->compaction_state = TLV_FLASH_BANK_COMPACTION_IDLE;
+	btstack_run_loop_set_timer_handler(&self->compaction_timer, &btstack_tlv_flash_bank_compaction_handler);
+	btstack_run_loop_set_timer_context(&self->compaction_timer, self);
+#endif
+
 	// try to find current bank
 	self->current_bank = btstack_tlv_flash_bank_get_latest_bank(self);
 	log_info("found bank %d", self->current_bank);
@@ -372,6 +617,12 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 		while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
 			last_tag = it.tag;
 			last_offset = it.offset;
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+			// later entries of a tag supersede earlier ones
+			if (it.tag){
+				btstack_tlv_flash_bank_index_update(self, it.tag, it.offset);
+			}
+#endif
 			tlv_iterator_fetch_next(self, &it);
 		}
 		self->write_offset = it.offset;
@@ -381,7 +632,7 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 			// delete older instances of last_tag
 			// this handles the unlikely case where MCU did reset after new value + header was written but before delete did complete
 			if (last_tag){
-				btstack_tlv_flash_bank_delete_tag_until_offset(self, last_tag, last_offset);
+				btstack_tlv_flash_bank_delete_tag_until_offset(self, self->current_bank, last_tag, last_offset);
 			}
 
 			// verify that rest of bank is empty
@@ -399,12 +650,19 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 	} 
 
 	if (self->current_bank < 0) {
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+		btstack_tlv_flash_bank_index_reset(self);
+#endif
 		btstack_tlv_flash_bank_erase_bank(self, 0);
 		self->current_bank = 0;
 		btstack_tlv_flash_bank_write_header(self, self->current_bank, 0);	// epoch = 0;
 		self->write_offset = 8;
 	}
 
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	btstack_tlv_flash_bank_compaction_set_threshold(self);
+#endif
+
 	log_info("write offset %u", self->write_offset);
 	return &btstack_tlv_flash_bank;
 }
@@ -40,18 +40,45 @@
 #define __BTSTACK_TLV_FLASH_BANK_H
 
 #include <stdint.h>
+#include "btstack_config.h"
 #include "btstack_tlv.h"
 #include "hal_flash_bank.h"
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+#include "btstack_run_loop.h"
+#endif
 
 #if defined __cplusplus
 extern "C" {
 #endif
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+#ifndef MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES
+#define MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES 16
+#endif
+
+typedef struct {
+	uint32_t tag;
+	uint32_t offset;	// of the live entry in the current bank
+} btstack_tlv_flash_bank_index_entry_t;
+#endif
+
 typedef struct {
 	const hal_flash_bank_t * hal_flash_bank_impl;
 	void * hal_flash_bank_context;
 	int current_bank;
 	int write_offset;
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_entry_t index[MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES];
+	int index_count;
+	int index_complete;	// all live tags are indexed, a tag missing from the index does not exist
+#endif
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	btstack_timer_source_t compaction_timer;
+	int      compaction_state;
+	uint32_t compaction_threshold;		// start compaction when write_offset passes it
+	uint32_t compaction_read_offset;	// next entry of the current bank to copy
+	uint32_t compaction_write_offset;	// end of the copied entries in the other bank
+#endif
 } btstack_tlv_flash_bank_t;
 
 /**
@@ -55,6 +55,24 @@ void hal_tick_init(void);
 void hal_tick_set_handler(void (*tick_handler)(void));
 int  hal_tick_get_tick_period_in_ms(void);
 
+/**
+ * Tickless operation, with HAVE_EMBEDDED_TICKLESS: the tick interrupt only wakes
+ * the CPU, and the run loop counts the ticks itself instead of through the handler.
+ */
+
+/**
+ * @brief Get the number of tick periods elapsed since the last call, without calling the tick handler
+ * @return ticks elapsed
+ */
+uint32_t hal_tick_sync(void);
+
+/**
+ * @brief Arrange the next tick interrupt for the given number of tick periods after
+ *        the last one counted by hal_tick_sync(), or as late as possible if 0.
+ *        Called with interrupts disabled, just before sleeping.
+ */
+void hal_tick_set_next_deadline(uint32_t ticks);
+
 #if defined __cplusplus
 }
 #endif
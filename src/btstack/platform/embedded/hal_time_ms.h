@@ -51,8 +51,20 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Start the time base, for ports that need it started explicitly
+ */
+void hal_time_ms_init(void);
+
 uint32_t hal_time_ms(void);
 
+/**
+ * @brief Arrange a wakeup the given number of milliseconds from now, or as late as
+ *        possible if 0. Used with HAVE_EMBEDDED_TICKLESS; called with interrupts
+ *        disabled, just before sleeping.
+ */
+void hal_time_ms_set_next_deadline(uint32_t ms);
+
 #if defined __cplusplus
 }
 #endif
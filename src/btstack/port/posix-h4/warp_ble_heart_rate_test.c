@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2014 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define __BTSTACK_FILE__ "warp_ble_heart_rate_test.c"
+
+// *****************************************************************************
+//
+// Host test for Warp's BLE Heart Rate Service (src/boot/ksdk1.1.0/warp-bleHeartRate.c)
+//
+// warp-bleHeartRate.c and its generated GATT database run unchanged on the
+// POSIX H4 transport. A fake controller on the master side of a pty answers
+// the HCI init sequence, then plays a central: it connects, enables Heart Rate
+// Measurement notifications and checks what each beat sends.
+//
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <pty.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "btstack_config.h"
+
+#include "bluetooth.h"
+#include "bluetooth_gatt.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "ble/att_db.h"
+
+#include "warp-bleHeartRate.h"
+
+#define TEST_CON_HANDLE         0x0040
+#define TEST_MANUFACTURER       0xffff  // reserved for tests, so no chipset driver claims it
+#define TEST_LE_ACL_LENGTH      27
+#define TEST_LE_ACL_PACKETS     4
+#define TEST_TIMEOUT_MS         5000
+#define TEST_QUIET_MS           200
+
+#define CCC_NOTIFICATION          0x0001
+
+// flags of a Heart Rate Measurement
+#define HRM_FLAGS_VALUE_FORMAT_16   0x01
+#define HRM_FLAGS_CONTACT_MASK      0x06
+#define HRM_FLAGS_CONTACT_DETECTED  0x06
+#define HRM_FLAGS_CONTACT_NOT_DETECTED 0x04
+#define HRM_FLAGS_RR_INTERVAL       0x10
+
+// beats as bleHeartRateBeat() gets them: BPM in tenths, beat interval in 100 Hz samples
+typedef struct {
+    uint16_t bpm_tenths;
+    uint16_t interval_samples;
+} test_beat_t;
+
+static const test_beat_t test_beats[] = {
+    {  723, 83 },
+    {  698, 86 },
+    {  705, 85 },
+    { 1204, 50 },
+    {  404, 149 },
+    { 2996, 20 },   // above 255 BPM, sent in the 16 bit format
+    {  600, 100 },
+};
+#define TEST_NUM_BEATS (sizeof(test_beats) / sizeof(test_beats[0]))
+
+static enum {
+    TEST_W4_WORKING,
+    TEST_W4_WRITE_RESPONSE,
+    TEST_W4_BEAT,
+    TEST_W4_NO_CONTACT,
+    TEST_W4_QUIET,
+} test_state;
+
+// Heart Rate Measurement handles, looked up in the database warp-bleHeartRate.c registered
+static uint16_t measurement_value_handle;
+static uint16_t measurement_ccc_handle;
+
+static unsigned int test_beat;
+static unsigned int test_notifications;
+
+static int controller_fd;
+static int slave_fd;
+static char slave_name[64];
+static btstack_data_source_t controller_data_source;
+static btstack_timer_source_t test_timer;
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+
+// H4 packet from the host
+static uint8_t  host_packet[1 + HCI_ACL_HEADER_SIZE + HCI_ACL_PAYLOAD_SIZE];
+static uint16_t host_packet_len;
+
+static void test_fail(const char * message){
+    printf("FAILED: %s\n", message);
+    exit(1);
+}
+
+static void controller_send(const uint8_t * packet, uint16_t size){
+    if (write(controller_fd, packet, size) != size){
+        test_fail("controller write");
+    }
+}
+
+static void controller_send_event(uint8_t event_code, const uint8_t * params, uint8_t params_len){
+    uint8_t packet[3 + 255];
+    packet[0] = HCI_EVENT_PACKET;
+    packet[1] = event_code;
+    packet[2] = params_len;
+    memcpy(&packet[3], params, params_len);
+    controller_send(packet, 3 + params_len);
+}
+
+static void controller_send_att(const uint8_t * pdu, uint16_t pdu_len){
+    uint8_t packet[1 + 4 + 4 + 32];
+    packet[0] = HCI_ACL_DATA_PACKET;
+    little_endian_store_16(packet, 1, TEST_CON_HANDLE | 0x2000);  // first automatically flushable
+    little_endian_store_16(packet, 3, 4 + pdu_len);
+    little_endian_store_16(packet, 5, pdu_len);
+    little_endian_store_16(packet, 7, L2CAP_CID_ATTRIBUTE_PROTOCOL);
+    memcpy(&packet[9], pdu, pdu_len);
+    controller_send(packet, 9 + pdu_len);
+}
+
+// Command Complete with success and return parameters a host can live with
+static void controller_handle_command(const uint8_t * command){
+    uint16_t opcode = little_endian_read_16(command, 0);
+    uint8_t  params[4 + 64];
+    uint8_t  len = 4;
+    int i;
+
+    params[0] = 1;  // Num_HCI_Command_Packets
+    little_endian_store_16(params, 1, opcode);
+    params[3] = ERROR_CODE_SUCCESS;
+
+    switch (opcode){
+        case 0x1001:    // Read Local Version Information
+            params[len++] = 0x09;                               // HCI 5.0
+            little_endian_store_16(params, len, 0); len += 2;
+            params[len++] = 0x09;                               // LMP 5.0
+            little_endian_store_16(params, len, TEST_MANUFACTURER); len += 2;
+            little_endian_store_16(params, len, 0); len += 2;
+            break;
+        case 0x1002:    // Read Local Supported Commands
+            memset(&params[len], 0, 64);
+            len += 64;
+            break;
+        case 0x1003:    // Read Local Supported Features
+            memset(&params[len], 0, 8);
+            params[len + 4] = 0x60;                             // LE supported, LE and BR/EDR simultaneous
+            len += 8;
+            break;
+        case 0x1005:    // Read Buffer Size
+            little_endian_store_16(params, len, TEST_LE_ACL_LENGTH); len += 2;
+            params[len++] = 0;
+            little_endian_store_16(params, len, TEST_LE_ACL_PACKETS); len += 2;
+            little_endian_store_16(params, len, 0); len += 2;
+            break;
+        case 0x1009:    // Read BD_ADDR
+            for (i = 0; i < 6; i++){
+                params[len++] = 0x10 + i;
+            }
+            break;
+        case 0x2002:    // LE Read Buffer Size
+            little_endian_store_16(params, len, TEST_LE_ACL_LENGTH); len += 2;
+            params[len++] = TEST_LE_ACL_PACKETS;
+            break;
+        case 0x2017:    // LE Encrypt
+        case 0x2018:    // LE Rand
+            for (i = 0; i < ((opcode == 0x2017) ? 16 : 8); i++){
+                params[len++] = (uint8_t) rand();
+            }
+            break;
+        default:
+            break;
+    }
+    controller_send_event(HCI_EVENT_COMMAND_COMPLETE, params, len);
+}
+
+static void controller_complete_packet(void){
+    uint8_t params[5];
+    params[0] = 1;
+    little_endian_store_16(params, 1, TEST_CON_HANDLE);
+    little_endian_store_16(params, 3, 1);
+    controller_send_event(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, params, sizeof(params));
+}
+
+static void controller_connect(void){
+    uint8_t params[19];
+    memset(params, 0, sizeof(params));
+    params[0] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    params[1] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(params, 2, TEST_CON_HANDLE);
+    params[4] = HCI_ROLE_SLAVE;
+    params[5] = BD_ADDR_TYPE_LE_RANDOM;
+    memcpy(&params[6], (const uint8_t[]){ 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6 }, 6);
+    little_endian_store_16(params, 12, 24);     // 30 ms connection interval
+    little_endian_store_16(params, 14, 0);
+    little_endian_store_16(params, 16, 200);    // 2 s supervision timeout
+    controller_send_event(HCI_EVENT_LE_META, params, sizeof(params));
+}
+
+static void test_send_beat(void){
+    test_state = TEST_W4_BEAT;
+    bleHeartRateBeat(test_beats[test_beat].bpm_tenths, test_beats[test_beat].interval_samples);
+}
+
+static void test_quiet_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    printf("OK: %u beats, %u notifications\n", (unsigned int) TEST_NUM_BEATS, test_notifications);
+    exit(0);
+}
+
+// the central side: checks each Heart Rate Measurement against the beat that caused it
+static void controller_handle_att(const uint8_t * pdu, uint16_t pdu_len){
+    char message[120];
+
+    switch (pdu[0]){
+        case ATT_WRITE_RESPONSE:
+            if (test_state != TEST_W4_WRITE_RESPONSE) test_fail("unexpected Write Response");
+            test_beat = 0;
+            test_send_beat();
+            return;
+        case ATT_HANDLE_VALUE_NOTIFICATION:
+            break;
+        default:
+            snprintf(message, sizeof(message), "unexpected ATT opcode 0x%02x", pdu[0]);
+            test_fail(message);
+            return;
+    }
+
+    test_notifications++;
+    if (little_endian_read_16(pdu, 1) != measurement_value_handle) test_fail("notification for another handle");
+    const uint8_t * value = &pdu[3];
+    uint16_t value_len = pdu_len - 3;
+    uint8_t flags = value[0];
+
+    switch (test_state){
+        case TEST_W4_BEAT: {
+            const test_beat_t * beat = &test_beats[test_beat];
+            uint16_t expected_bpm = (beat->bpm_tenths + 5) / 10;
+            uint16_t expected_rr  = (uint32_t) beat->interval_samples * 1024 / 100;
+            uint16_t bpm;
+            int pos;
+            if (flags & HRM_FLAGS_VALUE_FORMAT_16){
+                bpm = little_endian_read_16(value, 1);
+                pos = 3;
+            } else {
+                bpm = value[1];
+                pos = 2;
+            }
+            if (bpm != expected_bpm || (flags & HRM_FLAGS_CONTACT_MASK) != HRM_FLAGS_CONTACT_DETECTED
+             || !(flags & HRM_FLAGS_RR_INTERVAL) || value_len != pos + 2 || little_endian_read_16(value, pos) != expected_rr){
+                snprintf(message, sizeof(message), "beat %u: flags 0x%02x, %u bytes, %u BPM, expected %u BPM and RR %u/1024 s",
+                    test_beat, flags, value_len, bpm, expected_bpm, expected_rr);
+                test_fail(message);
+            }
+            printf("Beat %u: %u BPM, RR %u/1024 s\n", test_beat, bpm, expected_rr);
+            test_beat++;
+            if (test_beat < TEST_NUM_BEATS){
+                test_send_beat();
+            } else {
+                test_state = TEST_W4_NO_CONTACT;
+                bleHeartRateContactLost();
+            }
+            break;
+        }
+        case TEST_W4_NO_CONTACT:
+            if ((flags & HRM_FLAGS_CONTACT_MASK) != HRM_FLAGS_CONTACT_NOT_DETECTED || (flags & HRM_FLAGS_RR_INTERVAL) || value_len != 2 || value[1] != 0){
+                snprintf(message, sizeof(message), "contact lost: flags 0x%02x, %u bytes", flags, value_len);
+                test_fail(message);
+            }
+            printf("Contact lost: no contact, 0 BPM\n");
+            // anything sent from now on would be a second measurement for one update
+            test_state = TEST_W4_QUIET;
+            btstack_run_loop_remove_timer(&test_timer);
+            btstack_run_loop_set_timer_handler(&test_timer, &test_quiet_handler);
+            btstack_run_loop_set_timer(&test_timer, TEST_QUIET_MS);
+            btstack_run_loop_add_timer(&test_timer);
+            break;
+        default:
+            snprintf(message, sizeof(message), "notification %u not caused by a beat", test_notifications);
+            test_fail(message);
+            break;
+    }
+}
+
+static void controller_handle_packet(void){
+    switch (host_packet[0]){
+        case HCI_COMMAND_DATA_PACKET:
+            controller_handle_command(&host_packet[1]);
+            break;
+        case HCI_ACL_DATA_PACKET: {
+            if ((little_endian_read_16(host_packet, 1) & 0x0fff) != TEST_CON_HANDLE) test_fail("ACL for an unknown connection");
+            controller_complete_packet();
+            const uint8_t * l2cap = &host_packet[1 + HCI_ACL_HEADER_SIZE];
+            // measurements fit into a single LE ACL packet
+            if (little_endian_read_16(l2cap, 0) + L2CAP_HEADER_SIZE != little_endian_read_16(host_packet, 3)) test_fail("fragmented L2CAP packet");
+            if (little_endian_read_16(l2cap, 2) != L2CAP_CID_ATTRIBUTE_PROTOCOL) break;
+            controller_handle_att(&l2cap[L2CAP_HEADER_SIZE], little_endian_read_16(l2cap, 0));
+            break;
+        }
+        default:
+            test_fail("unexpected H4 packet type");
+            break;
+    }
+}
+
+// total length of the H4 packet in host_packet, 0 if not known yet
+static uint16_t controller_packet_len(void){
+    switch (host_packet[0]){
+        case HCI_COMMAND_DATA_PACKET:
+            if (host_packet_len < 1 + HCI_CMD_HEADER_SIZE) return 0;
+            return 1 + HCI_CMD_HEADER_SIZE + host_packet[3];
+        case HCI_ACL_DATA_PACKET:
+            if (host_packet_len < 1 + HCI_ACL_HEADER_SIZE) return 0;
+            return 1 + HCI_ACL_HEADER_SIZE + little_endian_read_16(host_packet, 3);
+        default:
+            test_fail("unexpected H4 packet type");
+            return 0;
+    }
+}
+
+static void controller_process(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint8_t byte;
+    while (read(ds->source.fd, &byte, 1) == 1){
+        if (host_packet_len >= sizeof(host_packet)) test_fail("host packet too long");
+        host_packet[host_packet_len++] = byte;
+        uint16_t len = controller_packet_len();
+        if (len && host_packet_len == len){
+            host_packet_len = 0;
+            controller_handle_packet();
+        }
+    }
+}
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    uint8_t write_request[5];
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != BTSTACK_EVENT_STATE) return;
+    if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) return;
+    if (test_state != TEST_W4_WORKING) return;
+
+    uint16_t start_handle = 0;
+    uint16_t end_handle = 0xffff;
+    if (!gatt_server_get_get_handle_range_for_service_with_uuid16(ORG_BLUETOOTH_SERVICE_HEART_RATE, &start_handle, &end_handle)) test_fail("no Heart Rate Service");
+    measurement_value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(start_handle, end_handle, ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT);
+    measurement_ccc_handle = gatt_server_get_client_configuration_handle_for_characteristic_with_uuid16(start_handle, end_handle, ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT);
+    if (!measurement_value_handle || !measurement_ccc_handle) test_fail("no Heart Rate Measurement characteristic");
+
+    // connect and subscribe to Heart Rate Measurements
+    test_state = TEST_W4_WRITE_RESPONSE;
+    controller_connect();
+    write_request[0] = ATT_WRITE_REQUEST;
+    little_endian_store_16(write_request, 1, measurement_ccc_handle);
+    little_endian_store_16(write_request, 3, CCC_NOTIFICATION);
+    controller_send_att(write_request, sizeof(write_request));
+}
+
+static void test_timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    test_fail("timeout");
+}
+
+// warp-bleHeartRate.c takes the embedded UART, which is the POSIX one on the slave side of the pty here
+static const btstack_uart_block_t * posix_uart;
+static btstack_uart_block_t pty_uart;
+static btstack_uart_config_t pty_uart_config;
+
+static int pty_uart_init(const btstack_uart_config_t * uart_config){
+    pty_uart_config = *uart_config;
+    pty_uart_config.device_name = slave_name;
+    return (*posix_uart->init)(&pty_uart_config);
+}
+
+const btstack_uart_block_t * btstack_uart_block_embedded_instance(void){
+    posix_uart = btstack_uart_block_posix_instance();
+    pty_uart = *posix_uart;
+    pty_uart.init = &pty_uart_init;
+    return &pty_uart;
+}
+
+int main(int argc, const char * argv[]){
+    int i;
+
+    for (i = 1; i < argc; i++){
+        if (!strcmp(argv[i], "-d")){
+            hci_dump_open(NULL, HCI_DUMP_STDOUT);
+        }
+    }
+
+    // the slave side stays open, so the master does not see a hangup while the transport reopens it
+    if (openpty(&controller_fd, &slave_fd, slave_name, NULL, NULL) < 0) test_fail("openpty");
+    fcntl(controller_fd, F_SETFL, fcntl(controller_fd, F_GETFL) | O_NONBLOCK);
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    btstack_run_loop_set_data_source_fd(&controller_data_source, controller_fd);
+    btstack_run_loop_set_data_source_handler(&controller_data_source, &controller_process);
+    btstack_run_loop_enable_data_source_callbacks(&controller_data_source, DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_add_data_source(&controller_data_source);
+
+    btstack_run_loop_set_timer_handler(&test_timer, &test_timeout_handler);
+    btstack_run_loop_set_timer(&test_timer, TEST_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&test_timer);
+
+    bleHeartRateInit();
+
+    // the HCI state is only set up by bleHeartRateInit(), the controller is not powered up before the run loop runs
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+
+    btstack_run_loop_execute();
+    return 0;
+}
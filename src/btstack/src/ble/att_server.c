@@ -988,6 +988,12 @@ int att_server_request_to_send_indication(btstack_context_callback_registration_
     return ERROR_CODE_SUCCESS;
 }
 
+uint16_t att_server_get_mtu(hci_con_handle_t con_handle){
+    att_server_t * att_server = att_server_for_handle(con_handle);
+    if (!att_server) return 0;
+    return att_server->connection.mtu;
+}
+
 int att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t *value, uint16_t value_len){
     att_server_t * att_server = att_server_for_handle(con_handle);
     if (!att_server) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
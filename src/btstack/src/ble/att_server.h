@@ -135,6 +135,14 @@ int att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, ui
  */
 int att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t *value, uint16_t value_len);
 
+/*
+ * @brief get ATT MTU negotiated for a connection
+ * @note a notification can carry up to mtu - 3 bytes of value
+ * @param con_handle
+ * @return mtu, or 0 if the connection is unknown
+ */
+uint16_t att_server_get_mtu(hci_con_handle_t con_handle);
+
 #ifdef ENABLE_ATT_DELAYED_RESPONSE
 /*
  * @brief response ready - called after returning ATT_READ__RESPONSE_PENDING in an att_read_callback or
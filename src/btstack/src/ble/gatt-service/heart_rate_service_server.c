@@ -38,20 +38,45 @@
 #define __BTSTACK_FILE__ "heart_rate_service_server.c"
 
 
+#include <string.h>
+
+#include "btstack_config.h"
 #include "bluetooth.h"
 #include "btstack_defines.h"
+#include "btstack_event.h"
 #include "ble/att_db.h"
 #include "ble/att_server.h"
 #include "btstack_util.h"
 #include "bluetooth_gatt.h"
 #include "btstack_debug.h"
-#include "l2cap.h"
+#include "hci.h"
 
 #include "ble/gatt-service/heart_rate_service_server.h"
 
 #define HEART_RATE_RESET_ENERGY_EXPENDED 0x01
 #define HEART_RATE_CONTROL_POINT_NOT_SUPPORTED 0x80
 
+// max RR-Intervals per measurement
+#ifndef HEART_RATE_SERVICE_RR_INTERVAL_QUEUE_SIZE
+#define HEART_RATE_SERVICE_RR_INTERVAL_QUEUE_SIZE 8
+#endif
+
+// encoded measurements kept for subscribers that are behind, must be a power of two
+#ifndef HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE
+#define HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE 4
+#endif
+
+#ifndef HEART_RATE_SERVICE_MAX_SUBSCRIBERS
+#ifdef MAX_NR_HCI_CONNECTIONS
+#define HEART_RATE_SERVICE_MAX_SUBSCRIBERS MAX_NR_HCI_CONNECTIONS
+#else
+#define HEART_RATE_SERVICE_MAX_SUBSCRIBERS 2
+#endif
+#endif
+
+// flags, heart rate (16 bit), energy expended and a full set of RR-Intervals
+#define HEART_RATE_SERVICE_MEASUREMENT_MAX_SIZE (5 + 2 * HEART_RATE_SERVICE_RR_INTERVAL_QUEUE_SIZE)
+
 typedef enum {
 	HEART_RATE_SERVICE_VALUE_FORMAT = 0,
 	HEART_RATE_SERVICE_SENSOR_CONTACT_STATUS,
@@ -59,23 +84,37 @@ typedef enum {
 	HEART_RATE_SERVICE_RR_INTERVAL
 } heart_rate_service_flag_bit_t;
 
+// encoded Heart Rate Measurement, shared by all subscribers
+typedef struct {
+	uint8_t value[HEART_RATE_SERVICE_MEASUREMENT_MAX_SIZE];
+	uint8_t len;
+	uint8_t rr_offset;
+} heart_rate_measurement_t;
+
 typedef struct {
-	hci_con_handle_t con_handle;
+	hci_con_handle_t con_handle;	// HCI_CON_HANDLE_INVALID if unused
+	uint16_t client_configuration;
+	uint8_t  next_measurement;		// sequence number of the next measurement to send
+	hci_con_handle_t pending_con_handle;	// connection the callback is registered with, HCI_CON_HANDLE_INVALID if none
+	btstack_context_callback_registration_t callback;
+} heart_rate_subscriber_t;
 
+typedef struct {
 	// characteristic: Heart Rate Mesurement 
 	uint16_t measurement_value_handle;
 	uint16_t measurement_bpm;
 	uint8_t  energy_expended_supported;
 	uint16_t energy_expended_kJ; // kilo Joules
-	int rr_interval_count;
-	int rr_offset;
-	uint16_t * rr_intervals;
 	heart_rate_service_sensor_contact_status_t sensor_contact;
 
-	// characteristic descriptor: Client Characteristic Configuration
+	// measurements not yet sent to all subscribers
+	heart_rate_measurement_t measurements[HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE];
+	uint8_t  measurement_write;		// sequence number of the next measurement to encode
+	uint8_t  measurement_open;		// newest measurement not sent yet, new values can be merged into it
+
+	// characteristic descriptor: Client Characteristic Configuration, per connection
 	uint16_t measurement_client_configuration_descriptor_handle;
-	uint16_t measurement_client_configuration_descriptor_notify;
-	btstack_context_callback_registration_t measurement_callback;
+	heart_rate_subscriber_t subscribers[HEART_RATE_SERVICE_MAX_SUBSCRIBERS];
 
 	// characteristic: Body Sensor Location 
 	uint16_t sensor_location_value_handle;
@@ -86,17 +125,30 @@ typedef struct {
 } heart_rate_t;
 
 static att_service_handler_t heart_rate_service;
+static btstack_packet_callback_registration_t hci_event_callback_registration;
 static heart_rate_t heart_rate;
 
+static heart_rate_subscriber_t * heart_rate_service_subscriber_for_con_handle(hci_con_handle_t con_handle){
+	int i;
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		if (heart_rate.subscribers[i].con_handle == con_handle) return &heart_rate.subscribers[i];
+	}
+	return NULL;
+}
+
+// a pending send request stays registered with the connection it was made for, see pending_con_handle
+static void heart_rate_service_subscriber_free(heart_rate_subscriber_t * subscriber){
+	subscriber->con_handle = HCI_CON_HANDLE_INVALID;
+	subscriber->client_configuration = 0;
+}
+
 static uint16_t heart_rate_service_read_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size){
-	UNUSED(con_handle);
-	UNUSED(attribute_handle);
 	UNUSED(offset);
-	UNUSED(buffer_size);
 	
 	if (attribute_handle == heart_rate.measurement_client_configuration_descriptor_handle){
 		if (buffer && buffer_size >= 2){
-			little_endian_store_16(buffer, 0, heart_rate.measurement_client_configuration_descriptor_notify);
+			heart_rate_subscriber_t * subscriber = heart_rate_service_subscriber_for_con_handle(con_handle);
+			little_endian_store_16(buffer, 0, subscriber ? subscriber->client_configuration : 0);
 		} 
 		return 2;
 	}
@@ -107,26 +159,39 @@ static uint16_t heart_rate_service_read_callback(hci_con_handle_t con_handle, ui
 		}
 		return 1;
 	}
-	printf("heart_rate_service_read_callback, not handeled read on handle 0x%02x\n", attribute_handle);
+	log_info("heart_rate_service_read_callback, not handeled read on handle 0x%02x", attribute_handle);
 	return 0;
 }
 
 static int heart_rate_service_write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size){
 	UNUSED(transaction_mode);
 	UNUSED(offset);
-	UNUSED(buffer_size);
 	
 	if (attribute_handle == heart_rate.measurement_client_configuration_descriptor_handle){
 		if (buffer_size < 2){
 			return ATT_ERROR_INVALID_OFFSET;
 		}
-		heart_rate.measurement_client_configuration_descriptor_notify = little_endian_read_16(buffer, 0);
-		heart_rate.con_handle = con_handle;
-		if (heart_rate.measurement_client_configuration_descriptor_notify){
-			printf("notify enabled\n");
-		} else {
-			printf("notify disabled\n");
+		uint16_t client_configuration = little_endian_read_16(buffer, 0);
+		heart_rate_subscriber_t * subscriber = heart_rate_service_subscriber_for_con_handle(con_handle);
+		if (!client_configuration){
+			if (subscriber){
+				heart_rate_service_subscriber_free(subscriber);
+			}
+			log_info("notify disabled, con_handle 0x%04x", con_handle);
+			return 0;
+		}
+		if (!subscriber){
+			subscriber = heart_rate_service_subscriber_for_con_handle(HCI_CON_HANDLE_INVALID);
+			if (!subscriber){
+				return ATT_ERROR_INSUFFICIENT_RESOURCES;
+			}
+			subscriber->con_handle = con_handle;
 		}
+		// only measurements taken from now on are sent
+		subscriber->client_configuration = client_configuration;
+		subscriber->next_measurement = heart_rate.measurement_write;
+		heart_rate.measurement_open = 0;
+		log_info("notify enabled, con_handle 0x%04x", con_handle);
 		return 0;
 	}
 	
@@ -135,7 +200,6 @@ static int heart_rate_service_write_callback(hci_con_handle_t con_handle, uint16
 		switch (cmd){
 			case HEART_RATE_RESET_ENERGY_EXPENDED:
 				heart_rate.energy_expended_kJ = 0;
-				heart_rate.con_handle = con_handle;
 				break;
 			default:
 				return HEART_RATE_CONTROL_POINT_NOT_SUPPORTED;
@@ -143,10 +207,35 @@ static int heart_rate_service_write_callback(hci_con_handle_t con_handle, uint16
 		return 0;
 	}
 
-	printf("heart_rate_service_write_callback, not handeled write on handle 0x%02x\n", attribute_handle);
+	log_info("heart_rate_service_write_callback, not handeled write on handle 0x%02x", attribute_handle);
 	return 0;
 }
 
+static void heart_rate_service_request_notification(heart_rate_subscriber_t * subscriber);
+
+static void heart_rate_service_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+	UNUSED(channel);
+	UNUSED(size);
+
+	if (packet_type != HCI_EVENT_PACKET) return;
+	if (hci_event_packet_get_type(packet) != HCI_EVENT_DISCONNECTION_COMPLETE) return;
+
+	hci_con_handle_t con_handle = hci_event_disconnection_complete_get_connection_handle(packet);
+	int i;
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		heart_rate_subscriber_t * subscriber = &heart_rate.subscribers[i];
+		if (subscriber->con_handle == con_handle){
+			heart_rate_service_subscriber_free(subscriber);
+		}
+		// pending send requests are dropped with the connection, even if the slot
+		// has since been taken by another connection, which then requests its own
+		if (subscriber->pending_con_handle != con_handle) continue;
+		subscriber->pending_con_handle = HCI_CON_HANDLE_INVALID;
+		if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) continue;
+		if (subscriber->next_measurement == heart_rate.measurement_write) continue;
+		heart_rate_service_request_notification(subscriber);
+	}
+}
 
 void heart_rate_service_server_init(heart_rate_service_body_sensor_location_t location, int energy_expended_supported){
 	heart_rate_t * instance = &heart_rate;
@@ -154,6 +243,12 @@ void heart_rate_service_server_init(heart_rate_service_body_sensor_location_t lo
 	instance->sensor_location = location;
 	instance->energy_expended_supported = energy_expended_supported;
 
+	int i;
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		heart_rate_service_subscriber_free(&instance->subscribers[i]);
+		instance->subscribers[i].pending_con_handle = HCI_CON_HANDLE_INVALID;
+	}
+
 	// get service handle range
 	uint16_t start_handle = 0;
 	uint16_t end_handle   = 0xffff;
@@ -168,10 +263,10 @@ void heart_rate_service_server_init(heart_rate_service_body_sensor_location_t lo
 	// get Hear Rate Control Point characteristic value handle and client configuration handle
 	instance->control_point_value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(start_handle, end_handle, ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_CONTROL_POINT);
 	
-	printf("Measurement     value handle 0x%02x\n", instance->measurement_value_handle);
-	printf("Client Config   value handle 0x%02x\n", instance->measurement_client_configuration_descriptor_handle);
-	printf("Sensor location value handle 0x%02x\n", instance->sensor_location_value_handle);
-	printf("Control Point   value handle 0x%02x\n", instance->control_point_value_handle);
+	log_info("Measurement     value handle 0x%02x", instance->measurement_value_handle);
+	log_info("Client Config   value handle 0x%02x", instance->measurement_client_configuration_descriptor_handle);
+	log_info("Sensor location value handle 0x%02x", instance->sensor_location_value_handle);
+	log_info("Control Point   value handle 0x%02x", instance->control_point_value_handle);
 	// register service with ATT Server
 	heart_rate_service.start_handle   = start_handle;
 	heart_rate_service.end_handle     = end_handle;
@@ -179,51 +274,117 @@ void heart_rate_service_server_init(heart_rate_service_body_sensor_location_t lo
 	heart_rate_service.write_callback = &heart_rate_service_write_callback;
 	
 	att_server_register_service_handler(&heart_rate_service);
+
+	// free subscriber state on disconnect
+	hci_event_callback_registration.callback = &heart_rate_service_packet_handler;
+	hci_add_event_handler(&hci_event_callback_registration);
 }
 
+static heart_rate_measurement_t * heart_rate_service_measurement(uint8_t sequence_number){
+	return &heart_rate.measurements[sequence_number & (HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE - 1)];
+}
 
-static void heart_rate_service_can_send_now(void * context){
-	heart_rate_t * instance = (heart_rate_t *) context;
-	uint8_t flags = (1 << HEART_RATE_SERVICE_VALUE_FORMAT);
-	flags |= (instance->sensor_contact << HEART_RATE_SERVICE_SENSOR_CONTACT_STATUS);
+static int heart_rate_service_header_len(heart_rate_t * instance){
+	return 1 + ((instance->measurement_bpm > 0xff) ? 2 : 1) + (instance->energy_expended_supported ? 2 : 0);
+}
+
+// (re-)writes the measurement header from the current values, moving any RR-Intervals behind it
+static void heart_rate_service_store_header(heart_rate_t * instance, heart_rate_measurement_t * measurement){
+	uint8_t rr_len = measurement->len - measurement->rr_offset;
+	uint8_t flags = (instance->sensor_contact << HEART_RATE_SERVICE_SENSOR_CONTACT_STATUS);
+	int pos = heart_rate_service_header_len(instance);
+
+	memmove(&measurement->value[pos], &measurement->value[measurement->rr_offset], rr_len);
+	measurement->rr_offset = pos;
+	measurement->len = pos + rr_len;
+
+	// use the 8 bit heart rate format whenever the value fits
+	pos = 1;
+	if (instance->measurement_bpm > 0xff){
+		flags |= (1 << HEART_RATE_SERVICE_VALUE_FORMAT);
+		little_endian_store_16(measurement->value, pos, instance->measurement_bpm);
+		pos += 2;
+	} else {
+		measurement->value[pos++] = (uint8_t) instance->measurement_bpm;
+	}
 	if (instance->energy_expended_supported){
 		flags |= (1 << HEART_RATE_SERVICE_ENERGY_EXPENDED_STATUS);
+		little_endian_store_16(measurement->value, pos, instance->energy_expended_kJ);
 	}
-	if (instance->rr_interval_count){
+	if (rr_len){
 		flags |= (1 << HEART_RATE_SERVICE_RR_INTERVAL);
 	}
-	printf("heart_rate_service_can_send_now: flags 0%2x\n", flags);
+	measurement->value[0] = flags;
+}
 
-	uint8_t value[100];
-	int pos = 0;
+static heart_rate_measurement_t * heart_rate_service_new_measurement(heart_rate_t * instance){
+	int i;
+	// subscribers that have not sent the oldest measurement yet lose it
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		heart_rate_subscriber_t * subscriber = &instance->subscribers[i];
+		if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) continue;
+		if ((uint8_t)(instance->measurement_write - subscriber->next_measurement) < HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE) continue;
+		log_info("measurement queue full, con_handle 0x%04x drops oldest", subscriber->con_handle);
+		subscriber->next_measurement++;
+	}
 
-	value[pos++] = flags;
-	little_endian_store_16(value, pos, instance->measurement_bpm);
-	pos += 2;
-	if (instance->energy_expended_supported){
-		little_endian_store_16(value, pos, instance->energy_expended_kJ);
-		pos += 2;
+	heart_rate_measurement_t * measurement = heart_rate_service_measurement(instance->measurement_write);
+	instance->measurement_write++;
+	instance->measurement_open = 1;
+	measurement->len = 0;
+	measurement->rr_offset = 0;
+	heart_rate_service_store_header(instance, measurement);
+	return measurement;
+}
+
+static void heart_rate_service_can_send_now(void * context);
+
+// the callback is linked into the connection's request list until it fires or the
+// connection goes away, so it is registered again only after either has happened
+static void heart_rate_service_request_notification(heart_rate_subscriber_t * subscriber){
+	if (subscriber->pending_con_handle != HCI_CON_HANDLE_INVALID) return;
+	subscriber->pending_con_handle = subscriber->con_handle;
+	subscriber->callback.callback = &heart_rate_service_can_send_now;
+	subscriber->callback.context  = (void*) subscriber;
+	if (att_server_request_to_send_notification(&subscriber->callback, subscriber->con_handle) != ERROR_CODE_SUCCESS){
+		subscriber->pending_con_handle = HCI_CON_HANDLE_INVALID;
 	}
+}
 
-	// TODO: get actual MTU from ATT server
-	uint16_t bytes_left = btstack_min(sizeof(value), l2cap_max_mtu() - 3 - pos);
+static void heart_rate_service_can_send_now(void * context){
+	heart_rate_subscriber_t * subscriber = (heart_rate_subscriber_t *) context;
+	heart_rate_t * instance = &heart_rate;
+	hci_con_handle_t pending_con_handle = subscriber->pending_con_handle;
+	subscriber->pending_con_handle = HCI_CON_HANDLE_INVALID;
+
+	if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) return;
+	if (subscriber->next_measurement == instance->measurement_write) return;
 
-	while (bytes_left > 2 && instance->rr_interval_count){
-		little_endian_store_16(value, pos, instance->rr_intervals[0]);
-		pos +=2;
-		bytes_left -= 2;
-		instance->rr_intervals++;
-		instance->rr_interval_count--;
+	// the slot was freed and taken by another connection while the request was pending
+	if (subscriber->con_handle != pending_con_handle){
+		heart_rate_service_request_notification(subscriber);
+		return;
 	}
 
-	printf_hexdump(value, pos);
-	att_server_notify(instance->con_handle, instance->measurement_value_handle, &value[0], pos);
+	uint16_t mtu = att_server_get_mtu(subscriber->con_handle);
+	if (mtu == 0) return;
+
+	// measurements are sized for the smallest MTU when encoded, so this only
+	// trims RR-Intervals for a connection that subscribed after the encoding
+	heart_rate_measurement_t * measurement = heart_rate_service_measurement(subscriber->next_measurement);
+	uint16_t len = measurement->len;
+	if (len > mtu - 3){
+		len = measurement->rr_offset + ((mtu - 3 - measurement->rr_offset) & ~1);
+	}
+	att_server_notify(subscriber->con_handle, instance->measurement_value_handle, measurement->value, len);
 
-	if (instance->rr_interval_count){
-		instance->measurement_callback.callback = &heart_rate_service_can_send_now;
-		instance->measurement_callback.context  = (void*) instance;
-		att_server_register_can_send_now_callback(&instance->measurement_callback, instance->con_handle);
-	} 
+	subscriber->next_measurement++;
+	if (subscriber->next_measurement == instance->measurement_write){
+		// sent the newest measurement, later values go into a new one
+		instance->measurement_open = 0;
+	} else {
+		heart_rate_service_request_notification(subscriber);
+	}
 }
 
 void heart_rate_service_add_energy_expended(uint16_t energy_expended_kJ){
@@ -239,18 +400,48 @@ void heart_rate_service_add_energy_expended(uint16_t energy_expended_kJ){
 void heart_rate_service_server_update_heart_rate_values(uint16_t heart_rate_bpm, 
 	heart_rate_service_sensor_contact_status_t sensor_contact, int rr_interval_count, uint16_t * rr_intervals){
 	heart_rate_t * instance = &heart_rate;
+	int i;
 
-	printf("update_heart_rate_values, notify %u con_handle %04x\n", instance->measurement_client_configuration_descriptor_notify, instance->con_handle);	
-	
 	instance->measurement_bpm = heart_rate_bpm;
 	instance->sensor_contact = sensor_contact;
-	instance->rr_interval_count = rr_interval_count;
-	instance->rr_intervals = rr_intervals;
-	instance->rr_offset = 0;
-
-	if (instance->measurement_client_configuration_descriptor_notify){
-		instance->measurement_callback.callback = &heart_rate_service_can_send_now;
-		instance->measurement_callback.context  = (void*) instance;
-		att_server_register_can_send_now_callback(&instance->measurement_callback, instance->con_handle);
+
+	// the measurement is encoded for the smallest MTU of all subscribers
+	uint16_t max_len = HEART_RATE_SERVICE_MEASUREMENT_MAX_SIZE;
+	int num_subscribers = 0;
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		heart_rate_subscriber_t * subscriber = &instance->subscribers[i];
+		if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) continue;
+		max_len = btstack_min(max_len, att_server_get_mtu(subscriber->con_handle) - 3);
+		num_subscribers++;
 	}
-}
\ No newline at end of file
+	if (!num_subscribers) return;
+
+	// merge into the newest measurement if no subscriber has sent it yet, otherwise encode a new one
+	heart_rate_measurement_t * measurement = NULL;
+	if (instance->measurement_open){
+		measurement = heart_rate_service_measurement(instance->measurement_write - 1);
+		if (heart_rate_service_header_len(instance) + measurement->len - measurement->rr_offset <= max_len){
+			heart_rate_service_store_header(instance, measurement);
+		} else {
+			measurement = NULL;
+		}
+	}
+	if (!measurement){
+		measurement = heart_rate_service_new_measurement(instance);
+	}
+	for (i = 0; i < rr_interval_count; i++){
+		if (measurement->len + 2 > max_len){
+			measurement = heart_rate_service_new_measurement(instance);
+		}
+		little_endian_store_16(measurement->value, measurement->len, rr_intervals[i]);
+		measurement->len += 2;
+		measurement->value[0] |= (1 << HEART_RATE_SERVICE_RR_INTERVAL);
+	}
+
+	// one encoding, sent to each subscriber
+	for (i = 0; i < HEART_RATE_SERVICE_MAX_SUBSCRIBERS; i++){
+		heart_rate_subscriber_t * subscriber = &instance->subscribers[i];
+		if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) continue;
+		heart_rate_service_request_notification(subscriber);
+	}
+}
@@ -62,8 +62,16 @@ extern "C" {
  * from the client is received.
  *  
  * The RR-Interval represents the time between two consecutive R waves in 
- * an Electrocardiogram (ECG) waveform. If needed, the RR-Intervals are sent in
- * multiple notifications.
+ * an Electrocardiogram (ECG) waveform. Each measurement carries up to
+ * HEART_RATE_SERVICE_RR_INTERVAL_QUEUE_SIZE RR-Intervals (default 8), limited by the
+ * smallest ATT MTU of the subscribed connections. Updates that arrive before any
+ * client has been sent the newest measurement are merged into it.
+ *
+ * Every connection keeps its own Client Characteristic Configuration, for up to
+ * HEART_RATE_SERVICE_MAX_SUBSCRIBERS connections (default MAX_NR_HCI_CONNECTIONS).
+ * A measurement is encoded once and sent to each subscriber from a shared queue of
+ * HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE measurements (default 4). A subscriber
+ * that falls further behind loses its oldest measurement.
  * 
  * To use with your application, add `#import <heart_rate_service.gatt>` to your .gatt file.
  * After adding it to your .gatt file, you call *heart_rate_server_init(body_sensor_location, energy_expended_supported)*
@@ -121,7 +129,7 @@ void heart_rate_service_add_energy_expended(uint16_t energy_expended_kJ);
  * @param heart_rate_bpm 		beats per minute
  * @param contact    
  * @param rr_interval_count 
- * @param rr_intervals      resolution in 1/1024 seconds
+ * @param rr_intervals      resolution in 1/1024 seconds, copied into the measurement
  */
 void heart_rate_service_server_update_heart_rate_values(uint16_t heart_rate_bpm, 
 	heart_rate_service_sensor_contact_status_t contact, int rr_interval_count, uint16_t * rr_intervals);
@@ -73,11 +73,14 @@ static inline void __log_unused(const char *format, ...) {
 #endif
 #endif
 
+// allow to provide port specific log backend
+#ifndef HCI_DUMP_LOG
 #ifdef __AVR__
 #define HCI_DUMP_LOG(log_level, format, ...) hci_dump_log_P(log_level, PSTR("%s.%u: " format), __BTSTACK_FILE__, __LINE__, ## __VA_ARGS__)
 #else
 #define HCI_DUMP_LOG(log_level, format, ...) hci_dump_log(log_level, "%s.%u: " format, __BTSTACK_FILE__, __LINE__, ## __VA_ARGS__)
 #endif
+#endif
 
 #ifdef ENABLE_LOG_DEBUG
 #define log_debug(format, ...)  HCI_DUMP_LOG(HCI_DUMP_LOG_LEVEL_DEBUG, format,  ## __VA_ARGS__)
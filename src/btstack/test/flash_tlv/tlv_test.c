@@ -239,6 +239,301 @@ TEST(BSTACK_TLV, TestWriteResetRead){
     CHECK_EQUAL(buffer, data);
 }
 
+/// TLV lookup cost, counted in hal_flash_bank reads
+#define TLV_TIMING_STORAGE_SIZE 1024
+#define TLV_TIMING_NUM_TAGS     12
+#define TLV_OVERFLOW_NUM_TAGS   40
+static uint8_t tlv_timing_storage[TLV_TIMING_STORAGE_SIZE];
+
+static const hal_flash_bank_t * counting_hal_flash_bank_impl;
+static int counting_hal_flash_bank_reads;
+static int counting_hal_flash_bank_writes;
+static int counting_hal_flash_bank_erases;
+
+static uint32_t counting_hal_flash_bank_get_size(void * context){
+	return counting_hal_flash_bank_impl->get_size(context);
+}
+static uint32_t counting_hal_flash_bank_get_alignment(void * context){
+	return counting_hal_flash_bank_impl->get_alignment(context);
+}
+static void counting_hal_flash_bank_erase(void * context, int bank){
+	counting_hal_flash_bank_erases++;
+	counting_hal_flash_bank_impl->erase(context, bank);
+}
+static void counting_hal_flash_bank_read(void * context, int bank, uint32_t offset, uint8_t * buffer, uint32_t size){
+	counting_hal_flash_bank_reads++;
+	counting_hal_flash_bank_impl->read(context, bank, offset, buffer, size);
+}
+static void counting_hal_flash_bank_write(void * context, int bank, uint32_t offset, const uint8_t * data, uint32_t size){
+	counting_hal_flash_bank_writes++;
+	counting_hal_flash_bank_impl->write(context, bank, offset, data, size);
+}
+
+static const hal_flash_bank_t counting_hal_flash_bank = {
+	&counting_hal_flash_bank_get_size,
+	&counting_hal_flash_bank_get_alignment,
+	&counting_hal_flash_bank_erase,
+	&counting_hal_flash_bank_read,
+	&counting_hal_flash_bank_write,
+};
+
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+// run loop holding a single timer, fired by hand
+static btstack_timer_source_t * test_run_loop_timer;
+
+static void test_run_loop_init(void){
+}
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+	ts->timeout = timeout_in_ms;
+}
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+	test_run_loop_timer = ts;
+}
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+	if (test_run_loop_timer != ts) return 0;
+	test_run_loop_timer = NULL;
+	return 1;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+	&test_run_loop_init,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	&test_run_loop_set_timer,
+	&test_run_loop_add_timer,
+	&test_run_loop_remove_timer,
+	NULL,
+	NULL,
+	NULL,
+};
+
+// @returns 1 if a timer was pending
+static int test_run_loop_fire_timer(void){
+	btstack_timer_source_t * ts = test_run_loop_timer;
+	if (!ts) return 0;
+	test_run_loop_timer = NULL;
+	ts->process(ts);
+	return 1;
+}
+#endif
+
+TEST_GROUP(BSTACK_TLV_TIMING){
+
+	hal_flash_bank_memory_t  hal_flash_bank_context;
+
+	const btstack_tlv_t *    btstack_tlv_impl;
+	btstack_tlv_flash_bank_t btstack_tlv_context;
+
+    void setup(void){
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+    	test_run_loop_timer = NULL;
+#endif
+    	counting_hal_flash_bank_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, tlv_timing_storage, TLV_TIMING_STORAGE_SIZE);
+		counting_hal_flash_bank_impl->erase(&hal_flash_bank_context, 0);
+		counting_hal_flash_bank_impl->erase(&hal_flash_bank_context, 1);
+		btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+    }
+
+    void store_tags(int num_tags){
+    	int i;
+    	for (i=0;i<num_tags;i++){
+    		uint8_t data = i;
+    		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000 + i, &data, 1);
+    	}
+    }
+
+    int reads_for_get(uint32_t tag){
+    	uint8_t buffer;
+    	counting_hal_flash_bank_reads = 0;
+    	btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, &buffer, 1);
+    	return counting_hal_flash_bank_reads;
+    }
+
+    void check_tag(uint32_t tag, int present, uint8_t data){
+    	uint8_t buffer = 0;
+    	int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, &buffer, 1);
+    	CHECK_EQUAL(present, size);
+    	if (present){
+    		CHECK_EQUAL(data, buffer);
+    	}
+    }
+};
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+
+TEST(BSTACK_TLV_TIMING, TestLookupCostIndependentOfPosition){
+	store_tags(TLV_TIMING_NUM_TAGS);
+	// header and value
+	CHECK(reads_for_get(0x1000) <= 2);
+	CHECK(reads_for_get(0x1000 + TLV_TIMING_NUM_TAGS - 1) <= 2);
+	CHECK_EQUAL(reads_for_get(0x1000), reads_for_get(0x1000 + TLV_TIMING_NUM_TAGS - 1));
+}
+
+TEST(BSTACK_TLV_TIMING, TestMissingTagWithoutReads){
+	store_tags(TLV_TIMING_NUM_TAGS);
+	CHECK_EQUAL(0, reads_for_get(0x2000));
+}
+
+TEST(BSTACK_TLV_TIMING, TestIndexRebuiltOnInit){
+	store_tags(TLV_TIMING_NUM_TAGS);
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+	CHECK(reads_for_get(0x1000 + TLV_TIMING_NUM_TAGS - 1) <= 2);
+	CHECK_EQUAL(0, reads_for_get(0x2000));
+}
+
+#else
+
+TEST(BSTACK_TLV_TIMING, TestLookupCostGrowsWithPosition){
+	store_tags(TLV_TIMING_NUM_TAGS);
+	CHECK(reads_for_get(0x1000 + TLV_TIMING_NUM_TAGS - 1) > reads_for_get(0x1000));
+}
+
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+
+#define TLV_COMPACTION_NUM_TAGS 8
+
+// keep updating a few tags, with two run loop iterations between stores
+TEST(BSTACK_TLV_TIMING, TestCompactionBoundsStoreCost){
+	int i;
+	int max_writes = 0;
+	int erases = 0;
+	store_tags(TLV_COMPACTION_NUM_TAGS);
+	for (i=0;i<400;i++){
+		uint8_t data = i & 0x7f;
+		counting_hal_flash_bank_writes = 0;
+		counting_hal_flash_bank_erases = 0;
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000 + (i % TLV_COMPACTION_NUM_TAGS), &data, 1);
+		max_writes = btstack_max(max_writes, counting_hal_flash_bank_writes);
+		CHECK_EQUAL(0, counting_hal_flash_bank_erases);
+		// the copy has to outpace the stores to catch up with write_offset
+		counting_hal_flash_bank_erases = 0;
+		test_run_loop_fire_timer();
+		test_run_loop_fire_timer();
+		erases += counting_hal_flash_bank_erases;
+		check_tag(0x1000 + (i % TLV_COMPACTION_NUM_TAGS), 1, data);
+	}
+	// value, entry, delete of the previous value in both banks
+	CHECK(max_writes <= 4);
+	// more than a bank was written, so compaction switched banks a few times
+	CHECK(erases > 2);
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+	for (i=400-TLV_COMPACTION_NUM_TAGS;i<400;i++){
+		check_tag(0x1000 + (i % TLV_COMPACTION_NUM_TAGS), 1, i & 0x7f);
+	}
+}
+
+// stores and deletes of copied and not yet copied tags while a compaction runs
+TEST(BSTACK_TLV_TIMING, TestCompactionKeepsReadsConsistent){
+	int i;
+	uint8_t data = 0x55;
+	store_tags(TLV_COMPACTION_NUM_TAGS);
+	// fill until compaction starts
+	while (!test_run_loop_timer){
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000, &data, 1);
+	}
+	// erase, then copy the first entries
+	for (i=0;i<3;i++){
+		CHECK(test_run_loop_fire_timer());
+	}
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1001, &data, 1);
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, 0x1002);
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000 + TLV_COMPACTION_NUM_TAGS - 1, &data, 1);
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, 0x1000 + TLV_COMPACTION_NUM_TAGS - 2);
+	int steps = 0;
+	do {
+		check_tag(0x1000, 1, 0x55);
+		check_tag(0x1001, 1, 0x55);
+		check_tag(0x1002, 0, 0);
+		for (i=3;i<TLV_COMPACTION_NUM_TAGS-2;i++){
+			check_tag(0x1000 + i, 1, i);
+		}
+		check_tag(0x1000 + TLV_COMPACTION_NUM_TAGS - 2, 0, 0);
+		check_tag(0x1000 + TLV_COMPACTION_NUM_TAGS - 1, 1, 0x55);
+		steps++;
+	} while (test_run_loop_fire_timer());
+	CHECK(steps > 1);
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+	check_tag(0x1001, 1, 0x55);
+	check_tag(0x1002, 0, 0);
+	check_tag(0x1000 + TLV_COMPACTION_NUM_TAGS - 2, 0, 0);
+	check_tag(0x1000 + TLV_COMPACTION_NUM_TAGS - 1, 1, 0x55);
+}
+
+// a reset part way through a compaction falls back to the previous bank
+TEST(BSTACK_TLV_TIMING, TestCompactionInterruptedByReset){
+	int i;
+	uint8_t data = 0x55;
+	store_tags(TLV_COMPACTION_NUM_TAGS);
+	while (!test_run_loop_timer){
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000, &data, 1);
+	}
+	for (i=0;i<4;i++){
+		test_run_loop_fire_timer();
+	}
+	test_run_loop_timer = NULL;
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+	check_tag(0x1000, 1, 0x55);
+	for (i=1;i<TLV_COMPACTION_NUM_TAGS;i++){
+		check_tag(0x1000 + i, 1, i);
+	}
+	// compaction starts over with the next store
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1001, &data, 1);
+	while (test_run_loop_fire_timer());
+	check_tag(0x1000, 1, 0x55);
+	check_tag(0x1001, 1, 0x55);
+	for (i=2;i<TLV_COMPACTION_NUM_TAGS;i++){
+		check_tag(0x1000 + i, 1, i);
+	}
+}
+
+// without run loop iterations, the store that finds the bank full completes the compaction
+TEST(BSTACK_TLV_TIMING, TestCompactionWithoutRunLoop){
+	int i;
+	store_tags(TLV_COMPACTION_NUM_TAGS);
+	for (i=0;i<200;i++){
+		uint8_t data = i & 0x7f;
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000, &data, 1);
+		check_tag(0x1000, 1, data);
+	}
+	for (i=1;i<TLV_COMPACTION_NUM_TAGS;i++){
+		check_tag(0x1000 + i, 1, i);
+	}
+}
+
+#endif
+
+// more tags than the index holds, with updates and deletes across a migration
+TEST(BSTACK_TLV_TIMING, TestOverflow){
+	int i;
+	store_tags(TLV_OVERFLOW_NUM_TAGS);
+	uint8_t data = 0x55;
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000, &data, 1);
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1000 + TLV_OVERFLOW_NUM_TAGS - 1, &data, 1);
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, 0x1001);
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, 0x1000 + TLV_OVERFLOW_NUM_TAGS - 2);
+	// fill the bank to force a migration
+	for (i=0;i<TLV_OVERFLOW_NUM_TAGS;i++){
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x1002, &data, 1);
+	}
+	int pass;
+	for (pass=0;pass<2;pass++){
+		check_tag(0x1000, 1, 0x55);
+		check_tag(0x1001, 0, 0);
+		check_tag(0x1002, 1, 0x55);
+		for (i=3;i<TLV_OVERFLOW_NUM_TAGS-2;i++){
+			check_tag(0x1000 + i, 1, i);
+		}
+		check_tag(0x1000 + TLV_OVERFLOW_NUM_TAGS - 2, 0, 0);
+		check_tag(0x1000 + TLV_OVERFLOW_NUM_TAGS - 1, 1, 0x55);
+		check_tag(0x2000, 0, 0);
+		btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &counting_hal_flash_bank, &hal_flash_bank_context);
+	}
+}
+
 //
 TEST_GROUP(LINK_KEY_DB){
 	const hal_flash_bank_t * hal_flash_bank_impl;
@@ -322,6 +617,9 @@ TEST(LINK_KEY_DB, KeyReplacement){
 }
 
 int main (int argc, const char * argv[]){
+#ifdef ENABLE_TLV_FLASH_BANK_INCREMENTAL_COMPACTION
+	btstack_run_loop_init(&test_run_loop);
+#endif
 	hci_dump_open("tlv_test.pklg", HCI_DUMP_PACKETLOGGER);
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
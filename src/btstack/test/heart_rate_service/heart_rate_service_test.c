@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2014 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// heart rate service server: subscriber slots and pending send requests
+//
+// *****************************************************************************
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_gatt.h"
+#include "btstack_defines.h"
+#include "btstack_linked_list.h"
+#include "btstack_util.h"
+#include "ble/att_server.h"
+#include "ble/gatt-service/heart_rate_service_server.h"
+#include "hci.h"
+
+#define TEST_CON_HANDLE_A 0x0040
+#define TEST_CON_HANDLE_B 0x0041
+
+#define TEST_MEASUREMENT_VALUE_HANDLE      0x0003
+#define TEST_CLIENT_CONFIGURATION_HANDLE   0x0004
+#define TEST_CLIENT_CONFIGURATION_NOTIFY   0x0001
+
+// default HEART_RATE_SERVICE_MEASUREMENT_QUEUE_SIZE
+#define TEST_MEASUREMENT_QUEUE_SIZE 4
+
+// mock att_server and hci: one list of send requests and an MTU per connection, requests are dropped on disconnect
+
+typedef struct {
+    hci_con_handle_t con_handle;
+    btstack_linked_list_t notification_requests;
+    uint16_t mtu;
+} mock_connection_t;
+
+static mock_connection_t mock_connections[] = {
+    { TEST_CON_HANDLE_A, NULL, ATT_DEFAULT_MTU },
+    { TEST_CON_HANDLE_B, NULL, ATT_DEFAULT_MTU },
+};
+
+static att_service_handler_t * mock_service_handler;
+static btstack_packet_handler_t mock_event_handler;
+
+static hci_con_handle_t mock_notified_con_handle;
+static uint8_t  mock_notified_value[32];
+static uint16_t mock_notified_len;
+static int      mock_notifications;
+
+static mock_connection_t * mock_connection_for_handle(hci_con_handle_t con_handle){
+    unsigned int i;
+    for (i = 0; i < sizeof(mock_connections) / sizeof(mock_connections[0]); i++){
+        if (mock_connections[i].con_handle == con_handle) return &mock_connections[i];
+    }
+    return NULL;
+}
+
+static int mock_linked_list_contains(btstack_linked_list_t * list, btstack_linked_item_t * item){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, list);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        if (btstack_linked_list_iterator_next(&it) == item) return 1;
+    }
+    return 0;
+}
+
+extern "C" int gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, uint16_t * start_handle, uint16_t * end_handle){
+    UNUSED(uuid16);
+    *start_handle = 0x0001;
+    *end_handle   = 0x0008;
+    return 1;
+}
+
+extern "C" uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
+    UNUSED(start_handle);
+    UNUSED(end_handle);
+    return (uuid16 == ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT) ? TEST_MEASUREMENT_VALUE_HANDLE : 0;
+}
+
+extern "C" uint16_t gatt_server_get_client_configuration_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
+    UNUSED(start_handle);
+    UNUSED(end_handle);
+    return (uuid16 == ORG_BLUETOOTH_CHARACTERISTIC_HEART_RATE_MEASUREMENT) ? TEST_CLIENT_CONFIGURATION_HANDLE : 0;
+}
+
+extern "C" void att_server_register_service_handler(att_service_handler_t * handler){
+    mock_service_handler = handler;
+}
+
+extern "C" void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    mock_event_handler = callback_handler->callback;
+}
+
+extern "C" int att_server_request_to_send_notification(btstack_context_callback_registration_t * callback_registration, hci_con_handle_t con_handle){
+    mock_connection_t * connection = mock_connection_for_handle(con_handle);
+    if (!connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    // a registration linked into two lists would corrupt both
+    unsigned int i;
+    for (i = 0; i < sizeof(mock_connections) / sizeof(mock_connections[0]); i++){
+        CHECK(!mock_linked_list_contains(&mock_connections[i].notification_requests, (btstack_linked_item_t *) callback_registration));
+    }
+    btstack_linked_list_add_tail(&connection->notification_requests, (btstack_linked_item_t *) callback_registration);
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint16_t att_server_get_mtu(hci_con_handle_t con_handle){
+    mock_connection_t * connection = mock_connection_for_handle(con_handle);
+    return connection ? connection->mtu : 0;
+}
+
+extern "C" int att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t *value, uint16_t value_len){
+    CHECK_EQUAL(TEST_MEASUREMENT_VALUE_HANDLE, attribute_handle);
+    CHECK(value_len <= sizeof(mock_notified_value));
+    mock_notified_con_handle = con_handle;
+    memcpy(mock_notified_value, value, value_len);
+    mock_notified_len = value_len;
+    mock_notifications++;
+    return 0;
+}
+
+// fire the oldest send request of a connection, returns 0 if there was none
+static int mock_can_send_now(hci_con_handle_t con_handle){
+    mock_connection_t * connection = mock_connection_for_handle(con_handle);
+    btstack_context_callback_registration_t * registration = (btstack_context_callback_registration_t *) connection->notification_requests;
+    if (!registration) return 0;
+    btstack_linked_list_remove(&connection->notification_requests, (btstack_linked_item_t *) registration);
+    registration->callback(registration->context);
+    return 1;
+}
+
+static void mock_disconnect(hci_con_handle_t con_handle){
+    uint8_t event[6];
+    mock_connection_for_handle(con_handle)->notification_requests = NULL;
+    event[0] = HCI_EVENT_DISCONNECTION_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, con_handle);
+    event[5] = ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION;
+    (*mock_event_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+static int write_client_configuration(hci_con_handle_t con_handle, uint16_t client_configuration){
+    uint8_t value[2];
+    little_endian_store_16(value, 0, client_configuration);
+    return (*mock_service_handler->write_callback)(con_handle, TEST_CLIENT_CONFIGURATION_HANDLE, ATT_TRANSACTION_MODE_NONE, 0, value, sizeof(value));
+}
+
+static void update_heart_rate(uint16_t heart_rate_bpm){
+    heart_rate_service_server_update_heart_rate_values(heart_rate_bpm, HEART_RATE_SERVICE_SENSOR_CONTACT_HAVE_CONTACT, 0, NULL);
+}
+
+// built with one subscriber slot and with two: a second client reuses a freed slot either way, as it is the first free one
+TEST_GROUP(HeartRateServiceServer){
+    void setup(void){
+        unsigned int i;
+        for (i = 0; i < sizeof(mock_connections) / sizeof(mock_connections[0]); i++){
+            mock_connections[i].notification_requests = NULL;
+            mock_connections[i].mtu = ATT_DEFAULT_MTU;
+        }
+        mock_notifications = 0;
+        mock_notified_con_handle = HCI_CON_HANDLE_INVALID;
+        heart_rate_service_server_init(HEART_RATE_SERVICE_BODY_SENSOR_LOCATION_FINGER, 0);
+    }
+    void teardown(void){
+        // leave no subscriber behind for the next test
+        mock_disconnect(TEST_CON_HANDLE_A);
+        mock_disconnect(TEST_CON_HANDLE_B);
+    }
+};
+
+TEST(HeartRateServiceServer, NotifySubscriber){
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    update_heart_rate(60);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_A));
+    CHECK_EQUAL(1, mock_notifications);
+    CHECK_EQUAL(TEST_CON_HANDLE_A, mock_notified_con_handle);
+    CHECK_EQUAL(2, mock_notified_len);
+    CHECK_EQUAL(60, mock_notified_value[1]);
+    CHECK_EQUAL(0, mock_can_send_now(TEST_CON_HANDLE_A));
+}
+
+TEST(HeartRateServiceServer, SlotReusedThenOldClientDisconnects){
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    update_heart_rate(60);
+    // A unsubscribes while its send request is still registered
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, 0));
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_B, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    update_heart_rate(61);
+    // dropping A's request must not strand B
+    mock_disconnect(TEST_CON_HANDLE_A);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(1, mock_notifications);
+    CHECK_EQUAL(TEST_CON_HANDLE_B, mock_notified_con_handle);
+    CHECK_EQUAL(61, mock_notified_value[1]);
+    // and B keeps getting measurements
+    update_heart_rate(62);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(2, mock_notifications);
+    CHECK_EQUAL(62, mock_notified_value[1]);
+}
+
+TEST(HeartRateServiceServer, SlotReusedThenOldRequestFires){
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    update_heart_rate(60);
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, 0));
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_B, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    update_heart_rate(61);
+    // A's request fires: nothing goes to A, B's request is made instead
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_A));
+    CHECK_EQUAL(0, mock_notifications);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(1, mock_notifications);
+    CHECK_EQUAL(TEST_CON_HANDLE_B, mock_notified_con_handle);
+    CHECK_EQUAL(61, mock_notified_value[1]);
+    mock_disconnect(TEST_CON_HANDLE_A);
+    update_heart_rate(62);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(62, mock_notified_value[1]);
+}
+
+#if HEART_RATE_SERVICE_MAX_SUBSCRIBERS > 1
+
+TEST(HeartRateServiceServer, OneEncodingForAllSubscribers){
+    uint16_t rr_intervals[] = { 1000, 1024 };
+    uint8_t  value_a[sizeof(mock_notified_value)];
+    uint16_t len_a;
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_B, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    heart_rate_service_server_update_heart_rate_values(60, HEART_RATE_SERVICE_SENSOR_CONTACT_HAVE_CONTACT, 2, rr_intervals);
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_A));
+    CHECK_EQUAL(TEST_CON_HANDLE_A, mock_notified_con_handle);
+    CHECK_EQUAL(6, mock_notified_len);
+    CHECK_EQUAL(1000, little_endian_read_16(mock_notified_value, 2));
+    CHECK_EQUAL(1024, little_endian_read_16(mock_notified_value, 4));
+    len_a = mock_notified_len;
+    memcpy(value_a, mock_notified_value, len_a);
+    // B gets the same bytes, and neither is sent anything else
+    CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(TEST_CON_HANDLE_B, mock_notified_con_handle);
+    CHECK_EQUAL(len_a, mock_notified_len);
+    CHECK(memcmp(value_a, mock_notified_value, len_a) == 0);
+    CHECK_EQUAL(0, mock_can_send_now(TEST_CON_HANDLE_A));
+    CHECK_EQUAL(0, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(2, mock_notifications);
+}
+
+TEST(HeartRateServiceServer, OnlyLaggingSubscriberDropsOldest){
+    uint16_t heart_rate_bpm;
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_B, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    // A keeps up, B sends nothing until one measurement more than the queue holds was taken
+    for (heart_rate_bpm = 60; heart_rate_bpm <= 60 + TEST_MEASUREMENT_QUEUE_SIZE; heart_rate_bpm++){
+        update_heart_rate(heart_rate_bpm);
+        CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_A));
+        CHECK_EQUAL(TEST_CON_HANDLE_A, mock_notified_con_handle);
+        CHECK_EQUAL(heart_rate_bpm, mock_notified_value[1]);
+    }
+    CHECK_EQUAL(0, mock_can_send_now(TEST_CON_HANDLE_A));
+    // B lost only the oldest
+    for (heart_rate_bpm = 61; heart_rate_bpm <= 60 + TEST_MEASUREMENT_QUEUE_SIZE; heart_rate_bpm++){
+        CHECK_EQUAL(1, mock_can_send_now(TEST_CON_HANDLE_B));
+        CHECK_EQUAL(TEST_CON_HANDLE_B, mock_notified_con_handle);
+        CHECK_EQUAL(heart_rate_bpm, mock_notified_value[1]);
+    }
+    CHECK_EQUAL(0, mock_can_send_now(TEST_CON_HANDLE_B));
+    CHECK_EQUAL(1 + 2 * TEST_MEASUREMENT_QUEUE_SIZE, mock_notifications);
+}
+
+TEST(HeartRateServiceServer, EncodedForSmallestMtu){
+    uint16_t rr_intervals[] = { 800, 810, 820, 830, 840, 850 };
+    hci_con_handle_t con_handles[] = { TEST_CON_HANDLE_A, TEST_CON_HANDLE_B };
+    unsigned int i;
+    // below what ATT allows, so that the few RR-Intervals of one update are split: 12 bytes take flags, heart rate and five
+    mock_connection_for_handle(TEST_CON_HANDLE_B)->mtu = 15;
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_A, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    CHECK_EQUAL(0, write_client_configuration(TEST_CON_HANDLE_B, TEST_CLIENT_CONFIGURATION_NOTIFY));
+    heart_rate_service_server_update_heart_rate_values(60, HEART_RATE_SERVICE_SENSOR_CONTACT_HAVE_CONTACT, 6, rr_intervals);
+    // A's MTU would fit all six in one, but A is sent the same two measurements as B
+    for (i = 0; i < sizeof(con_handles) / sizeof(con_handles[0]); i++){
+        CHECK_EQUAL(1, mock_can_send_now(con_handles[i]));
+        CHECK_EQUAL(con_handles[i], mock_notified_con_handle);
+        CHECK_EQUAL(12, mock_notified_len);
+        CHECK_EQUAL(60, mock_notified_value[1]);
+        CHECK_EQUAL(800, little_endian_read_16(mock_notified_value, 2));
+        CHECK_EQUAL(840, little_endian_read_16(mock_notified_value, 10));
+        CHECK_EQUAL(1, mock_can_send_now(con_handles[i]));
+        CHECK_EQUAL(4, mock_notified_len);
+        CHECK_EQUAL(60, mock_notified_value[1]);
+        CHECK_EQUAL(850, little_endian_read_16(mock_notified_value, 2));
+        CHECK_EQUAL(0, mock_can_send_now(con_handles[i]));
+    }
+}
+
+#endif
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+Send commands to firmware built with WARP_BUILD_ENABLE_COMMANDS over SEGGER RTT
+and print the responses. Needs a J-Link and pylink (pip install pylink-square).
+
+	python3 warp-command.py ping
+	python3 warp-command.py get 0x0D
+	python3 warp-command.py set 0x0D 0x20
+	python3 warp-command.py profile 1
+	python3 warp-command.py stream 0
+	python3 warp-command.py bus spi 2
+	python3 warp-command.py sweep 0x0D 0x10 0x40 0x08 --dwell 30
+	python3 warp-command.py log > session.csv
+	python3 warp-command.py stack
+
+Commands go to RTT down-buffer 1 as 4 bytes (opcode and three arguments), and
+each is answered with an 8-byte response on up-buffer 4 (see warp-command.h).
+`sweep` steps a register through a range of values, holding each for --dwell
+seconds, while a separate capture (warp-rawCapture.py, warp-logDecode.py) records
+the effect. `log` reads the flash session log (WARP_BUILD_ENABLE_SESSION_LOG)
+out record by record and prints it as CSV, oldest first, and reports any records
+the firmware dropped because its RAM batch was full. `stack` reads the stack
+high-water mark (warp-stack.h).
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+DOWN_CHANNEL = 1
+UP_CHANNEL = 4
+RESPONSE = struct.Struct("<2sBBI")
+RESPONSE_SYNC = b"\xa5\x5c"
+
+OPCODES = {
+	"ping": 0x00,
+	"get": 0x01,
+	"set": 0x02,
+	"profile": 0x03,
+	"dump": 0x04,
+	"stream": 0x05,
+	"bus": 0x06,
+	"lost": 0x07,
+	"log count": 0x08,
+	"log record": 0x09,
+	"stack": 0x0A,
+	"log dropped": 0x0B,
+}
+
+SESSION_RECORD = struct.Struct("<HBBBBBB")
+SESSION_RECORD_TORN = 0xFFFF
+
+STATUS = ["OK", "unknown opcode", "bad argument", "bus error", "not built into this firmware"]
+
+
+def number(text):
+	return int(text, 0)
+
+
+class Link:
+	def __init__(self, device, speed):
+		import pylink
+
+		self.jlink = pylink.JLink()
+		self.jlink.open()
+		self.jlink.set_tif(pylink.enums.JLinkInterfaces.SWD)
+		self.jlink.connect(device, speed)
+		self.jlink.rtt_start()
+		self.pending = b""
+
+	def command(self, opcode, *arguments, timeout=2.0):
+		frame = bytes([opcode] + list(arguments) + [0] * (3 - len(arguments)))
+		while True:
+			try:
+				if self.jlink.rtt_write(DOWN_CHANNEL, list(frame)) == len(frame):
+					break
+			except Exception:
+				pass # The control block has not been found yet
+			time.sleep(0.05)
+
+		# The firmware polls between pipeline tasks, and at least once a second while idle
+		deadline = time.time() + timeout
+		while time.time() < deadline:
+			self.pending += bytes(self.jlink.rtt_read(UP_CHANNEL, 64))
+			start = self.pending.find(RESPONSE_SYNC)
+			if start >= 0 and len(self.pending) >= start + RESPONSE.size:
+				_, echoed, status, value = RESPONSE.unpack_from(self.pending, start)
+				self.pending = self.pending[start + RESPONSE.size:]
+				if echoed == opcode:
+					return status, value
+			time.sleep(0.01)
+		raise TimeoutError("no response to opcode 0x%02x" % opcode)
+
+	def close(self):
+		self.jlink.rtt_stop()
+		self.jlink.close()
+
+
+def report(name, status, value):
+	if status:
+		print("%s: %s" % (name, STATUS[status] if status < len(STATUS) else "status %d" % status))
+		return False
+	print("%s: 0x%02x (%d)" % (name, value, value))
+	return True
+
+
+def read_session_log(link):
+	"""Prints the session log as CSV. Each record takes two commands, one per longword."""
+	status, count = link.command(OPCODES["log count"])
+	if status:
+		return report("log", status, count)
+	print("session,minute,beats,min_bpm,mean_bpm,max_bpm,rmssd_ms")
+	for index in range(count):
+		words = []
+		for half in (0, 1):
+			status, word = link.command(OPCODES["log record"], index & 0xFF, index >> 8, half)
+			if status:
+				return report("record %d" % index, status, word)
+			words.append(word)
+		minute, session, beats, low, mean, high, rmssd = SESSION_RECORD.unpack(struct.pack("<II", *words))
+		if minute == SESSION_RECORD_TORN and session == 0xFF:
+			print("record %d was torn by power loss, skipped" % index, file=sys.stderr)
+			continue
+		print("%d,%d,%d,%d,%d,%d,%d" % (session, minute, beats, low, mean, high, rmssd))
+	status, dropped = link.command(OPCODES["log dropped"])
+	if status:
+		return report("log dropped", status, dropped)
+	if dropped:
+		print("%d records dropped since reset, with the RAM batch full" % dropped, file=sys.stderr)
+	return True
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("--device", default="MKL03Z32XXX4")
+	parser.add_argument("--speed", type=int, default=4000, help="SWD speed in kHz")
+	sub = parser.add_subparsers(dest="name", required=True)
+	sub.add_parser("ping")
+	sub.add_parser("get").add_argument("register", type=number)
+	p = sub.add_parser("set")
+	p.add_argument("register", type=number)
+	p.add_argument("value", type=number)
+	sub.add_parser("profile").add_argument("profile", type=number, help="0 default, 1 low power")
+	sub.add_parser("dump")
+	sub.add_parser("stream").add_argument("enable", type=number, choices=[0, 1])
+	p = sub.add_parser("bus")
+	p.add_argument("bus", choices=["i2c", "spi"])
+	p.add_argument("rate", type=number, help="rate index, 0 being the fastest")
+	sub.add_parser("lost")
+	sub.add_parser("log")
+	sub.add_parser("stack")
+	p = sub.add_parser("sweep")
+	p.add_argument("register", type=number)
+	p.add_argument("start", type=number)
+	p.add_argument("stop", type=number)
+	p.add_argument("step", type=number)
+	p.add_argument("--dwell", type=float, default=10.0, help="seconds at each value")
+	args = parser.parse_args()
+
+	link = Link(args.device, args.speed)
+	try:
+		if args.name == "get":
+			ok = report(args.name, *link.command(OPCODES["get"], args.register))
+		elif args.name == "set":
+			ok = report(args.name, *link.command(OPCODES["set"], args.register, args.value))
+		elif args.name == "profile":
+			ok = report(args.name, *link.command(OPCODES["profile"], args.profile))
+		elif args.name == "stream":
+			ok = report(args.name, *link.command(OPCODES["stream"], args.enable))
+		elif args.name == "bus":
+			ok = report("%s kbps" % args.bus, *link.command(OPCODES["bus"], ["i2c", "spi"].index(args.bus), args.rate))
+		elif args.name == "sweep":
+			status, original = link.command(OPCODES["get"], args.register)
+			ok = report("initial", status, original)
+			value = args.start
+			while ok and value <= args.stop:
+				ok = report("set 0x%02x to 0x%02x" % (args.register, value), *link.command(OPCODES["set"], args.register, value))
+				print("%.3f" % time.time(), flush=True)
+				time.sleep(args.dwell)
+				value += args.step
+			if status == 0:
+				report("restored", *link.command(OPCODES["set"], args.register, original))
+		elif args.name == "log":
+			ok = read_session_log(link)
+		elif args.name == "stack":
+			status, value = link.command(OPCODES["stack"])
+			ok = report(args.name, status, value)
+			if ok:
+				print("%d of %d bytes used since reset" % (value & 0xFFFF, value >> 16))
+		else:
+			ok = report(args.name, *link.command(OPCODES[args.name]))
+	finally:
+		link.close()
+	return 0 if ok else 1
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Expand deferred log records (RTT up-buffer 3, firmware built with
+WARP_BUILD_ENABLE_DEFERRED_LOG) back into text, using the format strings in
+the firmware ELF.
+
+Capture with:
+
+	JLinkRTTLogger -Device MKL03Z32XXX4 -If SWD -Speed 4000 -RTTChannel 3 log.bin
+
+then run:
+
+	python3 warp-logDecode.py Warp.elf log.bin
+
+The ELF must be the one that was flashed: format IDs are offsets into its
+.warp_log_format section. Each record is a uint16_t format ID, a uint8_t
+argument count, a uint8_t sequence number and the arguments as uint32_t, all
+little endian (see warp-log.h). Records dropped by a full up-buffer show up as
+gaps in the sequence number.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SECTION = ".warp_log_format"
+RECORD_HEADER = struct.Struct("<HBB")
+SHT_PROGBITS = 1
+SHF_ALLOC = 2
+
+# printf conversions as understood by SEGGER_RTT_printf() and btstack log_*()
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+	"""Just enough of an ELF reader to find sections and read constant strings."""
+
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self.data = f.read()
+		if self.data[:4] != b"\x7fELF":
+			raise ValueError("%s is not an ELF file" % path)
+		is64 = self.data[4] == 2
+		endian = "<" if self.data[5] == 1 else ">"
+		if is64:
+			shoff, = struct.unpack_from(endian + "Q", self.data, 0x28)
+			shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", self.data, 0x3A)
+			entry = struct.Struct(endian + "IIQQQQIIQQ")
+		else:
+			shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+			shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", self.data, 0x2E)
+			entry = struct.Struct(endian + "IIIIIIIIII")
+
+		headers = [entry.unpack_from(self.data, shoff + i * shentsize) for i in range(shnum)]
+		names = headers[shstrndx][4]
+		self.sections = []
+		for name, kind, flags, addr, offset, size, _, _, _, _ in headers:
+			end = self.data.index(b"\0", names + name)
+			self.sections.append((self.data[names + name:end].decode(), kind, flags, addr, offset, size))
+
+	def section(self, wanted):
+		for name, _, _, _, offset, size in self.sections:
+			if name == wanted:
+				return self.data[offset:offset + size]
+		raise KeyError("no %s section; was the firmware built with WARP_BUILD_ENABLE_DEFERRED_LOG?" % wanted)
+
+	def string_at(self, address):
+		"""The NUL-terminated string at a target address in a loaded section, or None."""
+		for _, kind, flags, addr, offset, size in self.sections:
+			if kind == SHT_PROGBITS and (flags & SHF_ALLOC) and addr <= address < addr + size:
+				start = offset + address - addr
+				end = self.data.find(b"\0", start, offset + size)
+				if end >= 0:
+					return self.data[start:end].decode(errors="replace")
+		return None
+
+
+def expand(format, args, elf):
+	"""printf on the host, with every argument taken as a 32-bit word."""
+	remaining = list(args)
+
+	def convert(match):
+		flags, width, precision, conversion = match.groups()
+		if conversion == "%":
+			return "%"
+		if not remaining:
+			return "<missing>"
+		value = remaining.pop(0)
+		if conversion in "di":
+			value = value - (1 << 32) if value & 0x80000000 else value
+			conversion = "d"
+		elif conversion == "u":
+			conversion = "d"
+		elif conversion == "c":
+			value = chr(value & 0xFF)
+		elif conversion == "p":
+			return "0x%08x" % value
+		elif conversion == "s":
+			text = elf.string_at(value)
+			value = text if text is not None else "<0x%08x>" % value
+		spec = "%" + flags + width + ("." + precision if precision else "") + conversion
+		return spec % value
+
+	return CONVERSION.sub(convert, format)
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("elf", help="the firmware ELF that was flashed")
+	parser.add_argument("capture", help="binary capture of RTT channel 3")
+	args = parser.parse_args()
+
+	elf = Elf(args.elf)
+	formats = elf.section(SECTION)
+	with open(args.capture, "rb") as f:
+		data = f.read()
+
+	offset = 0
+	records = 0
+	dropped = 0
+	expected = None
+	while offset + RECORD_HEADER.size <= len(data):
+		formatId, argCount, sequence = RECORD_HEADER.unpack_from(data, offset)
+		end = offset + RECORD_HEADER.size + 4 * argCount
+		if formatId >= len(formats) or end > len(data):
+			print("undecodable record at byte %d, stopping" % offset, file=sys.stderr)
+			break
+		values = struct.unpack_from("<%dI" % argCount, data, offset + RECORD_HEADER.size)
+		offset = end
+
+		if expected is not None and sequence != expected:
+			gap = (sequence - expected) & 0xFF
+			dropped += gap
+			print("[%d records dropped]" % gap)
+		expected = (sequence + 1) & 0xFF
+
+		format = formats[formatId:formats.index(b"\0", formatId)].decode(errors="replace")
+		sys.stdout.write(expand(format, values, elf).replace("\r", ""))
+		if not format.endswith(("\n", "\r")):
+			sys.stdout.write("\n")
+		records += 1
+
+	print("%d records, %d dropped" % (records, dropped), file=sys.stderr)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
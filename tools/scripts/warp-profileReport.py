@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Compare the per-sample cost of the pipeline stages across profiling captures
+(WARP_BUILD_ENABLE_PROFILING, RTT up-buffer 2), for example from builds with
+different WARP_PIPELINE_BLOCK_SAMPLES:
+
+	JLinkRTTLogger -Device MKL03Z32XXX4 -If SWD -Speed 4000 -RTTChannel 2 block8.bin
+	python3 warp-profileReport.py block1.bin block4.bin block8.bin block32.bin
+
+For each capture and probe it prints the calls, the mean samples per call and
+the mean cycles per call and per sample. The pipeline stages run once per
+block, so their samples per call is the block size the DSP task achieved.
+"""
+
+import argparse
+import struct
+import sys
+
+PROFILE_HEADER = struct.Struct("<BBBBI")
+PROFILE_ACCUMULATOR = struct.Struct("<IIIII8H")
+PROFILE_MAGIC = 0xA5
+PROFILE_VERSION = 2
+PROBES = ["i2c burst", "fir", "normalise", "beat", "display"] # WarpProfileProbe order
+
+
+def read_profile(path):
+	"""Sums the WarpProfileRecords in a capture into (count, samples, cycles) per probe."""
+	with open(path, "rb") as f:
+		data = f.read()
+	totals = {}
+	offset = 0
+	while offset + PROFILE_HEADER.size <= len(data):
+		magic, version, probes, bins, _ = PROFILE_HEADER.unpack_from(data, offset)
+		end = offset + PROFILE_HEADER.size + probes * PROFILE_ACCUMULATOR.size
+		if magic != PROFILE_MAGIC or version != PROFILE_VERSION or bins != 8 or end > len(data):
+			offset += 1 # Resynchronise on the next magic byte
+			continue
+		for probe in range(probes):
+			count, samples, _, _, cycles = PROFILE_ACCUMULATOR.unpack_from(data, offset + PROFILE_HEADER.size + probe * PROFILE_ACCUMULATOR.size)[:5]
+			previous = totals.get(probe, (0, 0, 0))
+			totals[probe] = (previous[0] + count, previous[1] + samples, previous[2] + cycles)
+		offset = end
+	return totals
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("captures", nargs="+", help="profiling captures, one per build")
+	args = parser.parse_args()
+
+	print("%-16s %-10s %10s %12s %14s %16s" % ("capture", "stage", "calls", "samples/call", "cycles/call", "cycles/sample"))
+	for path in args.captures:
+		totals = read_profile(path)
+		if not totals:
+			print("%s: no profiling records" % path, file=sys.stderr)
+			continue
+		for probe, name in enumerate(PROBES):
+			if probe not in totals or not totals[probe][0] or not totals[probe][1]:
+				continue
+			count, samples, cycles = totals[probe]
+			print("%-16s %-10s %10d %12.2f %14.1f %16.1f" % (path, name, count, samples / count, cycles / count, cycles / samples))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
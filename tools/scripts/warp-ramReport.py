@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+Report where the 2 KB of SRAM goes, per module, from the linker map file.
+
+	python3 warp-ramReport.py release/Warp.map
+	python3 warp-ramReport.py release/Warp.map --symbols --require-free 64
+
+or `make ram_report` in the build directory. Every input section the map places
+in SRAM (.data, .bss, .ramfunc, the RAM vector table) is charged to the object
+file it came from, then the heap and stack reserves and the gap the linker left
+between them are added up against the size of SRAM. Since the firmware is built
+with -fdata-sections, --symbols also lists each variable on its own.
+
+The stack figure is the reserve set by __stack_size__ (CMakeLists.txt), not what
+the firmware uses; for that, ask the running firmware for its high-water mark
+(warp-stack.h, tools/scripts/warp-command.py stack). --require-free fails the
+report, and so the build step that runs it, when the unallocated gap is smaller
+than the given number of bytes.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SRAM_START = 0x1FFFFE00
+SRAM_BYTES = 0x800
+RESERVES = (".heap", ".stack")
+
+OUTPUT_SECTION = re.compile(r"^(\.\S+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+))?")
+INPUT_SECTION = re.compile(r"^ (\S+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)(?:\s+(.+))?)?$")
+CONTINUATION = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)(?:\s+(.+))?$")
+SYMBOL = re.compile(r"^\s+(0x[0-9a-f]+)\s+([A-Za-z_]\w*)(?:\s+=.*)?$")
+
+
+def in_sram(address):
+	return SRAM_START <= address < SRAM_START + SRAM_BYTES
+
+
+def module_name(path):
+	"""warp-command.c for CMakeFiles/Warp.dir/.../warp-command.c.obj, the member for an archive."""
+	if path.endswith(")") and "(" in path:
+		archive, member = path[:-1].split("(", 1)
+		return "%s(%s)" % (os.path.basename(archive), member)
+	name = os.path.basename(path)
+	for suffix in (".obj", ".o"):
+		if name.endswith(suffix) and name[:-len(suffix)].endswith((".c", ".S", ".s")):
+			return name[:-len(suffix)]
+	return name
+
+
+def parse(path):
+	"""Returns the SRAM input sections as (output section, input section, address, size, module) and the symbols."""
+	with open(path) as f:
+		lines = f.read().split("\n")
+	try:
+		lines = lines[lines.index("Linker script and memory map") + 1:]
+	except ValueError:
+		raise ValueError("%s is not a GNU ld map file" % path)
+
+	sections = []
+	symbols = {}
+	output = None
+	outputs = {}
+	pending = None # An input section whose name took the whole line
+	for line in lines:
+		if pending is not None:
+			match = CONTINUATION.match(line)
+			pending, name = None, pending
+			if match:
+				address, size = int(match.group(1), 16), int(match.group(2), 16)
+				if size and in_sram(address):
+					sections.append((output, name, address, size, module_name(match.group(3) or "")))
+				continue
+
+		match = OUTPUT_SECTION.match(line)
+		if match:
+			output = match.group(1)
+			if match.group(2):
+				outputs[output] = (int(match.group(2), 16), int(match.group(3), 16))
+			continue
+
+		match = SYMBOL.match(line)
+		if match:
+			symbols[match.group(2)] = int(match.group(1), 16)
+			continue
+
+		match = INPUT_SECTION.match(line)
+		if not match or output is None or match.group(1).startswith("*("):
+			continue
+		if match.group(2) is None:
+			pending = match.group(1)
+			continue
+		address, size = int(match.group(2), 16), int(match.group(3), 16)
+		if size and in_sram(address):
+			name = match.group(1)
+			sections.append((output, name, address, size, module_name(match.group(4) or "") if name != "*fill*" else "(alignment)"))
+	return sections, symbols, outputs
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("map", help="linker map file, release/Warp.map or debug/Warp.map")
+	parser.add_argument("--symbols", action="store_true", help="also list each variable and SRAM function")
+	parser.add_argument("--require-free", type=int, metavar="BYTES", help="fail when less SRAM than this is left unallocated")
+	args = parser.parse_args()
+
+	sections, symbols, outputs = parse(args.map)
+
+	modules = {}
+	for output, name, address, size, module in sections:
+		if output in RESERVES:
+			continue
+		columns = modules.setdefault(module, {".data": 0, ".bss": 0, "other": 0})
+		columns[output if output in (".data", ".bss") else "other"] += size
+
+	heap = outputs.get(".heap", (0, 0))[1]
+	stack = symbols.get("__StackTop", 0) - symbols.get("__StackLimit", 0)
+	free = symbols.get("__StackLimit", 0) - symbols.get("__HeapLimit", 0)
+
+	# Alignment between output sections belongs to no input section
+	padding = SRAM_BYTES - sum(sum(columns.values()) for columns in modules.values()) - heap - stack - free
+	if padding > 0:
+		modules.setdefault("(alignment)", {".data": 0, ".bss": 0, "other": 0})["other"] += padding
+
+	print("%-40s %6s %6s %6s %6s" % ("module", ".data", ".bss", "other", "total"))
+	static = 0
+	for module, columns in sorted(modules.items(), key=lambda item: -sum(item[1].values())):
+		total = sum(columns.values())
+		static += total
+		print("%-40s %6d %6d %6d %6d" % (module, columns[".data"], columns[".bss"], columns["other"], total))
+
+	print()
+	print("%-40s %6d" % ("static (.data, .bss, .ramfunc, vectors)", static))
+	print("%-40s %6d" % ("heap reserve", heap))
+	print("%-40s %6d" % ("stack reserve", stack))
+	print("%-40s %6d" % ("unallocated", free))
+	print("%-40s %6d" % ("SRAM", SRAM_BYTES))
+
+	if args.symbols:
+		print()
+		print("%-40s %-10s %6s %s" % ("section", "address", "size", "module"))
+		for output, name, address, size, module in sorted(sections, key=lambda section: -section[3]):
+			if output in RESERVES or name == "*fill*":
+				continue
+			print("%-40s 0x%08x %6d %s" % (name, address, size, module))
+
+	if args.require_free is not None and free < args.require_free:
+		print("only %d bytes of SRAM unallocated, %d required" % (free, args.require_free), file=sys.stderr)
+		return 1
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
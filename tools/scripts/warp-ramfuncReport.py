@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+Report what the .ramfunc section (code run from SRAM, WARP_RAMFUNC in warp.h)
+costs in SRAM, and optionally what it saves in cycles.
+
+	python3 warp-ramfuncReport.py Warp.elf
+
+lists the functions in .ramfunc with their sizes, against the 2 KB of SRAM and
+the space left between the heap and the stack. To weigh that against the
+cycles saved, capture profiling records (WARP_BUILD_ENABLE_PROFILING, RTT
+up-buffer 2) from a build with WARP_BUILD_ENABLE_RAMFUNC and one without:
+
+	JLinkRTTLogger -Device MKL03Z32XXX4 -If SWD -Speed 4000 -RTTChannel 2 flash.bin
+	python3 warp-ramfuncReport.py Warp.elf --flash-profile flash.bin --ram-profile ram.bin
+
+which adds the mean cycles per call of each pipeline stage in both builds and
+the cycles saved per second of sampling.
+"""
+
+import argparse
+import struct
+import sys
+
+SRAM_BYTES = 0x800
+STT_FUNC = 2
+
+PROFILE_HEADER = struct.Struct("<BBBBI")
+PROFILE_ACCUMULATOR = struct.Struct("<IIIII8H")
+PROFILE_MAGIC = 0xA5
+PROFILE_VERSION = 2
+PROBES = ["i2c burst", "fir", "normalise", "beat", "display"] # WarpProfileProbe order
+
+
+class Elf:
+	"""Just enough of a 32-bit little endian ELF reader to list symbols."""
+
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self.data = f.read()
+		if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+			raise ValueError("%s is not a 32-bit ELF file" % path)
+		shoff, = struct.unpack_from("<I", self.data, 0x20)
+		shentsize, shnum, _ = struct.unpack_from("<HHH", self.data, 0x2E)
+		entry = struct.Struct("<IIIIIIIIII")
+		headers = [entry.unpack_from(self.data, shoff + i * shentsize) for i in range(shnum)]
+
+		self.symbols = {}
+		self.functions = []
+		for _, kind, _, _, offset, size, link, _, _, entsize in headers:
+			if kind != 2: # SHT_SYMTAB
+				continue
+			strings = headers[link][4]
+			for index in range(size // entsize):
+				name, value, length, info, _, _ = struct.unpack_from("<IIIBBH", self.data, offset + index * entsize)
+				end = self.data.index(b"\0", strings + name)
+				text = self.data[strings + name:end].decode()
+				if not text:
+					continue
+				self.symbols[text] = value
+				if info & 0xF == STT_FUNC:
+					self.functions.append((text, value & ~1, length))
+
+	def symbol(self, name):
+		if name not in self.symbols:
+			raise KeyError("no %s symbol; was the firmware linked with the .ramfunc linker script?" % name)
+		return self.symbols[name]
+
+
+def read_profile(path):
+	"""Sums the WarpProfileRecords in a capture into (count, cycles) per probe."""
+	with open(path, "rb") as f:
+		data = f.read()
+	totals = {}
+	offset = 0
+	while offset + PROFILE_HEADER.size <= len(data):
+		magic, version, probes, bins, _ = PROFILE_HEADER.unpack_from(data, offset)
+		end = offset + PROFILE_HEADER.size + probes * PROFILE_ACCUMULATOR.size
+		if magic != PROFILE_MAGIC or version != PROFILE_VERSION or bins != 8 or end > len(data):
+			offset += 1 # Resynchronise on the next magic byte
+			continue
+		for probe in range(probes):
+			count, _, _, _, cycles = PROFILE_ACCUMULATOR.unpack_from(data, offset + PROFILE_HEADER.size + probe * PROFILE_ACCUMULATOR.size)[:5]
+			previous = totals.get(probe, (0, 0, 0))
+			totals[probe] = (previous[0] + count, previous[1] + cycles, previous[2] + 1)
+		offset = end
+	return totals
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("elf", help="firmware ELF built with WARP_BUILD_ENABLE_RAMFUNC")
+	parser.add_argument("--flash-profile", help="profiling capture from a build without WARP_BUILD_ENABLE_RAMFUNC")
+	parser.add_argument("--ram-profile", help="profiling capture from a build with WARP_BUILD_ENABLE_RAMFUNC")
+	args = parser.parse_args()
+
+	elf = Elf(args.elf)
+	start = elf.symbol("__ramfunc_start__")
+	end = elf.symbol("__ramfunc_end__")
+	ramfunc = end - start
+
+	print(".ramfunc: %d bytes of SRAM (%.1f%% of %d)" % (ramfunc, 100.0 * ramfunc / SRAM_BYTES, SRAM_BYTES))
+	listed = 0
+	for name, address, length in sorted(elf.functions, key=lambda function: function[1]):
+		if start <= address < end:
+			print("\t%-32s %5d" % (name, length))
+			listed += length
+	if ramfunc > listed:
+		print("\t%-32s %5d" % ("(alignment, veneers)", ramfunc - listed))
+	print("SRAM left between heap and stack: %d bytes" % (elf.symbol("__StackLimit") - elf.symbol("__HeapLimit")))
+
+	if not (args.flash_profile and args.ram_profile):
+		return 0
+
+	flash = read_profile(args.flash_profile)
+	ram = read_profile(args.ram_profile)
+	print()
+	print("%-10s %14s %14s %12s %16s" % ("stage", "flash cycles", "SRAM cycles", "calls/s", "saved cycles/s"))
+	saved_total = 0
+	for probe, name in enumerate(PROBES):
+		if probe not in flash or probe not in ram or not flash[probe][0] or not ram[probe][0]:
+			continue
+		flash_mean = flash[probe][1] / flash[probe][0]
+		ram_mean = ram[probe][1] / ram[probe][0]
+		rate = ram[probe][0] / ram[probe][2] # One record per second
+		saved = (flash_mean - ram_mean) * rate
+		saved_total += saved
+		print("%-10s %14.1f %14.1f %12.1f %16.0f" % (name, flash_mean, ram_mean, rate, saved))
+	print("%.0f cycles saved per second, %.1f per byte of .ramfunc" % (saved_total, saved_total / ramfunc if ramfunc else 0))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
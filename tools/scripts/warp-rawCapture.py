@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Decode a capture of the raw sample stream (RTT up-buffer 1, firmware built
+with WARP_BUILD_ENABLE_RAW_STREAM) into one CSV row per sample.
+
+Capture with:
+
+	JLinkRTTLogger -Device MKL03Z32XXX4 -If SWD -Speed 4000 -RTTChannel 1 raw.bin
+
+then run:
+
+	python3 warp-rawCapture.py raw.bin raw.csv
+
+Each frame is the WarpRawStreamFrameHeader from warp-rawStream.h followed by
+sampleCount FIFO samples of 6 bytes (red then IR, 3 bytes each, 18-bit, MSB
+first). Frames dropped by a full up-buffer show up as gaps in firstSample;
+their samples are missing from the CSV and counted in the summary.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<2sHHBB")
+BYTES_PER_SAMPLE = 6
+FIFO_DEPTH = 32
+
+
+def frames(data):
+	"""Yield (sequence, firstSample, sampleCount, sensorLost, payload), skipping bytes until the next sync."""
+	offset = 0
+	skipped = 0
+	while True:
+		start = data.find(SYNC, offset)
+		if start < 0 or start + HEADER.size > len(data):
+			skipped += len(data) - offset
+			break
+		skipped += start - offset
+		_, sequence, firstSample, sampleCount, sensorLost = HEADER.unpack_from(data, start)
+		end = start + HEADER.size + sampleCount * BYTES_PER_SAMPLE
+		if sampleCount == 0 or sampleCount > FIFO_DEPTH or end > len(data):
+			# Not a frame header, or a truncated last frame
+			offset = start + 1
+			continue
+		yield sequence, firstSample, sampleCount, sensorLost, data[start + HEADER.size:end]
+		offset = end
+	if skipped:
+		print("skipped %d bytes that were not part of a frame" % skipped, file=sys.stderr)
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+	parser.add_argument("capture", help="binary capture of RTT channel 1")
+	parser.add_argument("output", help="CSV file to write")
+	args = parser.parse_args()
+
+	with open(args.capture, "rb") as f:
+		data = f.read()
+
+	frameCount = 0
+	sampleCount = 0
+	droppedFrames = 0
+	droppedSamples = 0
+	sensorLost = 0
+	index = None
+	expectedSequence = None
+
+	with open(args.output, "w", newline="") as f:
+		writer = csv.writer(f)
+		writer.writerow(["index", "red", "ir", "sample"])
+
+		for sequence, firstSample, count, lost, payload in frames(data):
+			if expectedSequence is not None:
+				droppedFrames += (sequence - expectedSequence) & 0xFFFF
+				gap = (firstSample - (index & 0xFFFF)) & 0xFFFF
+				droppedSamples += gap
+				index += gap
+			else:
+				index = firstSample
+			expectedSequence = (sequence + 1) & 0xFFFF
+			sensorLost += lost
+
+			for i in range(count):
+				d = payload[i * BYTES_PER_SAMPLE:(i + 1) * BYTES_PER_SAMPLE]
+				red = ((d[0] << 16) | (d[1] << 8) | d[2]) & 0x3FFFF
+				ir = ((d[3] << 16) | (d[4] << 8) | d[5]) & 0x3FFFF
+				writer.writerow([index, red, ir, (d[4] << 8) | d[5]])
+				index += 1
+
+			frameCount += 1
+			sampleCount += count
+
+	print("%d frames, %d samples" % (frameCount, sampleCount))
+	print("dropped before the host: %d frames, %d samples" % (droppedFrames, droppedSamples))
+	print("lost to sensor FIFO overflow: %d samples" % sensorLost)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())